@@ -14,6 +14,7 @@ interface ListenOptions {
   bufferLimit?: number | string,
   keepAlive?: boolean,
   noDelay?: boolean,
+  batchSize?: number,
   transparent?: boolean,
   masquerade?: boolean,
   peerStats?: boolean,
@@ -32,6 +33,8 @@ interface MuxOptions extends MuxSessionOptions {
 interface MuxHTTPOptions extends MuxOptions {
   bufferSize?: number | string,
   maxHeaderSize?: number | string,
+  maxPipeline?: number,
+  pipelineFallback?: number | string,
   version?: number | string | (() => number | string),
 }
 
@@ -315,6 +318,42 @@ interface Configuration {
     ...restBranches: (((msg: Message) => boolean)|string|((pipelineConfigurator: Configuration) => void))[]
   ): Configuration;
 
+  /**
+   * Appends a _cacheHTTP_ filter to the current pipeline layout.
+   *
+   * A _cacheHTTP_ filter answers GET requests from a response cache shared by all worker threads,
+   * and forwards misses to its sub-pipeline. Concurrent misses for the same key wait for a single upstream request.
+   * A hit whose _ETag_ matches the request's _If-None-Match_ is answered with a 304 response.
+   *
+   * - **INPUT** - HTTP request _Message_.
+   * - **OUTPUT** - HTTP response _Message_, from the cache or from the sub-pipeline.
+   * - **SUB-INPUT** - HTTP request _Message_ on a cache miss.
+   * - **SUB-OUTPUT** - HTTP response _Message_ to cache and return. Responses that cannot be stored are streamed through without buffering.
+   *
+   * @param options Options including:
+   *   - _name_ - Name of the cache. Filters with the same name share the same cache. Default is `""`.
+   *   - _key_ - A function that receives the request head and returns the cache key. Default is host plus path.
+   *   - _maxSize_ - Memory budget of the cache. Can be a number or a string with a unit suffix such as `k`, `m` or `g`.
+   *       Default is `"64m"`. Responses larger than 1/8 of the budget are not stored.
+   *       The budget is fixed by the first filter that creates the named cache.
+   *   - _ttl_ - Freshness lifetime for responses without _max-age_ or _s-maxage_.
+   *       Default is 0, which means those responses are not stored.
+   *   - _staleWhileRevalidate_ - Window for serving stale responses while revalidating in the background,
+   *       for responses without a _stale-while-revalidate_ directive. Default is 0.
+   *   - _timeout_ - How long requests wait for a coalesced upstream fetch, and how long a background revalidation may take.
+   *       When it expires, waiting requests get a usable stale response if there is one, or a 504 response otherwise,
+   *       and the key is released for the next request to fetch. Default is `"10s"`; 0 means no limit.
+   * @returns The same _Configuration_ object.
+   */
+  cacheHTTP(options?: {
+    name?: string,
+    key?: (head: HttpRequestHead) => string,
+    maxSize?: number | string,
+    ttl?: number | string,
+    staleWhileRevalidate?: number | string,
+    timeout?: number | string,
+  }): Configuration;
+
   /**
    * Appends a _chain_ filter to the current pipeline layout.
    *
@@ -343,10 +382,12 @@ interface Configuration {
    * - **OUTPUT** - Compressed _Messages_.
    *
    * @param algorithm Compression algorithm or a function that returns the compression algorithm.
-   *       Available compression algorithms are `"deflate"`, `"gzip"`.
+   *       Available compression algorithms are `"deflate"`, `"gzip"`, `"zstd"`.
+   * @param options Options including:
+   *   - _dictionary_ - (optional) A _Data_ or string used as the preset dictionary for `"deflate"` or `"zstd"`.
    * @returns The same _Configuration_ object.
    */
-  compress(algorithm: string | (() => string)): Configuration;
+  compress(algorithm: string | (() => string), options?: { dictionary?: Data | string }): Configuration;
 
   /**
    * Appends a _compressHTTP_ filter to the current pipeline layout.
@@ -356,20 +397,16 @@ interface Configuration {
    * - **INPUT** - HTTP _Messages_ to compress.
    * - **OUTPUT** - Compressed HTTP _Messages_.
    *
+   * @param algorithm Content encoding or a function that receives the _MessageStart_ and returns the content encoding.
+   *       Available encodings are `"deflate"`, `"gzip"`, `"zstd"` and `"dcz"` (dictionary-compressed zstd, RFC 9842).
+   *       Messages that already have a `content-encoding` header are left untouched.
    * @param options Options including:
-   *   - method - Compression method or a function that returns the compression method.
-   *       Available compression methods are `"deflate"`, `"gzip"` and  `""` for no compression.
-   *       Default is `""`.
-   *   - level - Compression level or a function that returns the compression level.
-   *       Available compression levels are `"default"`, `"speed"` and `"best"`.
-   *       Default is `"default"`.
+   *   - _dictionary_ - (optional) A _Data_ or string used as the dictionary for `"dcz"`, which requires it.
    * @returns The same _Configuration_ object.
    */
   compressHTTP(
-    options?: {
-      method?: '' | 'deflate' | 'gzip' | (() => (''|'deflate'|'gzip')),
-      level?: 'default' | 'speed' | 'best' | (() => ('default'|'speed'|'best')),
-    }
+    algorithm: string | ((head: MessageStart) => string),
+    options?: { dictionary?: Data | string }
   ): Configuration;
 
   /**
@@ -404,6 +441,9 @@ interface Configuration {
    *       Defaults to 1 minute.
    *   - _keepAlive_ - Enable sending of keep-alive messages on TCP connections. Defaults to true.
    *   - _noDelay_ - If set, disable the Nagle algorithm. Defaults to true.
+   *   - _batchSize_ - Maximum number of UDP datagrams received or sent by a single system call. Defaults to 1.
+   *   - _splice_ - If set, relay the TCP stream in the kernel when this filter is the only one between
+   *       the inbound connection and the upstream. Only effective on Linux. Defaults to false.
    * @returns The same _Configuration_ object.
    */
   connect(
@@ -421,6 +461,8 @@ interface Configuration {
       idleTimeout?: number | string,
       keepAlive?: boolean,
       noDelay?: boolean,
+      batchSize?: number,
+      splice?: boolean,
       onState?: (inbound: Inbound) => void,
     }
   ): Configuration;
@@ -623,11 +665,13 @@ interface Configuration {
    * - **OUTPUT** - Decompressed _Data_.
    *
    * @param algorithm Algorithm used in decompression.
-   *   Available algorithms include `"inflate"`, `"brotli"`.
+   *   Available algorithms include `"inflate"`, `"gzip"`, `"brotli"`, `"zstd"`.
    *   Can be one of these strings or a function that returns one of them.
+   * @param options Options including:
+   *   - _dictionary_ - (optional) A _Data_ or string used as the preset dictionary for `"inflate"` or `"zstd"`.
    * @returns The same _Configuration_ object.
    */
-  decompress(algorithm: string | (() => 'inflate' | 'brotli')): Configuration;
+  decompress(algorithm: string | (() => 'inflate' | 'gzip' | 'brotli' | 'zstd'), options?: { dictionary?: Data | string }): Configuration;
 
   /**
    * Appends a _decompressHTTP_ filter to the current pipeline layout.
@@ -637,9 +681,15 @@ interface Configuration {
    * - **INPUT** - HTTP _Messages_ to decompress.
    * - **OUTPUT** - Decompressed HTTP _Messages_.
    *
+   * Content encodings `"gzip"`, `"deflate"`, `"br"` and `"zstd"` are decoded,
+   * as well as `"dcz"` when a dictionary is given.
+   *
+   * @param options Options including:
+   *   - _dictionary_ - (optional) A _Data_ or string used as the dictionary for `"dcz"`.
+   *       Bodies encoded with a different dictionary fail to decode.
    * @returns The same _Configuration_ object.
    */
-  decompressHTTP(): Configuration;
+  decompressHTTP(options?: { dictionary?: Data | string }): Configuration;
 
   /**
    * Appends a _deframe_ filter to the current pipeline layout.
@@ -1059,6 +1109,11 @@ interface Configuration {
    *       Defaults is `60` seconds.
    *   - _maxQueue_ - Maximum number of messages allowed to run concurrently in one sub-pipeline.
    *   - _maxMessages_ - Maximum number of messages allowed to run accumulatively in one sub-pipeline.
+   *   - _maxPipeline_ - Maximum number of HTTP/1 requests written ahead on one connection before their responses arrive.
+   *       Zero means no limit. When a limit is set, upstreams that drop pipelined requests fall back to
+   *       one request at a time for the time given by _pipelineFallback_.
+   *   - _pipelineFallback_ - How long an upstream that dropped pipelined requests gets one request at a time.
+   *       Can be a number in seconds or a string with a time unit suffix. Default is 60 seconds.
    *   - _bufferSize_ - Maximum body size above which a message should be transferred in chunks.
    *       Can be a number in bytes or a string with a unit suffix such as `'k'`, `'m'`, `'g'` and `'t'`.
    *       Default is _16KB_.
@@ -1080,6 +1135,10 @@ interface Configuration {
    *       Defaults is `60` seconds.
    *   - _maxQueue_ - Maximum number of messages allowed to run concurrently in one sub-pipeline.
    *   - _maxMessages_ - Maximum number of messages allowed to run accumulatively in one sub-pipeline.
+   *   - _maxPipeline_ - Maximum number of HTTP/1 requests written ahead on one connection before their responses arrive.
+   *       Zero means no limit. Upstreams that drop pipelined requests fall back to one request at a time.
+   *   - _pipelineFallback_ - How long an upstream that dropped pipelined requests gets one request at a time.
+   *       Can be a number in seconds or a string with a time unit suffix. Default is 60 seconds.
    *   - _bufferSize_ - Maximum body size above which a message should be transferred in chunks.
    *       Can be a number in bytes or a string with a unit suffix such as `'k'`, `'m'`, `'g'` and `'t'`.
    *       Default is _16KB_.
@@ -100,17 +100,31 @@ interface QuotaConstructor {
    * Creates an instance of _Quota_.
    *
    * @param initialValue Initial quota. Must be a number.
+   *   In _sliding-window_ mode, this is the quota allowed within any time window of length _per_.
    * @param options Options including:
+   *   - _mode_ - Can be `"token-bucket"` (default) or `"sliding-window"`.
+   *   - _key_ - Name of a counter shared by all _Quota_ objects with the same key across threads.
+   *       All _Quota_ objects sharing a key must use the same _mode_.
+   *   - _max_ - Maximum quota the token bucket can hold.
    *   - _produce_ - Number by which the quota increases each time it recovers.
-   *   - _per_ - Time interval by which the quota recovers automatically.
+   *   - _per_ - Time interval by which the quota recovers automatically, or the length of the sliding window.
    *       Can be a number in seconds or a string with one of the time unit suffixes such as `'s'`, `'m'` and `'h'`.
+   *       Required in _sliding-window_ mode.
+   *   - _lease_ - Quota taken from the shared counter in one go and consumed locally by the current thread.
+   *       Unused quota is returned after one _per_ interval. Only applies when _key_ is given.
+   *       The shared counter can be overdrawn by at most one lease per thread.
+   *       Quota produced while other threads are waiting goes to the shared counter instead of the lease.
    * @returns A _Quota_ object with the specified initial quota.
    */
   new(
     initialValue: number,
     options?: {
+      mode?: 'token-bucket' | 'sliding-window',
+      key?: string,
+      max?: number,
       produce?: number,
       per?: number | string,
+      lease?: number,
     }
   ): Quota;
 }
@@ -123,6 +137,11 @@ interface URLRouter {
   /**
    * Appends a route.
    *
+   * A route can start with a host name, or with `*.` for any subdomain of a host name.
+   * With the _params_ option, a path segment `:name` matches any single non-empty segment.
+   * Otherwise `:` has no special meaning.
+   * A trailing `/*` matches the rest of the path, including nothing.
+   *
    * @param path A string containing a path.
    * @param value The value that the given _path_ is mapped to.
    */
@@ -135,6 +154,16 @@ interface URLRouter {
    * @returns The value that the queried path maps to, or `undefined` if the path is not found.
    */
   find(...pathSegments: string[]): any;
+
+  /**
+   * Finds a route and captures its parameters.
+   *
+   * @param pathSegments A series of strings that make up a path to look up.
+   * @returns An object containing the _value_ that the queried path maps to
+   *   and the _params_ captured by `:name` segments, with the part matching `/*` under key `'*'`,
+   *   or `undefined` if the path is not found.
+   */
+  match(...pathSegments: string[]): { value: any, params: { [name: string]: string } } | undefined;
 }
 
 interface URLRouterConstructor {
@@ -143,9 +172,11 @@ interface URLRouterConstructor {
    * Creates an instance of _URLRouter_.
    *
    * @param routes An object of key-value pairs where keys are the paths and values are what the paths map to.
+   * @param options Options including:
+   *   - _params_ - If true, path segments starting with `:` capture parameters. Defaults to false.
    * @returns A _URLRouter_ object with the provided initial mapping.
    */
-  new(routes: { [path: string]: any }): URLRouter;
+  new(routes?: { [path: string]: any }, options?: { params?: boolean }): URLRouter;
 }
 
 /**
@@ -184,11 +215,29 @@ interface HashingLoadBalancerConstructor {
   /**
    * Creates an instance of _HashingLoadBalancer_.
    *
-   * @param targets An array of strings. Each string represents a target.
+   * Unhealthy targets are skipped in favor of the next candidate in the hash order.
+   *
+   * @param targets An array of strings representing the targets, or an object of key-value pairs
+   *   where keys are the targets and values are the weights.
    * @param unhealthy A _Cache_ object storing _unhealthy_ targets.
+   * @param options Options including:
+   *   - _algorithm_ - One of `"modulo"` (default), `"ring-hash"` or `"maglev"`.
+   *   - _replicas_ - Number of points on the ring for each unit of weight with `"ring-hash"`. Default is `160`.
+   *   - _tableSize_ - Size of the lookup table with `"maglev"`, rounded up to a prime. Default is `65537`.
+   *   - _boundedLoad_ - When set, no target gets more than this factor of the mean load.
+   *       Load is counted from `select()` to `deselect()`. Default is `0`, which means no limit.
    * @returns A _HashingLoadBalancer_ object with the specified targets.
    */
-  new(targets: string[], unhealthy?: Cache): HashingLoadBalancer;
+  new(
+    targets: string[] | { [id: string]: number },
+    unhealthy?: Cache,
+    options?: {
+      algorithm?: 'modulo' | 'ring-hash' | 'maglev',
+      replicas?: number,
+      tableSize?: number,
+      boundedLoad?: number,
+    }
+  ): HashingLoadBalancer;
 }
 
 /**
@@ -283,22 +332,27 @@ interface LoadBalancerConstructor {
    *
    * @param targets An array of targets. Targets can be of any type and carry any information one might need.
    * @param options Options including:
-   *   - _algorithm_ - Can be `'round-robin'` or `'least-load'`. Defaults to `'round-robin'`.
+   *   - _algorithm_ - Can be `'round-robin'`, `'least-load'` or `'p2c-ewma'`. Defaults to `'round-robin'`.
+   *       `'p2c-ewma'` picks the cheaper of two random targets. The cost is the peak-sensitive moving average
+   *       of latency, measured from allocation to `free()`, multiplied by the number of resources in use.
    *   - _key_ - A user-provided callback function that receives a target and returns a unique key representing it.
    *   - _weight_ - A user-provided callback function that receives a target and returns its weight.
    *   - _capacity_ - Maximum number of allocated resources allowed by each target, or a user-provided callback function
    *       that receives each target as parameter and returns their respective capacity.
    *   - _sessionCache_ - A user-provided Cache object for storing sticky sessions.
+   *   - _decay_ - Time window for the latency average in `'p2c-ewma'`.
+   *       Can be a number in seconds or a string with a time unit suffix. Defaults to `10` seconds.
    * @returns A _LoadBalancer_ object with the specified targets and options.
    */
   new(
     targets: any[],
     options?: {
-      algorithm?: 'round-robin' | 'least-load',
+      algorithm?: 'round-robin' | 'least-load' | 'p2c-ewma',
       key?: (target: any) => any,
       weight?: (target: any) => number,
       capacity?: number | ((target: any) => number),
       sessionCache?: Cache,
+      decay?: number | string,
     }
   ): LoadBalancer;
 }
@@ -94,6 +94,11 @@ interface HttpDirectory {
   /**
    * Generates a response for a static file request.
    *
+   * Responses carry an _ETag_. Requests with a matching _If-None-Match_ get a 304,
+   * and a single _Range_ is answered with a 206 partial response.
+   * Precompressed siblings named with a `.br`, `.zst` or `.gz` suffix are served
+   * to clients that accept the corresponding encoding.
+   *
    * @param request A _Message_ object requesting a static file.
    * @returns A _Message_ object containing the HTTP response for the static file.
    */
@@ -106,6 +111,10 @@ interface HttpDirectoryConstructor {
    * Creates an instance of _Directory_.
    *
    * @param path Path of the directory.
+   * @param options Options including:
+   *   - _maxCacheSize_ - Maximum total size of cached file content.
+   *   - _revalidateInterval_ - Minimum time between checks of a cached file for changes on disk.
+   *       Can be a number in seconds or a string with a time unit suffix. Defaults to 1 second.
    * @returns An instance of _http.File_ created from the file.
    */
   new(
@@ -125,6 +134,8 @@ interface HttpDirectoryConstructor {
         pathname: string,
         size: number,
       ) => string,
+      maxCacheSize?: number | string,
+      revalidateInterval?: number | string,
     }
   ): HttpDirectory;
 
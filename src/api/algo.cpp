@@ -29,6 +29,8 @@
 #include "log.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <limits>
 
 namespace pipy {
@@ -230,6 +232,9 @@ void Cache::set(
 //
 
 Quota::Options::Options(pjs::Object *options) {
+  Value(options, "mode")
+    .get_enum<Quota::Mode>(mode)
+    .check_nullable();
   Value(options, "key")
     .get(key)
     .check_nullable();
@@ -242,6 +247,40 @@ Quota::Options::Options(pjs::Object *options) {
   Value(options, "produce")
     .get(produce)
     .check_nullable();
+  Value(options, "lease")
+    .get(lease)
+    .check_nullable();
+  if (mode == SLIDING_WINDOW && per <= 0) throw std::runtime_error("options.per is required in sliding-window mode");
+}
+
+//
+// Quota::Window
+//
+// Approximates a sliding window with two fixed windows, weighting the count
+// of the previous one by how much of it still overlaps the sliding window.
+// Quota available from a window is rounded down to whole units.
+//
+
+auto Quota::Window::count(double period, double now) const -> double {
+  if (period <= 0 || start <= 0) return curr;
+  auto t = (now - start) / period;
+  if (t >= 2) return 0;
+  if (t >= 1) return curr * (2 - t);
+  return prev * (1 - t) + curr;
+}
+
+void Quota::Window::roll(double period, double now) {
+  if (period <= 0) return;
+  if (start <= 0) {
+    start = now;
+    return;
+  }
+  auto n = std::floor((now - start) / period);
+  if (n >= 1) {
+    prev = (n < 2 ? curr : 0);
+    curr = 0;
+    start += n * period;
+  }
 }
 
 Quota::Quota(double initial_value, const Options &options)
@@ -253,6 +292,7 @@ Quota::Quota(double initial_value, const Options &options)
   if (options.key) {
     m_counter = Counter::get(
       options.key->str(),
+      options.mode,
       initial_value,
       options.max,
       options.produce,
@@ -263,13 +303,26 @@ Quota::Quota(double initial_value, const Options &options)
 
 Quota::~Quota() {
   if (m_counter) {
+    return_lease();
     m_counter->dequeue(this);
   }
 }
 
+auto Quota::current() const -> double {
+  if (m_counter) return m_counter->current() + m_lease;
+  if (m_options.mode == SLIDING_WINDOW) {
+    auto n = m_window.count(m_options.per * 1000, utils::now());
+    return std::max(0.0, std::floor(m_initial_value - n));
+  }
+  return m_current_value;
+}
+
 void Quota::reset() {
   if (m_counter) return;
-  if (m_current_value >= m_initial_value) {
+  if (m_options.mode == SLIDING_WINDOW) {
+    m_window = Window();
+    on_produce();
+  } else if (m_current_value >= m_initial_value) {
     m_current_value = m_initial_value;
   } else {
     produce(m_initial_value - m_current_value);
@@ -277,9 +330,24 @@ void Quota::reset() {
 }
 
 void Quota::produce(double value) {
-  if (m_counter) return m_counter->produce(value);
   if (value <= 0) return;
-  m_current_value = std::min(m_options.max, m_current_value + value);
+  if (m_counter) {
+    if (m_options.lease > 0 && m_counter->waiting() <= (m_consumers.empty() ? 0 : 1)) {
+      auto n = std::min(value, std::max(0.0, m_options.lease - m_lease));
+      if (n > 0) {
+        m_lease += n;
+        value -= n;
+        schedule_lease_return();
+        on_produce();
+      }
+    }
+    return m_counter->produce(value);
+  }
+  if (m_options.mode == SLIDING_WINDOW) {
+    m_window.curr = std::max(0.0, m_window.curr - value);
+  } else {
+    m_current_value = std::min(m_options.max, m_current_value + value);
+  }
   on_produce();
 }
 
@@ -295,8 +363,36 @@ void Quota::produce_async(double value) {
 }
 
 auto Quota::consume(double value) -> double {
-  if (m_counter) return m_counter->consume(value);
   if (value <= 0) return 0;
+  if (m_counter) {
+    if (m_options.lease <= 0) return m_counter->consume(value);
+    if (value > m_lease) {
+      double window = 0;
+      auto n = m_counter->consume(value - m_lease + m_options.lease, &window);
+      if (window != m_lease_window) {
+        return_lease();
+        if (n < value) n += m_counter->consume(value - n, &window);
+        m_lease_window = window;
+      }
+      m_lease += n;
+      schedule_lease_return();
+    }
+    if (value > m_lease) value = m_lease;
+    m_lease -= value;
+    return value;
+  }
+  if (m_options.mode == SLIDING_WINDOW) {
+    auto period = m_options.per * 1000;
+    auto now = utils::now();
+    m_window.roll(period, now);
+    auto room = std::floor(m_initial_value - m_window.count(period, now));
+    if (value >= room) {
+      value = std::max(0.0, room);
+      schedule_producing();
+    }
+    m_window.curr += value;
+    return value;
+  }
   if (value > m_current_value) value = m_current_value;
   m_current_value -= value;
   schedule_producing();
@@ -306,6 +402,21 @@ auto Quota::consume(double value) -> double {
 void Quota::schedule_producing() {
   if (m_is_producing_scheduled) return;
   if (m_options.per <= 0) return;
+
+  // A sliding window frees up continuously, so just poll for
+  // waiting consumers at a fraction of the window length
+  if (m_options.mode == SLIDING_WINDOW) {
+    m_timer.schedule(
+      m_options.per / 10,
+      [this]() {
+        m_is_producing_scheduled = false;
+        on_produce();
+      }
+    );
+    m_is_producing_scheduled = true;
+    return;
+  }
+
   m_timer.schedule(
     m_options.per,
     [this]() {
@@ -321,6 +432,33 @@ void Quota::schedule_producing() {
   m_is_producing_scheduled = true;
 }
 
+//
+// Leased quota is only valid for one producing cycle (or a second
+// when not producing), after which the unused part goes back to the
+// shared counter. The counter can therefore be overdrawn by at most
+// one lease per thread.
+//
+
+void Quota::schedule_lease_return() {
+  if (m_is_lease_return_scheduled) return;
+  m_lease_timer.schedule(
+    m_options.per > 0 ? m_options.per : 1,
+    [this]() {
+      m_is_lease_return_scheduled = false;
+      return_lease();
+    }
+  );
+  m_is_lease_return_scheduled = true;
+}
+
+void Quota::return_lease() {
+  if (m_lease > 0) {
+    auto value = m_lease;
+    m_lease = 0;
+    m_counter->refund(value, m_lease_window);
+  }
+}
+
 void Quota::on_produce() {
   retain();
   while (auto c = m_consumers.head()) {
@@ -331,7 +469,6 @@ void Quota::on_produce() {
       m_consumers.unshift(c);
       break;
     }
-    if (m_current_value <= 0) break;
   }
   release();
 }
@@ -370,6 +507,7 @@ std::mutex Quota::Counter::m_counter_map_mutex;
 
 Quota::Counter::Counter(
   const std::string &key,
+  Mode mode,
   double initial_value,
   double maximum_value,
   double produce_value,
@@ -377,12 +515,14 @@ Quota::Counter::Counter(
 )
   : m_net(Net::current())
   , m_key(key)
+  , m_mode(mode)
   , m_initial_value(initial_value)
   , m_maximum_value(maximum_value)
   , m_produce_value(produce_value)
   , m_produce_cycle(produce_cycle)
   , m_current_value(initial_value)
   , m_is_producing_scheduled(false)
+  , m_waiting(0)
 {
   m_counter_map[key] = this;
 }
@@ -394,6 +534,7 @@ Quota::Counter::~Counter() {
 
 auto Quota::Counter::get(
   const std::string &key,
+  Mode mode,
   double initial_value,
   double maximum_value,
   double produce_value,
@@ -404,14 +545,16 @@ auto Quota::Counter::get(
   if (i != m_counter_map.end()) {
     auto p = i->second;
     if (p->ref_count() > 0) {
-      p->init(initial_value, maximum_value, produce_value, produce_cycle);
+      if (p->m_mode != mode) throw std::runtime_error("quota key '" + key + "' is already used in a different mode");
+      p->init(mode, initial_value, maximum_value, produce_value, produce_cycle);
       return p;
     }
   }
-  return new Counter(key, initial_value, maximum_value, produce_value, produce_cycle);
+  return new Counter(key, mode, initial_value, maximum_value, produce_value, produce_cycle);
 }
 
 void Quota::Counter::init(
+  Mode mode,
   double initial_value,
   double maximum_value,
   double produce_value,
@@ -422,6 +565,10 @@ void Quota::Counter::init(
   m_maximum_value = maximum_value;
   m_produce_value = produce_value;
   m_produce_cycle = produce_cycle;
+  if (mode == SLIDING_WINDOW) {
+    if (initial_value > old_initial_value) on_produce();
+    return;
+  }
   auto old = m_current_value.load();
   for (;;) {
     auto val = old;
@@ -438,21 +585,73 @@ void Quota::Counter::init(
   }
 }
 
+auto Quota::Counter::current() const -> double {
+  if (m_mode == SLIDING_WINDOW) {
+    std::lock_guard<std::mutex> lock(m_window_mutex);
+    auto n = m_window.count(m_produce_cycle * 1000, utils::now());
+    return std::max(0.0, std::floor(m_initial_value - n));
+  }
+  return m_current_value.load();
+}
+
 void Quota::Counter::produce(double value) {
   if (value <= 0) return;
+  if (m_mode == SLIDING_WINDOW) {
+    {
+      std::lock_guard<std::mutex> lock(m_window_mutex);
+      m_window.curr = std::max(0.0, m_window.curr - value);
+    }
+    return on_produce();
+  }
   auto old = m_current_value.load();
   auto max = m_maximum_value.load();
   while (!m_current_value.compare_exchange_weak(old, std::min(max, old + value)));
   on_produce();
 }
 
-auto Quota::Counter::consume(double value) -> double {
+void Quota::Counter::refund(double value, double window) {
+  if (value <= 0) return;
+  if (m_mode == SLIDING_WINDOW) {
+    std::lock_guard<std::mutex> lock(m_window_mutex);
+    auto period = m_produce_cycle * 1000;
+    m_window.roll(period, utils::now());
+    if (window == m_window.start) {
+      m_window.curr = std::max(0.0, m_window.curr - value);
+    } else if (window + period == m_window.start) {
+      m_window.prev = std::max(0.0, m_window.prev - value);
+    } else {
+      return;
+    }
+  } else {
+    auto old = m_current_value.load();
+    auto max = m_maximum_value.load();
+    while (!m_current_value.compare_exchange_weak(old, std::max(old, std::min(max, old + value))));
+  }
+  on_produce();
+}
+
+auto Quota::Counter::consume(double value, double *window) -> double {
   if (value <= 0) return 0;
-  auto old = m_current_value.load();
   auto dec = value;
-  for (;;) {
-    dec = std::min(value, old);
-    if (m_current_value.compare_exchange_weak(old, old - dec)) break;
+  if (m_mode == SLIDING_WINDOW) {
+    std::lock_guard<std::mutex> lock(m_window_mutex);
+    auto period = m_produce_cycle * 1000;
+    auto now = utils::now();
+    m_window.roll(period, now);
+    if (window) *window = m_window.start;
+    auto room = std::floor(m_initial_value - m_window.count(period, now));
+    if (value < room) {
+      m_window.curr += value;
+      return value;
+    }
+    dec = std::max(0.0, room);
+    m_window.curr += dec;
+  } else {
+    auto old = m_current_value.load();
+    for (;;) {
+      dec = std::min(value, old);
+      if (m_current_value.compare_exchange_weak(old, old - dec)) break;
+    }
   }
   schedule_producing();
   return dec;
@@ -461,11 +660,13 @@ auto Quota::Counter::consume(double value) -> double {
 void Quota::Counter::enqueue(Quota *quota) {
   std::lock_guard<std::mutex> lock(m_quotas_mutex);
   m_quotas.insert(quota);
+  m_waiting.store(m_quotas.size(), std::memory_order_relaxed);
 }
 
 void Quota::Counter::dequeue(Quota *quota) {
   std::lock_guard<std::mutex> lock(m_quotas_mutex);
   m_quotas.erase(quota);
+  m_waiting.store(m_quotas.size(), std::memory_order_relaxed);
 }
 
 void Quota::Counter::schedule_producing() {
@@ -475,6 +676,16 @@ void Quota::Counter::schedule_producing() {
   retain();
   m_net.post(
     [this]() {
+      if (m_mode == SLIDING_WINDOW) {
+        m_timer.schedule(
+          m_produce_cycle / 10, [this]() {
+            m_is_producing_scheduled.store(false);
+            on_produce();
+          }
+        );
+        release();
+        return;
+      }
       m_timer.schedule(
         m_produce_cycle, [this]() {
           m_is_producing_scheduled.store(false);
@@ -510,6 +721,9 @@ void Quota::Counter::finalize() {
 //
 // SharedMap
 //
+// Entries looked up by a thread are cached in that thread's SharedMap object,
+// so that numeric reads and updates on hot keys go lock-free.
+//
 
 SharedMap::SharedMap(pjs::Str *name)
   : m_map(Map::get(name->str()))
@@ -522,17 +736,26 @@ auto SharedMap::size() -> size_t {
 
 void SharedMap::clear() {
   m_map->clear();
+  m_cache.clear();
 }
 
 bool SharedMap::erase(pjs::Str *key) {
+  m_cache.erase(key);
   return m_map->erase(key->data());
 }
 
 bool SharedMap::has(pjs::Str *key) {
-  return m_map->has(key->data());
+  return entry(key);
 }
 
 bool SharedMap::get(pjs::Str *key, pjs::Value &value) {
+  if (auto e = entry(key)) {
+    double n;
+    if (e->get_number(n)) {
+      value.set(n);
+      return true;
+    }
+  }
   pjs::SharedValue sv;
   if (m_map->get(key->data(), sv)) {
     sv.to_value(value);
@@ -543,16 +766,43 @@ bool SharedMap::get(pjs::Str *key, pjs::Value &value) {
 }
 
 void SharedMap::set(pjs::Str *key, const pjs::Value &value) {
-  pjs::SharedValue sv(value);
-  m_map->set(key->data(), sv);
+  m_map->set(key->data(), value);
 }
 
 auto SharedMap::add(pjs::Str *key, double value) -> double {
-  return m_map->add(key->data(), value);
+  if (auto e = entry(key)) return e->add(value);
+  return std::numeric_limits<double>::quiet_NaN();
 }
 
 auto SharedMap::sub(pjs::Str *key, double value) -> double {
-  return m_map->sub(key->data(), value);
+  if (auto e = entry(key)) return e->add(-value);
+  return std::numeric_limits<double>::quiet_NaN();
+}
+
+void SharedMap::for_each_contention(const std::function<void(const std::string &, int, uint64_t)> &cb) {
+  std::lock_guard<std::mutex> lock(Map::m_maps_mutex);
+  for (const auto &i : Map::m_maps) {
+    auto m = i.second;
+    for (int j = 0; j < Map::SHARDS; j++) {
+      if (auto n = m->m_shards[j].contentions.load(std::memory_order_relaxed)) {
+        cb(i.first, j, n);
+      }
+    }
+  }
+}
+
+auto SharedMap::entry(pjs::Str *key) -> Map::Entry* {
+  auto i = m_cache.find(key);
+  if (i != m_cache.end()) {
+    auto e = i->second.get();
+    if (!e->is_erased()) return e;
+    m_cache.erase(i);
+  }
+  auto e = m_map->find(key->data());
+  if (!e) return nullptr;
+  if (m_cache.size() >= MAX_CACHE_SIZE) m_cache.clear();
+  m_cache[key] = e;
+  return e;
 }
 
 //
@@ -567,83 +817,143 @@ auto SharedMap::Map::get(const std::string &name) -> Map* {
   auto &p = m_maps[name];
   if (!p) {
     p = new Map;
+    p->m_name = name;
     p->retain();
   }
   return p;
 }
 
 auto SharedMap::Map::size() -> size_t {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  return m_map.size();
+  size_t n = 0;
+  for (auto &s : m_shards) {
+    Lock lock(s);
+    n += s.map.size();
+  }
+  return n;
 }
 
 void SharedMap::Map::clear() {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  m_map.clear();
+  for (auto &s : m_shards) {
+    Lock lock(s);
+    for (const auto &i : s.map) i.second->erase();
+    s.map.clear();
+  }
 }
 
 bool SharedMap::Map::erase(pjs::Str::CharData *key) {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  auto i = m_map.find(key);
-  if (i == m_map.end()) return false;
-  m_map.erase(i);
+  auto &s = shard(key);
+  Lock lock(s);
+  auto i = s.map.find(key);
+  if (i == s.map.end()) return false;
+  i->second->erase();
+  s.map.erase(i);
   return true;
 }
 
 bool SharedMap::Map::has(pjs::Str::CharData *key) {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  auto i = m_map.find(key);
-  return i != m_map.end();
+  auto &s = shard(key);
+  Lock lock(s);
+  auto i = s.map.find(key);
+  return i != s.map.end();
 }
 
 bool SharedMap::Map::get(pjs::Str::CharData *key, pjs::SharedValue &value) {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  auto i = m_map.find(key);
-  if (i == m_map.end()) return false;
-  value = i->second;
+  auto &s = shard(key);
+  Lock lock(s);
+  auto i = s.map.find(key);
+  if (i == s.map.end()) return false;
+  i->second->get(value);
   return true;
 }
 
-void SharedMap::Map::set(pjs::Str::CharData *key, const pjs::SharedValue &value) {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  m_map[key] = value;
+void SharedMap::Map::set(pjs::Str::CharData *key, const pjs::Value &value) {
+  auto &s = shard(key);
+  Lock lock(s);
+  auto &e = s.map[key];
+  if (!e) e = new Entry;
+  e->set(value);
 }
 
-auto SharedMap::Map::add(pjs::Str::CharData *key, double value) -> double {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  auto i = m_map.find(key);
-  if (i == m_map.end()) return std::numeric_limits<double>::quiet_NaN();
-  pjs::Value v;
-  i->second.to_value(v);
-  if (!v.is_number()) return std::numeric_limits<double>::quiet_NaN();
-  v.set(v.n() + value);
-  i->second = v;
-  return v.n();
+auto SharedMap::Map::find(pjs::Str::CharData *key) -> pjs::Ref<Entry> {
+  auto &s = shard(key);
+  Lock lock(s);
+  auto i = s.map.find(key);
+  if (i == s.map.end()) return nullptr;
+  return i->second;
 }
 
-auto SharedMap::Map::sub(pjs::Str::CharData *key, double value) -> double {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  auto i = m_map.find(key);
-  if (i == m_map.end()) return std::numeric_limits<double>::quiet_NaN();
-  pjs::Value v;
-  i->second.to_value(v);
-  if (!v.is_number()) return std::numeric_limits<double>::quiet_NaN();
-  v.set(v.n() - value);
-  i->second = v;
-  return v.n();
+//
+// SharedMap::Map::Entry
+//
+// Numbers are kept as atomic bits so they can be updated without a lock.
+// Other values are only accessed with the shard locked.
+//
+
+bool SharedMap::Map::Entry::get_number(double &value) const {
+  if (!m_is_number.load(std::memory_order_acquire)) return false;
+  auto bits = m_number.load(std::memory_order_relaxed);
+  std::memcpy(&value, &bits, sizeof(value));
+  return true;
+}
+
+auto SharedMap::Map::Entry::add(double value) -> double {
+  auto bits = m_number.load(std::memory_order_relaxed);
+  for (;;) {
+    if (!m_is_number.load(std::memory_order_acquire)) {
+      return std::numeric_limits<double>::quiet_NaN();
+    }
+    double n;
+    std::memcpy(&n, &bits, sizeof(n));
+    n += value;
+    uint64_t new_bits;
+    std::memcpy(&new_bits, &n, sizeof(n));
+    if (m_number.compare_exchange_weak(bits, new_bits, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+      return n;
+    }
+  }
+}
+
+void SharedMap::Map::Entry::get(pjs::SharedValue &value) const {
+  double n;
+  if (get_number(n)) {
+    value = pjs::Value(n);
+  } else {
+    value = m_value;
+  }
+}
+
+void SharedMap::Map::Entry::set(const pjs::Value &value) {
+  if (value.is_number()) {
+    auto n = value.n();
+    uint64_t bits;
+    std::memcpy(&bits, &n, sizeof(n));
+    m_value = pjs::Value::empty;
+    m_number.store(bits, std::memory_order_relaxed);
+    m_is_number.store(true, std::memory_order_release);
+  } else {
+    m_is_number.store(false, std::memory_order_release);
+    m_value = value;
+  }
 }
 
 //
 // URLRouter
 //
 
-URLRouter::URLRouter()
-  : m_root(new Node())
+URLRouter::Options::Options(pjs::Object *options) {
+  Value(options, "params")
+    .get(params)
+    .check_nullable();
+}
+
+URLRouter::URLRouter(const Options &options)
+  : m_options(options)
+  , m_paths(1, new Tree)
 {
 }
 
-URLRouter::URLRouter(pjs::Object *rules)
-  : URLRouter()
+URLRouter::URLRouter(pjs::Object *rules, const Options &options)
+  : URLRouter(options)
 {
   if (rules) {
     rules->iterate_all(
@@ -655,46 +965,38 @@ URLRouter::URLRouter(pjs::Object *rules)
 }
 
 URLRouter::~URLRouter() {
-  delete m_root;
+  for (auto *t : m_paths) delete t;
 }
 
 void URLRouter::add(const std::string &url, const pjs::Value &value) {
-  auto segs = utils::split(url, '/');
-  auto domain = segs.front();
-  segs.pop_front();
-
-  if (segs.empty() || domain.find_first_of(':') != std::string::npos) {
+  auto path_start = url.find_first_of('/');
+  if (path_start == std::string::npos || url.find_first_of(':') < path_start) {
     throw std::runtime_error("invalid URL pattern");
   }
 
-  auto node = m_root;
-
-  if (!domain.empty()) {
-    auto segs = utils::split(domain, '.');
-    for (const auto &seg : segs) {
-      node = node->new_child(seg);
+  int *slot = nullptr;
+  if (path_start > 0) {
+    auto domain = url.substr(0, path_start);
+    bool is_wildcard = (domain.length() > 2 && domain[0] == '*' && domain[1] == '.');
+    auto host = is_wildcard ? m_wildcard_hosts.add(domain.substr(2)) : m_hosts.add(domain);
+    if (*host < 0) {
+      *host = m_paths.size();
+      m_paths.push_back(new Tree);
     }
+    slot = m_paths[*host]->add(url.substr(path_start), m_options.params);
+  } else {
+    slot = m_paths[0]->add(url, m_options.params);
   }
 
-  node = node->new_child("/");
-
-  if (segs.back() == "*") {
-    for (const auto &seg : segs) {
-      if (!seg.empty()) {
-        node = node->new_child(seg);
-      }
-    }
-    node->value = value;
+  if (*slot < 0) {
+    *slot = m_values.size();
+    m_values.push_back(value);
   } else {
-    auto i = url.find_first_of('/');
-    node->new_child(url.substr(i))->value = value;
+    m_values[*slot] = value;
   }
 }
 
-bool URLRouter::find(const std::string &url, pjs::Value &value) {
-  static const std::string s_slash("/");
-  static const std::string s_asterisk("*");
-
+bool URLRouter::find(const std::string &url, pjs::Value &value, pjs::Object *params) {
   auto path_start = url.find_first_of('/');
   if (path_start == std::string::npos) return false;
 
@@ -704,71 +1006,220 @@ bool URLRouter::find(const std::string &url, pjs::Value &value) {
   auto domain_end = url.find_last_of(':', path_start);
   if (domain_end == std::string::npos) domain_end = path_start;
 
-  std::function<Node*(Node*, int)> find_host, find_path;
-
-  find_host = [&](Node *node, int p) -> Node* {
-    auto i = p;
-    while (i < domain_end && url[i] != '.') i++;
-    auto s = url.substr(p, i - p);
-    node = node->child(s);
-    if (!node) return nullptr;
-    p = i + 1;
-    if (p <= domain_end) return find_host(node, p);
-    node = node->child(s_slash);
-    if (!node) return nullptr;
-    if (auto exact = node->child(url.substr(path_start, path_end - path_start))) {
-      return exact;
-    }
-    return find_path(node, path_start + 1);
-  };
+  auto str = url.c_str();
+  auto path = str + path_start;
+  auto path_len = path_end - path_start;
+
+  Tree::Captures captures;
+  int host = -1, slot = -1;
+  bool found = false;
 
-  find_path = [&](Node *node, int p) -> Node* {
-    auto i = p;
-    while (i < path_end && url[i] != '/') i++;
-    auto s = url.substr(p, i - p);
-    if (auto c = node->child(s)) {
-      p = i + 1;
-      c = p >= path_end ? c->child(s_asterisk) : find_path(c, p);
-      if (c) return c;
+  if (domain_end > 0) {
+    if (m_hosts.find(str, domain_end, host, captures)) {
+      found = m_paths[host]->find(path, path_len, slot, captures);
     }
-    if (auto c = node->child(s_asterisk)) return c;
-    return nullptr;
+    if (!found) {
+      auto i = url.find_first_of('.');
+      if (i < domain_end && m_wildcard_hosts.find(str + i + 1, domain_end - i - 1, host, captures)) {
+        found = m_paths[host]->find(path, path_len, slot, captures);
+      }
+    }
+  }
+
+  if (!found) {
+    found = m_paths[0]->find(path, path_len, slot, captures);
+  }
+
+  if (!found) return false;
+
+  value = m_values[slot];
+
+  if (params) {
+    for (int i = 0; i < captures.size; i++) {
+      const auto &c = captures.items[i];
+      params->set(c.name, pjs::Str::make(path + c.start, c.length));
+    }
+  }
+
+  return true;
+}
+
+//
+// URLRouter::Tree
+//
+
+auto URLRouter::Tree::add(const std::string &pattern, bool params) -> int* {
+  auto n = pattern.length();
+  auto end = n;
+  auto is_wildcard = false;
+  if (n >= 2 && pattern[n-1] == '*' && pattern[n-2] == '/') {
+    is_wildcard = true;
+    end = n - 2;
+  }
+
+  auto node = m_root;
+  auto num_params = 0;
+  size_t i = 0;
+
+  // Without the params option, ':' is an ordinary character so that
+  // routes written before `:name` segments existed keep matching literally
+  auto is_param = [&](size_t i) {
+    return params && i > 0 && pattern[i] == ':' && pattern[i-1] == '/';
   };
 
-  auto node = find_host(m_root, 0);
-  if (!node) {
-    auto i = 0;
-    while (i < domain_end && url[i] != '.') i++;
-    if (i < domain_end) {
-      if (auto c = m_root->child(s_asterisk)) {
-        node = find_host(c, i + 1);
+  while (i < end) {
+    if (is_param(i)) {
+      auto j = pattern.find_first_of('/', i);
+      if (j == std::string::npos || j > end) j = end;
+      auto name = pattern.substr(i + 1, j - i - 1);
+      if (name.empty()) throw std::runtime_error("invalid URL pattern");
+      if (++num_params >= MAX_CAPTURES) throw std::runtime_error("too many parameters in URL pattern");
+      if (!node->param) {
+        node->param = new Node;
+        node->param->name = name;
+      } else if (node->param->name != name) {
+        throw std::runtime_error("conflicting parameter names in URL pattern");
       }
+      node = node->param;
+      i = j;
+    } else {
+      auto j = i;
+      while (j < end && !is_param(j)) j++;
+      node = insert(node, pattern, i, j);
+      i = j;
     }
   }
-  if (!node) {
-    if (auto c = m_root->child(s_slash)) {
-      if (auto exact = c->child(url.substr(path_start, path_end - path_start))) {
-        node = exact;
-      } else {
-        node = find_path(c, path_start + 1);
-      }
+
+  m_compiled = false;
+  return is_wildcard ? &node->wildcard : &node->value;
+}
+
+auto URLRouter::Tree::insert(Node *node, const std::string &str, size_t i, size_t j) -> Node* {
+  while (i < j) {
+    auto &children = node->children;
+    auto p = std::lower_bound(
+      children.begin(), children.end(), str[i],
+      [](Node *a, char b) { return a->label[0] < b; }
+    );
+
+    if (p == children.end() || (*p)->label[0] != str[i]) {
+      auto c = new Node;
+      c->label = str.substr(i, j - i);
+      children.insert(p, c);
+      return c;
+    }
+
+    auto c = *p;
+    size_t k = 0;
+    while (k < c->label.length() && i + k < j && c->label[k] == str[i + k]) k++;
+
+    if (k < c->label.length()) {
+      auto m = new Node;
+      m->label = c->label.substr(0, k);
+      c->label.erase(0, k);
+      m->children.push_back(c);
+      *p = m;
+      c = m;
     }
+
+    node = c;
+    i += k;
   }
+  return node;
+}
 
-  if (node) {
-    value = node->value;
-    return true;
+//
+// Nodes are laid out breadth-first so that children of the same node
+// are adjacent, with the first bytes of their labels in a separate array
+// for a quick scan. A parameter child always follows the static children.
+//
+
+void URLRouter::Tree::compile() {
+  thread_local static const pjs::ConstStr s_asterisk("*");
+
+  std::vector<Node*> queue(1, m_root);
+  m_nodes.clear();
+  m_first.clear();
+  m_labels.clear();
+  m_names.clear();
+  m_names.push_back(s_asterisk.get());
+
+  for (size_t i = 0; i < queue.size(); i++) {
+    auto node = queue[i];
+    Compiled c;
+    c.label = m_labels.length();
+    c.length = node->label.length();
+    c.children = queue.size();
+    c.count = node->children.size();
+    c.param = -1;
+    c.name = -1;
+    c.value = node->value;
+    c.wildcard = node->wildcard;
+    m_labels += node->label;
+    for (auto *child : node->children) queue.push_back(child);
+    if (node->param) {
+      c.param = queue.size();
+      queue.push_back(node->param);
+    }
+    if (!node->name.empty()) {
+      c.name = m_names.size();
+      m_names.push_back(pjs::Str::make(node->name));
+    }
+    m_nodes.push_back(c);
+    m_first.push_back(node->label.empty() ? 0 : node->label[0]);
   }
 
-  return false;
+  m_compiled = true;
 }
 
-void URLRouter::dump(Node *node, int level) {
-  for (auto &i : node->children) {
-    std::cout << std::string(level * 2, ' ');
-    std::cout << i.first << std::endl;
-    dump(i.second, level + 1);
+bool URLRouter::Tree::find(const char *str, size_t len, int &slot, Captures &captures) {
+  if (!m_compiled) compile();
+  captures.size = 0;
+  return match(str, len, 0, 0, slot, captures);
+}
+
+bool URLRouter::Tree::match(const char *str, size_t len, size_t p, size_t i, int &slot, Captures &captures) {
+  const auto &node = m_nodes[i];
+
+  if (p == len && node.value >= 0) {
+    slot = node.value;
+    return true;
+  }
+
+  if (p < len) {
+    if (node.count > 0) {
+      auto first = &m_first[node.children];
+      if (auto k = (const char *)std::memchr(first, str[p], node.count)) {
+        auto j = node.children + (k - first);
+        const auto &c = m_nodes[j];
+        if (c.length <= len - p && !std::memcmp(&m_labels[c.label], str + p, c.length)) {
+          if (match(str, len, p + c.length, j, slot, captures)) return true;
+        }
+      }
+    }
+
+    if (node.param >= 0 && str[p] != '/' && captures.size < MAX_CAPTURES) {
+      auto q = p;
+      while (q < len && str[q] != '/') q++;
+      auto &c = captures.items[captures.size++];
+      c.name = m_names[m_nodes[node.param].name];
+      c.start = p;
+      c.length = q - p;
+      if (match(str, len, q, node.param, slot, captures)) return true;
+      captures.size--;
+    }
+  }
+
+  if (node.wildcard >= 0 && (p == len || str[p] == '/') && captures.size < MAX_CAPTURES) {
+    auto &c = captures.items[captures.size++];
+    c.name = m_names[0];
+    c.start = (p < len ? p + 1 : p);
+    c.length = len - c.start;
+    slot = node.wildcard;
+    return true;
   }
+
+  return false;
 }
 
 //
@@ -789,6 +1240,10 @@ LoadBalancer::Options::Options(pjs::Object *options) {
     .get(capacity)
     .get(capacity_f)
     .check_nullable();
+  Value(options, "decay")
+    .get_seconds(decay)
+    .check_nullable();
+  if (decay <= 0) throw std::runtime_error("options.decay must be greater than zero");
 }
 
 LoadBalancer::~LoadBalancer() {
@@ -913,7 +1368,7 @@ auto LoadBalancer::allocate(pjs::Context &ctx, const pjs::Value &key, pjs::Funct
 }
 
 auto LoadBalancer::next(const std::function<bool(const pjs::Value &)> &validator) -> Pool* {
-  pjs::Value val;
+  if (m_options.algorithm == P2C_EWMA) return next_p2c(validator);
   for (auto p = m_queue.head(); p; p = p->next()) {
     if (p->weight > 0 && (!validator || validator(p->target))) {
       increase_load(p);
@@ -923,6 +1378,60 @@ auto LoadBalancer::next(const std::function<bool(const pjs::Value &)> &validator
   return nullptr;
 }
 
+//
+// Power of two choices: compare two random targets by their decayed peak
+// latency multiplied by the number of requests in flight.
+//
+
+auto LoadBalancer::next_p2c(const std::function<bool(const pjs::Value &)> &validator) -> Pool* {
+  auto n = m_pools.size();
+  if (!n) return nullptr;
+
+  auto is_valid = [&](Pool *p) {
+    return p->weight > 0 && (!validator || validator(p->target));
+  };
+
+  auto pick = [&](Pool *other) -> Pool* {
+    for (int i = 0; i < 3; i++) {
+      auto p = m_pools[m_rand() % n].get();
+      if (p != other && is_valid(p)) return p;
+    }
+    return nullptr;
+  };
+
+  auto a = pick(nullptr);
+  if (!a) {
+    for (const auto &p : m_pools) {
+      if (is_valid(p)) {
+        a = p;
+        break;
+      }
+    }
+    if (!a) return nullptr;
+  }
+
+  auto b = (n > 1 ? pick(a) : nullptr);
+  if (!b) return a;
+
+  auto now = utils::now();
+  auto decay = m_options.decay * 1000;
+  auto ca = a->cost(now, decay, m_latency);
+  auto cb = b->cost(now, decay, m_latency);
+  return ca <= cb ? a : b;
+}
+
+void LoadBalancer::observe(Pool *pool, double rtt, double now) {
+  auto decay = m_options.decay * 1000;
+  pool->observe(rtt, now, decay);
+  if (m_latency_time > 0) {
+    auto w = std::exp(-std::max(0.0, now - m_latency_time) / decay);
+    m_latency = m_latency * w + rtt * (1 - w);
+  } else {
+    m_latency = rtt;
+  }
+  m_latency_time = now;
+}
+
 void LoadBalancer::increase_load(Pool *pool) {
   pool->load += pool->step;
   sort_forward(m_queue, pool);
@@ -972,10 +1481,30 @@ auto LoadBalancer::Pool::allocate() -> Resource* {
     m_resources.unshift(r);
   }
   r->increase_load();
+  pending++;
   return r;
 }
 
+void LoadBalancer::Pool::observe(double rtt, double now, double decay) {
+  if (latency_time <= 0 || rtt > latency) {
+    latency = rtt;
+  } else {
+    auto w = std::exp(-std::max(0.0, now - latency_time) / decay);
+    latency = latency * w + rtt * (1 - w);
+  }
+  latency_time = now;
+}
+
+auto LoadBalancer::Pool::cost(double now, double decay, double fallback) const -> double {
+  auto rtt = fallback;
+  if (latency_time > 0) {
+    rtt = latency * std::exp(-std::max(0.0, now - latency_time) / decay);
+  }
+  return (rtt + 1) * (pending + 1) / weight;
+}
+
 LoadBalancer::Resource::~Resource() {
+  m_pool->pending -= m_load;
   m_pool->m_resources.remove(this);
 }
 
@@ -983,9 +1512,15 @@ void LoadBalancer::Resource::free() {
   if (auto lb = m_pool->lb) {
     if (lb->m_options.algorithm == Algorithm::LEAST_LOAD) {
       lb->decrease_load(m_pool);
+    } else if (lb->m_options.algorithm == Algorithm::P2C_EWMA && !m_start_times.empty()) {
+      auto now = utils::now();
+      auto start = m_start_times.front();
+      m_start_times.pop_front();
+      lb->observe(m_pool, now - start, now);
     }
   }
   if (m_load > 0) {
+    m_pool->pending--;
     m_load--;
     if (auto r = back()) {
       while (r && r->m_load > m_load) {
@@ -1006,6 +1541,11 @@ void LoadBalancer::Resource::free() {
 
 void LoadBalancer::Resource::increase_load() {
   m_load++;
+  if (auto lb = m_pool->lb) {
+    if (lb->m_options.algorithm == Algorithm::P2C_EWMA) {
+      m_start_times.push_back(utils::now());
+    }
+  }
   if (auto r = next()) {
     while (r && r->m_load <= m_load) {
       r = r->next();
@@ -1118,52 +1658,408 @@ void LoadBalancerBase::Session::on_weak_ptr_gone() {
   m_lb->close_session(this);
 }
 
+//
+// HashingLoadBalancer::Options
+//
+
+HashingLoadBalancer::Options::Options(pjs::Object *options) {
+  Value(options, "algorithm")
+    .get_enum<HashingLoadBalancer::Algorithm>(algorithm)
+    .check_nullable();
+  Value(options, "replicas")
+    .get(replicas)
+    .check_nullable();
+  Value(options, "tableSize")
+    .get(table_size)
+    .check_nullable();
+  Value(options, "boundedLoad")
+    .get(bounded_load)
+    .check_nullable();
+  if (replicas < 1) throw std::runtime_error("options.replicas must be a positive number");
+  if (table_size < 1) throw std::runtime_error("options.tableSize must be a positive number");
+  if (bounded_load != 0 && bounded_load < 1) throw std::runtime_error("options.boundedLoad must be no less than 1");
+}
+
 //
 // HashingLoadBalancer
 //
+// Ring points and Maglev permutations are derived from target names only,
+// so that every instance maps the same keys to the same targets. Maglev
+// tables are patched in place as targets come and go, which moves only the
+// keys that have to move, so instances agree as long as they have seen the
+// same changes in the same order.
+//
+
+static auto mix_hash(uint64_t h) -> uint64_t {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+static bool is_prime(int n) {
+  if (n < 2) return false;
+  for (int i = 2; i * i <= n; i++) if (n % i == 0) return false;
+  return true;
+}
 
-HashingLoadBalancer::HashingLoadBalancer(pjs::Object *targets, Cache *unhealthy)
+HashingLoadBalancer::HashingLoadBalancer(pjs::Object *targets, Cache *unhealthy, const Options &options)
   : pjs::ObjectTemplate<HashingLoadBalancer, LoadBalancerBase>(unhealthy)
+  , m_options(options)
 {
+  while (!is_prime(m_options.table_size)) m_options.table_size++;
   set(targets);
 }
 
-HashingLoadBalancer::~HashingLoadBalancer()
-{
+HashingLoadBalancer::~HashingLoadBalancer() {
+  for (const auto &i : m_target_map) {
+    delete i.second;
+  }
 }
 
 void HashingLoadBalancer::set(pjs::Object *targets) {
-  if (targets) {
-    m_targets.clear();
-    if (targets->is_array()) {
-      targets->as<pjs::Array>()->iterate_all(
-        [this](pjs::Value &v, int i) {
-          auto s = v.to_string();
-          m_targets.push_back(s);
-          s->release();
-        }
-      );
-    } else {
-      targets->iterate_all(
-        [this](pjs::Str *k, pjs::Value &) {
-          m_targets.push_back(k);
-        }
-      );
+  if (!targets) return;
+
+  for (const auto &i : m_target_map) {
+    auto t = i.second;
+    t->removed = true;
+    t->slots = 0;
+  }
+
+  m_targets.clear();
+
+  auto update = [this](pjs::Str *id, int weight) {
+    auto &t = m_target_map[id];
+    if (!t) {
+      std::hash<std::string> hash;
+      t = new Target;
+      t->id = id;
+      t->hash = mix_hash(hash(id->str()));
+      t->weight = 0;
+    }
+    t->removed = false;
+    for (int i = 0; i < weight; i++) {
+      m_targets.push_back(t);
+      t->slots++;
     }
+  };
+
+  if (targets->is_array()) {
+    targets->as<pjs::Array>()->iterate_all(
+      [&](pjs::Value &v, int) {
+        auto s = v.to_string();
+        update(s, 1);
+        s->release();
+      }
+    );
+  } else {
+    targets->iterate_all(
+      [&](pjs::Str *k, pjs::Value &v) {
+        update(k, v.is_undefined() ? 1 : v.to_int32());
+      }
+    );
   }
+
+  rebuild();
 }
 
 void HashingLoadBalancer::add(pjs::Str *target) {
-  m_targets.push_back(target);
+  for (const auto &i : m_target_map) {
+    auto t = i.second;
+    t->slots = t->weight;
+  }
+
+  auto &t = m_target_map[target];
+  if (!t) {
+    std::hash<std::string> hash;
+    t = new Target;
+    t->id = target;
+    t->hash = mix_hash(hash(target->str()));
+    t->weight = 0;
+  }
+
+  t->slots++;
+  m_targets.push_back(t);
+  rebuild();
+}
+
+void HashingLoadBalancer::rebuild() {
+  bool changed = false;
+  for (const auto &i : m_target_map) {
+    auto t = i.second;
+    if (t->removed || t->slots != t->weight) {
+      t->dirty = true;
+      changed = true;
+    }
+  }
+
+  if (!changed) return;
+
+  if (m_options.algorithm == RING_HASH) {
+    m_ring.erase(
+      std::remove_if(
+        m_ring.begin(), m_ring.end(),
+        [](const Point &p) { return p.target->dirty; }
+      ),
+      m_ring.end()
+    );
+    auto n = m_ring.size();
+    for (const auto &i : m_target_map) {
+      auto t = i.second;
+      if (!t->dirty || t->removed) continue;
+      auto count = t->slots * m_options.replicas;
+      for (int j = 0; j < count; j++) {
+        m_ring.push_back({ mix_hash(t->hash + j * 0x9e3779b97f4a7c15ull), t });
+      }
+    }
+    std::sort(m_ring.begin() + n, m_ring.end());
+    std::inplace_merge(m_ring.begin(), m_ring.begin() + n, m_ring.end());
+    build_ring_index();
+  }
+
+  if (m_options.algorithm == MAGLEV) update_table();
+
+  m_total_weight = 0;
+  m_total_load = 0;
+  for (auto i = m_target_map.begin(); i != m_target_map.end(); ) {
+    auto t = i->second;
+    if (t->removed) {
+      m_target_map.erase(i++);
+      delete t;
+    } else {
+      t->weight = t->slots;
+      t->dirty = false;
+      m_total_weight += t->weight;
+      m_total_load += t->load;
+      i++;
+    }
+  }
+}
+
+//
+// The ring is indexed by the top bits of the point hashes, with about
+// one point per bucket, so that a lookup only searches a single bucket
+//
+
+void HashingLoadBalancer::build_ring_index() {
+  auto n = m_ring.size();
+  m_ring_bits = 0;
+  while (m_ring_bits < 32 && (size_t(1) << m_ring_bits) < n) m_ring_bits++;
+  auto buckets = size_t(1) << m_ring_bits;
+  m_ring_index.resize(buckets + 1);
+  size_t i = 0;
+  for (size_t b = 0; b < buckets; b++) {
+    while (i < n && ring_bucket(m_ring[i].hash) < b) i++;
+    m_ring_index[b] = i;
+  }
+  m_ring_index[buckets] = n;
+}
+
+void HashingLoadBalancer::build_table() {
+  std::vector<Target*> targets;
+  for (const auto &i : m_target_map) {
+    auto t = i.second;
+    t->count = 0;
+    if (!t->removed && t->slots > 0) {
+      targets.push_back(t);
+    }
+  }
+
+  m_table.clear();
+  if (targets.empty()) return;
+
+  auto size = size_t(m_options.table_size);
+  for (auto *t : targets) {
+    t->offset = t->hash % size;
+    t->skip = mix_hash(t->hash) % (size - 1) + 1;
+    t->next = 0;
+  }
+
+  m_table.assign(size, nullptr);
+  fill_table(targets, size);
+}
+
+void HashingLoadBalancer::update_table() {
+  auto size = size_t(m_options.table_size);
+  if (m_table.size() != size) return build_table();
+
+  std::vector<Target*> targets, added;
+  int total_weight = 0;
+  for (const auto &i : m_target_map) {
+    auto t = i.second;
+    if (t->removed || !t->slots) continue;
+    if (!t->weight) {
+      added.push_back(t);
+    } else if (t->slots != t->weight) {
+      return build_table();
+    }
+    targets.push_back(t);
+    total_weight += t->slots;
+  }
+
+  if (targets.empty()) {
+    m_table.clear();
+    return;
+  }
+
+  // Slots of the targets that are gone are freed first...
+  size_t free = 0;
+  for (auto &t : m_table) {
+    if (t->removed || !t->slots) {
+      t = nullptr;
+      free++;
+    }
+  }
+
+  // ...then new targets take their share along their own permutations
+  // from whoever holds more than theirs...
+  auto quota = [&](Target *t) { return size * t->slots / total_weight; };
+  std::sort(added.begin(), added.end(), [](Target *a, Target *b) { return a->id->str() < b->id->str(); });
+  for (auto *t : added) {
+    t->offset = t->hash % size;
+    t->skip = mix_hash(t->hash) % (size - 1) + 1;
+    t->next = 0;
+    t->count = 0;
+    auto q = quota(t);
+    for (size_t i = 0; i < size && t->count < q; i++) {
+      auto c = (t->offset + t->next++ * t->skip) % size;
+      auto owner = m_table[c];
+      if (!owner) {
+        free--;
+      } else if (owner != t && owner->count > quota(owner)) {
+        owner->count--;
+      } else {
+        continue;
+      }
+      m_table[c] = t;
+      t->count++;
+    }
+  }
+
+  // ...and what is left free goes round by weight
+  fill_table(targets, free);
+}
+
+void HashingLoadBalancer::fill_table(std::vector<Target*> &targets, size_t free) {
+  std::sort(targets.begin(), targets.end(), [](Target *a, Target *b) { return a->id->str() < b->id->str(); });
+
+  int max_weight = 0;
+  for (auto *t : targets) max_weight = std::max(max_weight, t->slots);
+
+  auto n = targets.size();
+  std::vector<int> credit(n, 0);
+  while (free > 0) {
+    for (size_t i = 0; i < n && free > 0; i++) {
+      credit[i] += targets[i]->slots;
+      while (credit[i] >= max_weight && free > 0) {
+        credit[i] -= max_weight;
+        claim_slot(targets[i]);
+        free--;
+      }
+    }
+  }
+}
+
+void HashingLoadBalancer::claim_slot(Target *t) {
+  auto size = m_table.size();
+  for (;;) {
+    if (t->next >= size) t->next = 0;
+    auto c = (t->offset + t->next++ * t->skip) % size;
+    if (!m_table[c]) {
+      m_table[c] = t;
+      t->count++;
+      return;
+    }
+  }
+}
+
+auto HashingLoadBalancer::candidate(size_t i) const -> Target* {
+  switch (m_options.algorithm) {
+    case RING_HASH: return m_ring[i % m_ring.size()].target;
+    case MAGLEV: return m_table[i % m_table.size()];
+    default: return m_targets[i % m_targets.size()];
+  }
 }
 
 auto HashingLoadBalancer::select(const pjs::Value &key, Cache *unhealthy) -> pjs::Str* {
-  if (m_targets.empty()) return nullptr;
   std::hash<pjs::Value> hash;
   auto h = hash(key);
-  auto s = m_targets[h % m_targets.size()].get();
-  if (s && !is_healthy(s, unhealthy)) return nullptr;
-  return s;
+  size_t n = 0, start = 0;
+
+  switch (m_options.algorithm) {
+    case RING_HASH: {
+      n = m_ring.size();
+      if (!n) return nullptr;
+      Point p = { mix_hash(h), nullptr };
+      auto b = ring_bucket(p.hash);
+      auto first = m_ring.begin() + m_ring_index[b];
+      auto last = m_ring.begin() + m_ring_index[b + 1];
+      start = std::lower_bound(first, last, p) - m_ring.begin();
+      break;
+    }
+    case MAGLEV:
+      n = m_table.size();
+      if (!n) return nullptr;
+      start = mix_hash(h) % n;
+      break;
+    default:
+      n = m_targets.size();
+      if (!n) return nullptr;
+      start = h % n;
+      break;
+  }
+
+  auto probe = ++m_probe;
+  if (!probe) {
+    for (const auto &i : m_target_map) i.second->probe = 0;
+    probe = ++m_probe;
+  }
+
+  auto bounded = m_options.bounded_load;
+  auto count = m_target_map.size();
+  size_t rejected = 0;
+  Target *p = nullptr;
+  Target *fallback = nullptr;
+
+  for (size_t i = 0; i < n && rejected < count; i++) {
+    auto t = candidate(start + i);
+    if (t->probe == probe) continue;
+    t->probe = probe;
+    rejected++;
+    if (!t->weight || !is_healthy(t->id, unhealthy)) continue;
+    if (bounded > 0) {
+      if (!fallback) fallback = t;
+      auto cap = std::ceil(bounded * (m_total_load + 1) * t->weight / m_total_weight);
+      if (t->load + 1 > cap) continue;
+    }
+    p = t;
+    break;
+  }
+
+  if (!p) p = fallback;
+  if (!p) return nullptr;
+
+  if (bounded > 0) {
+    p->load++;
+    m_total_load++;
+  }
+
+  return p->id;
+}
+
+void HashingLoadBalancer::deselect(pjs::Str *target) {
+  if (target) {
+    auto i = m_target_map.find(target);
+    if (i != m_target_map.end()) {
+      auto t = i->second;
+      if (t->load > 0) {
+        t->load--;
+        m_total_load--;
+      }
+    }
+  }
 }
 
 //
@@ -1755,12 +2651,32 @@ template<> void ClassDef<Constructor<SharedMap>>::init() {
 // URLRouter
 //
 
+static bool URLRouter_find(Context &ctx, URLRouter *router, Value &value, Object *params) {
+  if (ctx.argc() == 1 && ctx.arg(0).is_string()) {
+    return router->find(ctx.arg(0).s()->str(), value, params);
+  }
+  std::string url;
+  for (int i = 0; i < ctx.argc(); i++) {
+    const auto &seg = ctx.arg(i);
+    if (!seg.is_nullish()) {
+      auto s = seg.to_string();
+      if (url.empty()) {
+        url = s->str();
+      } else {
+        url = pipy::utils::path_join(url, s->str());
+      }
+      s->release();
+    }
+  }
+  return router->find(url, value, params);
+}
+
 template<> void ClassDef<URLRouter>::init() {
   ctor([](Context &ctx) -> Object* {
-    Object *rules = nullptr;
-    if (!ctx.arguments(0, &rules)) return nullptr;
+    Object *rules = nullptr, *options = nullptr;
+    if (!ctx.arguments(0, &rules, &options)) return nullptr;
     try {
-      return URLRouter::make(rules);
+      return URLRouter::make(rules, URLRouter::Options(options));
     } catch (std::runtime_error &err) {
       ctx.error(err);
       return nullptr;
@@ -1779,20 +2695,20 @@ template<> void ClassDef<URLRouter>::init() {
   });
 
   method("find", [](Context &ctx, Object *obj, Value &ret) {
-    std::string url;
-    for (int i = 0; i < ctx.argc(); i++) {
-      const auto &seg = ctx.arg(i);
-      if (!seg.is_nullish()) {
-        auto s = seg.to_string();
-        if (url.empty()) {
-          url = s->str();
-        } else {
-          url = pipy::utils::path_join(url, s->str());
-        }
-        s->release();
-      }
+    URLRouter_find(ctx, obj->as<URLRouter>(), ret, nullptr);
+  });
+
+  method("match", [](Context &ctx, Object *obj, Value &ret) {
+    Value value;
+    pjs::Ref<Object> params = Object::make();
+    if (URLRouter_find(ctx, obj->as<URLRouter>(), value, params)) {
+      thread_local static const pjs::ConstStr s_value("value");
+      thread_local static const pjs::ConstStr s_params("params");
+      auto result = Object::make();
+      result->set(s_value, value);
+      result->set(s_params, params.get());
+      ret.set(result);
     }
-    obj->as<URLRouter>()->find(url, ret);
   });
 }
 
@@ -1805,9 +2721,21 @@ template<> void ClassDef<Constructor<URLRouter>>::init() {
 // LoadBalancer
 //
 
+template<> void EnumDef<Quota::Mode>::init() {
+  define(Quota::TOKEN_BUCKET, "token-bucket");
+  define(Quota::SLIDING_WINDOW, "sliding-window");
+}
+
+template<> void EnumDef<HashingLoadBalancer::Algorithm>::init() {
+  define(HashingLoadBalancer::MODULO, "modulo");
+  define(HashingLoadBalancer::RING_HASH, "ring-hash");
+  define(HashingLoadBalancer::MAGLEV, "maglev");
+}
+
 template<> void EnumDef<LoadBalancer::Algorithm>::init() {
   define(LoadBalancer::ROUND_ROBIN, "round-robin");
   define(LoadBalancer::LEAST_LOAD, "least-load");
+  define(LoadBalancer::P2C_EWMA, "p2c-ewma");
 }
 
 template<> void ClassDef<LoadBalancer::Resource>::init() {
@@ -1913,8 +2841,14 @@ template<> void ClassDef<HashingLoadBalancer>::init() {
   ctor([](Context &ctx) -> Object* {
     Object *targets = nullptr;
     Cache *unhealthy = nullptr;
-    if (!ctx.arguments(0, &targets, &unhealthy)) return nullptr;
-    return HashingLoadBalancer::make(targets, unhealthy);
+    Object *options = nullptr;
+    if (!ctx.arguments(0, &targets, &unhealthy, &options)) return nullptr;
+    try {
+      return HashingLoadBalancer::make(targets, unhealthy, options);
+    } catch (std::runtime_error &err) {
+      ctx.error(err);
+      return nullptr;
+    }
   });
 
   method("set", [](Context &ctx, Object *obj, Value &ret) {
@@ -33,9 +33,11 @@
 #include "options.hpp"
 
 #include <atomic>
+#include <deque>
 #include <limits>
 #include <map>
 #include <mutex>
+#include <random>
 #include <set>
 #include <unordered_map>
 
@@ -99,15 +101,35 @@ private:
 
 class Quota : public pjs::ObjectTemplate<Quota> {
 public:
+  enum Mode {
+    TOKEN_BUCKET,
+    SLIDING_WINDOW,
+  };
+
   struct Options : public pipy::Options {
+    Mode mode = TOKEN_BUCKET;
     pjs::Ref<pjs::Str> key;
     double max = std::numeric_limits<double>::infinity();
     double per = 0;
     double produce = 0;
+    double lease = 0;
     Options() {}
     Options(pjs::Object *options);
   };
 
+  //
+  // Quota::Window
+  //
+
+  struct Window {
+    double start = 0;
+    double prev = 0;
+    double curr = 0;
+
+    auto count(double period, double now) const -> double;
+    void roll(double period, double now);
+  };
+
   //
   // Quota::Counter
   //
@@ -116,6 +138,7 @@ public:
   public:
     static auto get(
       const std::string &key,
+      Mode mode,
       double initial_value,
       double maximum_value,
       double produce_value,
@@ -123,6 +146,7 @@ public:
     ) -> Counter*;
 
     void init(
+      Mode mode,
       double initial_value,
       double maximum_value,
       double produce_value,
@@ -130,15 +154,18 @@ public:
     );
 
     auto initial() const -> double { return m_initial_value; }
-    auto current() const -> double { return m_current_value.load(); }
+    auto current() const -> double;
+    auto waiting() const -> size_t { return m_waiting.load(std::memory_order_relaxed); }
     void produce(double value);
-    auto consume(double value) -> double;
+    void refund(double value, double window);
+    auto consume(double value, double *window = nullptr) -> double;
     void enqueue(Quota *quota);
     void dequeue(Quota *quota);
 
   private:
     Counter(
       const std::string &key,
+      Mode mode,
       double initial_value,
       double maximum_value,
       double produce_value,
@@ -148,6 +175,7 @@ public:
 
     Net& m_net;
     std::string m_key;
+    std::atomic<int> m_mode;
     std::atomic<double> m_initial_value;
     std::atomic<double> m_maximum_value;
     std::atomic<double> m_produce_value;
@@ -156,6 +184,9 @@ public:
     std::atomic<bool> m_is_producing_scheduled;
     std::set<Quota*> m_quotas;
     std::mutex m_quotas_mutex;
+    std::atomic<size_t> m_waiting;
+    Window m_window;
+    mutable std::mutex m_window_mutex;
     Timer m_timer;
 
     void schedule_producing();
@@ -190,7 +221,7 @@ public:
 
   void reset();
   auto initial() const -> double { return m_counter ? m_counter->initial() : m_initial_value; }
-  auto current() const -> double { return m_counter ? m_counter->current() : m_current_value; }
+  auto current() const -> double;
   void produce(double value);
   void produce_async(double value);
   auto consume(double value) -> double;
@@ -206,11 +237,18 @@ private:
   pjs::Ref<Counter> m_counter;
   double m_initial_value;
   double m_current_value;
+  double m_lease = 0;
+  double m_lease_window = 0;
+  Window m_window;
   bool m_is_producing_scheduled = false;
+  bool m_is_lease_return_scheduled = false;
   List<Consumer> m_consumers;
   Timer m_timer;
+  Timer m_lease_timer;
 
   void schedule_producing();
+  void schedule_lease_return();
+  void return_lease();
   void on_produce();
   void on_produce_async();
 
@@ -234,6 +272,8 @@ public:
   auto add(pjs::Str *key, double value) -> double;
   auto sub(pjs::Str *key, double value) -> double;
 
+  static void for_each_contention(const std::function<void(const std::string &, int, uint64_t)> &cb);
+
 private:
 
   //
@@ -242,6 +282,33 @@ private:
 
   class Map : public pjs::RefCountMT<Map> {
   public:
+
+    //
+    // SharedMap::Map::Entry
+    //
+
+    class Entry : public pjs::RefCountMT<Entry> {
+    public:
+      bool is_erased() const { return m_erased.load(std::memory_order_acquire); }
+      bool get_number(double &value) const;
+      auto add(double value) -> double;
+
+    private:
+      pjs::SharedValue m_value;
+      std::atomic<uint64_t> m_number;
+      std::atomic<bool> m_is_number;
+      std::atomic<bool> m_erased;
+
+      Entry() : m_number(0), m_is_number(false), m_erased(false) {}
+
+      void get(pjs::SharedValue &value) const;
+      void set(const pjs::Value &value);
+      void erase() { m_erased.store(true, std::memory_order_release); }
+
+      friend class pjs::RefCountMT<Entry>;
+      friend class Map;
+    };
+
     static auto get(const std::string &name) -> Map*;
 
     auto size() -> size_t;
@@ -249,34 +316,75 @@ private:
     bool erase(pjs::Str::CharData *key);
     bool has(pjs::Str::CharData *key);
     bool get(pjs::Str::CharData *key, pjs::SharedValue &value);
-    void set(pjs::Str::CharData *key, const pjs::SharedValue &value);
-    auto add(pjs::Str::CharData *key, double value) -> double;
-    auto sub(pjs::Str::CharData *key, double value) -> double;
+    void set(pjs::Str::CharData *key, const pjs::Value &value);
+    auto find(pjs::Str::CharData *key) -> pjs::Ref<Entry>;
 
   private:
+    enum { SHARDS = 64 };
+
     typedef pjs::Ref<pjs::Str::CharData> Key;
 
     struct Hash {
       size_t operator()(const Key &k) const {
-        std::hash<std::string> h;
-        return h(k->str());
+        return k->hash();
       }
     };
 
     struct EqualTo {
       bool operator()(const Key &a, const Key &b) const {
-        return a->str() == b->str();
+        return a == b || (a->hash() == b->hash() && a->str() == b->str());
+      }
+    };
+
+    //
+    // SharedMap::Map::Shard
+    //
+
+    struct Shard {
+      std::unordered_map<Key, pjs::Ref<Entry>, Hash, EqualTo> map;
+      std::mutex mutex;
+      std::atomic<uint64_t> contentions;
+      Shard() : contentions(0) {}
+    };
+
+    //
+    // SharedMap::Map::Lock
+    //
+
+    class Lock {
+    public:
+      Lock(Shard &shard) : m_mutex(shard.mutex) {
+        if (!m_mutex.try_lock()) {
+          shard.contentions.fetch_add(1, std::memory_order_relaxed);
+          m_mutex.lock();
+        }
       }
+
+      ~Lock() { m_mutex.unlock(); }
+
+    private:
+      std::mutex &m_mutex;
     };
 
-    std::unordered_map<Key, pjs::SharedValue, Hash, EqualTo> m_map;
-    std::mutex m_mutex;
+    std::string m_name;
+    Shard m_shards[SHARDS];
+
+    auto shard(pjs::Str::CharData *key) -> Shard& {
+      return m_shards[(key->hash() * 0x9e3779b97f4a7c15ull) >> 58];
+    }
 
     static std::map<std::string, Map*> m_maps;
     static std::mutex m_maps_mutex;
+
+    friend class SharedMap;
   };
 
+  enum { MAX_CACHE_SIZE = 1024 };
+
   pjs::Ref<Map> m_map;
+  std::unordered_map<pjs::Ref<pjs::Str>, pjs::Ref<Map::Entry>> m_cache;
+
+  auto entry(pjs::Str *key) -> Map::Entry*;
 };
 
 //
@@ -311,39 +419,91 @@ private:
 
 class URLRouter : public pjs::ObjectTemplate<URLRouter> {
 public:
+  struct Options : public pipy::Options {
+    bool params = false;
+    Options() {}
+    Options(pjs::Object *options);
+  };
+
   void add(const std::string &url, const pjs::Value &value);
-  bool find(const std::string &url, pjs::Value &value);
+  bool find(const std::string &url, pjs::Value &value, pjs::Object *params = nullptr);
 
 private:
-  URLRouter();
-  URLRouter(pjs::Object *rules);
+  URLRouter(const Options &options = Options());
+  URLRouter(pjs::Object *rules, const Options &options = Options());
   ~URLRouter();
 
-  struct Node {
-    std::map<std::string, Node*> children;
-    pjs::Value value;
+  static const int MAX_CAPTURES = 32;
 
-    auto child(const std::string &name) -> Node* {
-      auto i = children.find(name);
-      return i == children.end() ? nullptr : i->second;
-    }
+  //
+  // URLRouter::Tree
+  //
+  // Routes are added to a compressed radix tree with byte-level edges,
+  // which gets compiled into flat arrays before the next lookup.
+  //
 
-    auto new_child(const std::string &name) -> Node* {
-      auto i = children.find(name);
-      if (i != children.end()) return i->second;
-      return children[name] = new Node;
-    }
+  class Tree {
+  public:
+    struct Capture {
+      pjs::Str* name;
+      size_t start;
+      size_t length;
+    };
 
-    ~Node() {
-      for (auto &i : children) {
-        delete i.second;
+    struct Captures {
+      Capture items[MAX_CAPTURES];
+      int size = 0;
+    };
+
+    Tree() : m_root(new Node) {}
+    ~Tree() { delete m_root; }
+
+    auto add(const std::string &pattern, bool params = false) -> int*;
+    bool find(const char *str, size_t len, int &slot, Captures &captures);
+
+  private:
+    struct Node {
+      std::string label;
+      std::string name;
+      std::vector<Node*> children;
+      Node* param = nullptr;
+      int value = -1;
+      int wildcard = -1;
+
+      ~Node() {
+        for (auto *c : children) delete c;
+        delete param;
       }
-    }
-  };
+    };
+
+    struct Compiled {
+      size_t label;
+      size_t length;
+      size_t children;
+      size_t count;
+      int param;
+      int name;
+      int value;
+      int wildcard;
+    };
+
+    Node* m_root;
+    bool m_compiled = false;
+    std::vector<Compiled> m_nodes;
+    std::vector<char> m_first;
+    std::string m_labels;
+    std::vector<pjs::Ref<pjs::Str>> m_names;
 
-  Node* m_root;
+    auto insert(Node *node, const std::string &str, size_t i, size_t j) -> Node*;
+    void compile();
+    bool match(const char *str, size_t len, size_t p, size_t i, int &slot, Captures &captures);
+  };
 
-  void dump(Node *node, int level);
+  Options m_options;
+  Tree m_hosts;
+  Tree m_wildcard_hosts;
+  std::vector<Tree*> m_paths;
+  std::vector<pjs::Value> m_values;
 
   friend class pjs::ObjectTemplate<URLRouter>;
 };
@@ -373,8 +533,13 @@ private:
     double weight = 1;
     double step = 0;
     double load = 0;
+    int pending = 0;
+    double latency = 0;
+    double latency_time = 0;
 
     auto allocate() -> Resource*;
+    void observe(double rtt, double now, double decay);
+    auto cost(double now, double decay, double fallback) const -> double;
 
   private:
     List<Resource> m_resources;
@@ -391,6 +556,7 @@ public:
   enum Algorithm {
     ROUND_ROBIN,
     LEAST_LOAD,
+    P2C_EWMA,
   };
 
   //
@@ -403,6 +569,7 @@ public:
     pjs::Ref<pjs::Function> weight_f;
     pjs::Ref<pjs::Function> capacity_f;
     int capacity = 0;
+    double decay = 10;
     Options() {}
     Options(pjs::Object *options);
   };
@@ -428,6 +595,7 @@ public:
     pjs::Ref<Pool> m_pool;
     pjs::Value m_target;
     int m_load = 0;
+    std::deque<double> m_start_times;
 
     void increase_load();
 
@@ -441,7 +609,8 @@ public:
 
 private:
   LoadBalancer(const Options &options)
-    : m_options(options) {}
+    : m_options(options)
+    , m_rand(std::random_device()()) {}
 
   ~LoadBalancer();
 
@@ -449,10 +618,15 @@ private:
   std::map<pjs::Value, Pool*> m_targets;
   std::vector<pjs::Ref<Pool>> m_pools;
   List<Pool> m_queue;
+  std::minstd_rand m_rand;
+  double m_latency = 0;
+  double m_latency_time = 0;
 
   auto next(const std::function<bool(const pjs::Value &)> &validator) -> Pool*;
+  auto next_p2c(const std::function<bool(const pjs::Value &)> &validator) -> Pool*;
   void increase_load(Pool *pool);
   void decrease_load(Pool *pool);
+  void observe(Pool *pool, double rtt, double now);
   void sort_forward(List<Pool> &queue, Pool *pool);
   void sort_backward(List<Pool> &queue, Pool *pool);
 
@@ -544,17 +718,88 @@ private:
 
 class HashingLoadBalancer : public pjs::ObjectTemplate<HashingLoadBalancer, LoadBalancerBase> {
 public:
+
+  //
+  // HashingLoadBalancer::Algorithm
+  //
+
+  enum Algorithm {
+    MODULO,
+    RING_HASH,
+    MAGLEV,
+  };
+
+  //
+  // HashingLoadBalancer::Options
+  //
+
+  struct Options : public pipy::Options {
+    Algorithm algorithm = MODULO;
+    int replicas = 160;
+    int table_size = 65537;
+    double bounded_load = 0;
+    Options() {}
+    Options(pjs::Object *options);
+  };
+
   void set(pjs::Object *targets);
   void add(pjs::Str *target);
 
   virtual auto select(const pjs::Value &key, Cache *unhealthy) -> pjs::Str* override;
-  virtual void deselect(pjs::Str *target) override {}
+  virtual void deselect(pjs::Str *target) override;
 
 private:
-  HashingLoadBalancer(pjs::Object *targets, Cache *unhealthy = nullptr);
+  HashingLoadBalancer(pjs::Object *targets, Cache *unhealthy = nullptr, const Options &options = Options());
   ~HashingLoadBalancer();
 
-  std::vector<pjs::Ref<pjs::Str>> m_targets;
+  //
+  // HashingLoadBalancer::Target
+  //
+
+  struct Target : public pjs::Pooled<Target> {
+    pjs::Ref<pjs::Str> id;
+    uint64_t hash;
+    int weight;
+    int slots = 0;
+    int load = 0;
+    size_t count = 0;
+    size_t offset = 0;
+    size_t skip = 0;
+    size_t next = 0;
+    uint32_t probe = 0;
+    bool removed = false;
+    bool dirty = false;
+  };
+
+  //
+  // HashingLoadBalancer::Point
+  //
+
+  struct Point {
+    uint64_t hash;
+    Target* target;
+    bool operator<(const Point &r) const { return hash < r.hash; }
+  };
+
+  Options m_options;
+  std::vector<Target*> m_targets;
+  std::map<pjs::Ref<pjs::Str>, Target*> m_target_map;
+  std::vector<Point> m_ring;
+  std::vector<size_t> m_ring_index;
+  std::vector<Target*> m_table;
+  int m_ring_bits = 0;
+  int m_total_weight = 0;
+  int m_total_load = 0;
+  uint32_t m_probe = 0;
+
+  void rebuild();
+  void build_ring_index();
+  void build_table();
+  void update_table();
+  void fill_table(std::vector<Target*> &targets, size_t free);
+  void claim_slot(Target *t);
+  auto ring_bucket(uint64_t hash) const -> size_t { return m_ring_bits > 0 ? hash >> (64 - m_ring_bits) : 0; }
+  auto candidate(size_t i) const -> Target*;
 
   friend class pjs::ObjectTemplate<HashingLoadBalancer, LoadBalancerBase>;
 };
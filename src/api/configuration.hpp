@@ -61,10 +61,11 @@ public:
   void branch(int count, pjs::Function **conds, const pjs::Value *layouts);
   void branch_message_start(int count, pjs::Function **conds, const pjs::Value *layouts);
   void branch_message(int count, pjs::Function **conds, const pjs::Value *layouts);
+  void cache_http(pjs::Object *options);
   void chain(const std::list<JSModule*> modules);
   void chain_next();
-  void compress(const pjs::Value &algorithm);
-  void compress_http(const pjs::Value &algorithm);
+  void compress(const pjs::Value &algorithm, pjs::Object *options);
+  void compress_http(const pjs::Value &algorithm, pjs::Object *options);
   void connect(const pjs::Value &target, pjs::Object *options);
   void connect_http_tunnel(pjs::Object *handshake);
   void connect_proxy_protocol(const pjs::Value &address);
@@ -80,8 +81,8 @@ public:
   void decode_resp();
   void decode_thrift();
   void decode_websocket();
-  void decompress(const pjs::Value &algorithm);
-  void decompress_http();
+  void decompress(const pjs::Value &algorithm, pjs::Object *options);
+  void decompress_http(pjs::Object *options);
   void deframe(pjs::Object *states);
   void demux(pjs::Object *options);
   void demux_fcgi();
@@ -32,6 +32,9 @@
 #include "compressor.hpp"
 #include "utils.hpp"
 
+#define ZLIB_CONST
+#include <zlib.h>
+
 namespace pipy {
 namespace http {
 
@@ -62,6 +65,15 @@ thread_local static const pjs::ConstStr s_content_type("content-type");
 thread_local static const pjs::ConstStr s_application_octet_stream("application/octet-stream");
 thread_local static const pjs::ConstStr s_gzip("gzip");
 thread_local static const pjs::ConstStr s_br("br");
+thread_local static const pjs::ConstStr s_zstd("zstd");
+thread_local static const pjs::ConstStr s_etag("etag");
+thread_local static const pjs::ConstStr s_vary("vary");
+thread_local static const pjs::ConstStr s_if_none_match("if-none-match");
+thread_local static const pjs::ConstStr s_if_range("if-range");
+thread_local static const pjs::ConstStr s_range("range");
+thread_local static const pjs::ConstStr s_content_range("content-range");
+thread_local static const pjs::ConstStr s_accept_ranges("accept-ranges");
+thread_local static const pjs::ConstStr s_bytes("bytes");
 
 static const std::map<std::string, std::string> s_default_content_types = {
   { "html"  , "text/html" },
@@ -403,6 +415,12 @@ Directory::Options::Options(pjs::Object *options) {
   Value(options, "compression")
     .get(compression_f)
     .check_nullable();
+  Value(options, "maxCacheSize")
+    .get_binary_size(max_cache_size)
+    .check_nullable();
+  Value(options, "revalidateInterval")
+    .get_seconds(revalidate_interval)
+    .check_nullable();
 }
 
 //
@@ -482,8 +500,21 @@ auto Directory::serve(pjs::Context &ctx, Message *request) -> Message* {
 
   auto k = path;
   auto i = m_cache.find(k);
+  if (i != m_cache.end()) {
+    auto &f = i->second;
+    auto now = utils::now();
+    if (now - f.check_time >= m_options.revalidate_interval * 1000) {
+      if (f.time != m_loader->get_file_time(f.pathname->str())) {
+        remove_cache(i);
+        i = m_cache.end();
+      } else {
+        f.check_time = now;
+      }
+    }
+  }
+
   if (i == m_cache.end()) {
-    Data raw, gz, br;
+    Data raw, gz, br, zst;
     if (!m_loader->load_file(path, raw)) {
       if (path.empty() || path.back() != '/') path += '/';
       bool found = false;
@@ -499,12 +530,30 @@ auto Directory::serve(pjs::Context &ctx, Message *request) -> Message* {
     }
     m_loader->load_file(path + ".gz", gz);
     m_loader->load_file(path + ".br", br);
+    m_loader->load_file(path + ".zst", zst);
+
+    auto crc = crc32(0, Z_NULL, 0);
+    for (const auto c : raw.chunks()) {
+      crc = crc32(crc, (const Bytef *)std::get<0>(c), std::get<1>(c));
+    }
+
+    char buf[100];
+    auto len = std::snprintf(buf, sizeof(buf), "\"%lx-%08lx", (unsigned long)raw.size(), (unsigned long)crc);
+    std::string etag(buf, len);
 
     auto &f = m_cache[k];
+    f.lru = m_cache_lru.insert(m_cache_lru.begin(), k);
     f.pathname = pjs::Str::make(path);
+    f.etag = pjs::Str::make(etag + '"');
+    f.etag_gz = pjs::Str::make(etag + "-gz\"");
+    f.etag_br = pjs::Str::make(etag + "-br\"");
+    f.etag_zst = pjs::Str::make(etag + "-zst\"");
+    f.time = m_loader->get_file_time(path);
+    f.check_time = utils::now();
     f.raw = std::move(raw);
     f.gz = std::move(gz);
     f.br = std::move(br);
+    f.zst = std::move(zst);
 
     std::string ext;
     auto p = path.find('.', path.rfind('/'));
@@ -535,10 +584,99 @@ auto Directory::serve(pjs::Context &ctx, Message *request) -> Message* {
       f.content_type = i == m_content_types.end() ? m_default_content_type.get() : i->second.get();
     }
 
-    return get_encoded_response(ctx, f, head);
+    auto response = get_encoded_response(ctx, f, head);
+    update_cache(f);
+    return response;
   }
 
-  return get_encoded_response(ctx, i->second, head);
+  auto &f = i->second;
+  m_cache_lru.splice(m_cache_lru.begin(), m_cache_lru, f.lru);
+  auto response = get_encoded_response(ctx, f, head);
+  update_cache(f);
+  return response;
+}
+
+void Directory::update_cache(File &file) {
+  auto size = file.raw.size() + file.gz.size() + file.br.size() + file.zst.size();
+  m_cache_size = m_cache_size - file.size + size;
+  file.size = size;
+  if (auto max = m_options.max_cache_size) {
+    while (m_cache_size > max && !m_cache_lru.empty()) {
+      remove_cache(m_cache.find(m_cache_lru.back()));
+    }
+  }
+}
+
+void Directory::remove_cache(std::unordered_map<std::string, File>::iterator i) {
+  auto &f = i->second;
+  m_cache_size -= f.size;
+  m_cache_lru.erase(f.lru);
+  m_cache.erase(i);
+}
+
+bool Directory::match_etag(const std::string &list, const std::string &etag) {
+  size_t i = 0, n = list.length();
+  while (i < n) {
+    while (i < n && (std::isblank((unsigned char)list[i]) || list[i] == ',')) i++;
+    if (i >= n) break;
+    if (list[i] == '*') return true;
+    if (list[i] == 'W' && i + 1 < n && list[i+1] == '/') i += 2;
+    auto p = i;
+    if (i < n && list[i] == '"') {
+      i++;
+      while (i < n && list[i] != '"') i++;
+      if (i < n) i++;
+    } else {
+      while (i < n && list[i] != ',' && !std::isblank((unsigned char)list[i])) i++;
+    }
+    if (!list.compare(p, i - p, etag)) return true;
+  }
+  return false;
+}
+
+auto Directory::parse_range(const std::string &range, size_t size, size_t &start, size_t &end) -> Range {
+  if (range.length() < 6 || !utils::iequals(range.c_str(), "bytes=", 6)) return Range::NONE;
+  if (range.find(',') != std::string::npos) return Range::NONE;
+
+  auto p = range.c_str() + 6;
+  auto skip_blanks = [&]() { while (std::isblank((unsigned char)*p)) p++; };
+
+  // Positions beyond what size_t can hold saturate, so they fall
+  // outside any file and get answered with 416
+  auto read_number = [&](size_t &n) {
+    bool found = false;
+    while (std::isdigit((unsigned char)*p)) {
+      auto d = size_t(*p++ - '0');
+      n = (n > (SIZE_MAX - d) / 10 ? SIZE_MAX : n * 10 + d);
+      found = true;
+    }
+    return found;
+  };
+
+  skip_blanks();
+  size_t first = 0, last = 0;
+  bool has_first = read_number(first);
+  skip_blanks();
+  if (*p++ != '-') return Range::NONE;
+  skip_blanks();
+  bool has_last = read_number(last);
+  skip_blanks();
+  if (*p) return Range::NONE;
+
+  if (has_first) {
+    if (has_last && last < first) return Range::NONE;
+    if (first >= size) return Range::UNSATISFIABLE;
+    start = first;
+    end = has_last && last < size ? last + 1 : size;
+  } else if (has_last) {
+    if (last == 0 || size == 0) return Range::UNSATISFIABLE;
+    start = last < size ? size - last : 0;
+    end = size;
+  } else {
+    return Range::NONE;
+  }
+
+  return Range::SATISFIABLE;
 }
 
 void Directory::set_content_types(pjs::Object *obj) {
@@ -557,6 +695,7 @@ void Directory::set_content_types(pjs::Object *obj) {
 auto Directory::get_encoded_response(pjs::Context &ctx, File &file, RequestHead *request) -> Message* {
   bool has_gz = false;
   bool has_br = false;
+  bool has_zstd = false;
 
   pjs::Value accept_encoding;
   if (auto headers = request->headers.get()) {
@@ -565,73 +704,123 @@ auto Directory::get_encoded_response(pjs::Context &ctx, File &file, RequestHead
   if (accept_encoding.is_string()) {
     auto &s = accept_encoding.s()->str();
     for (size_t i = 0; i < s.length(); i++) {
-      while (i < s.length() && std::isblank(s[i])) i++;
+      while (i < s.length() && std::isblank((unsigned char)s[i])) i++;
       if (i < s.length()) {
-        auto n = 0; while (std::isalpha(s[i+n])) n++;
+        auto n = 0; while (std::isalpha((unsigned char)s[i+n])) n++;
         if (n == 4 && utils::iequals(&s[i], "gzip", n)) has_gz = true;
         else if (n == 2 && utils::iequals(&s[i], "br", n)) has_br = true;
+        else if (n == 4 && utils::iequals(&s[i], "zstd", n)) has_zstd = true;
         i += n;
         while (i < s.length() && s[i] != ',') i++;
       }
     }
   }
 
-  Message *response = nullptr;
   auto head = ResponseHead::make();
   auto headers = Object::make();
   head->headers = headers;
   headers->set(s_content_type.get(), file.content_type.get());
 
+  const Data *body = &file.raw;
+  pjs::Str *etag = file.etag;
+
   if (has_br && !file.br.empty()) {
     headers->set(s_content_encoding.get(), s_br.get());
-    response = Message::make(head, Data::make(file.br));
+    body = &file.br;
+    etag = file.etag_br;
+
+  } else if (has_zstd && !file.zst.empty()) {
+    headers->set(s_content_encoding.get(), s_zstd.get());
+    body = &file.zst;
+    etag = file.etag_zst;
 
   } else if (has_gz && !file.gz.empty()) {
     headers->set(s_content_encoding.get(), s_gzip.get());
-    response = Message::make(head, Data::make(file.gz));
-
-  } else {
-    Data *body = nullptr;
-    Compressor *compressor = nullptr;
-    auto output = [&](const Data &data) { body->push(data); };
-
-    if ((has_gz || has_br) && m_options.compression_f) {
-      auto accept_encoding = pjs::Object::make();
-      if (has_gz) accept_encoding->set(s_gzip, true);
-      if (has_br) accept_encoding->set(s_br, true);
-      pjs::Value args[4], ret;
-      args[0].set(request);
-      args[1].set(accept_encoding);
-      args[2].set(file.pathname.get());
-      args[3].set(file.raw.size());
-      (*m_options.compression_f)(ctx, 4, args, ret);
-      if (!ctx.ok()) return nullptr;
-      if (ret.to_boolean()) {
-        if (!ret.is_string()) {
-          ctx.error("callback expected to return a string");
-          return nullptr;
-        }
-        if (ret.s() == s_gzip) {
-          compressor = Compressor::gzip(output);
-          body = &file.gz;
-          headers->set(s_content_encoding.get(), s_gzip.get());
-        } else {
-          ctx.error("callback returned an unsupported compression algorithm");
-          return nullptr;
-        }
+    body = &file.gz;
+    etag = file.etag_gz;
+
+  } else if ((has_gz || has_br || has_zstd) && m_options.compression_f) {
+    auto accept_encoding = pjs::Object::make();
+    if (has_gz) accept_encoding->set(s_gzip, true);
+    if (has_br) accept_encoding->set(s_br, true);
+    if (has_zstd) accept_encoding->set(s_zstd, true);
+    pjs::Value args[4], ret;
+    args[0].set(request);
+    args[1].set(accept_encoding);
+    args[2].set(file.pathname.get());
+    args[3].set(file.raw.size());
+    (*m_options.compression_f)(ctx, 4, args, ret);
+    if (!ctx.ok()) return nullptr;
+    if (ret.to_boolean()) {
+      if (!ret.is_string()) {
+        ctx.error("callback expected to return a string");
+        return nullptr;
+      }
+      if (ret.s() == s_gzip) {
+        auto compressor = Compressor::gzip([&](const Data &data) { file.gz.push(data); });
+        compressor->input(file.raw, true);
+        compressor->finalize();
+        headers->set(s_content_encoding.get(), s_gzip.get());
+        body = &file.gz;
+        etag = file.etag_gz;
+      } else if (ret.s() == s_zstd) {
+        auto compressor = Compressor::zstd([&](const Data &data) { file.zst.push(data); });
+        compressor->input(file.raw, false);
+        compressor->flush();
+        compressor->finalize();
+        headers->set(s_content_encoding.get(), s_zstd.get());
+        body = &file.zst;
+        etag = file.etag_zst;
+      } else {
+        ctx.error("callback returned an unsupported compression algorithm");
+        return nullptr;
       }
     }
+  }
 
-    if (compressor) {
-      compressor->input(file.raw, true);
-      compressor->finalize();
-      response = Message::make(head, Data::make(*body));
-    } else {
-      response = Message::make(head, Data::make(file.raw));
+  if (!file.gz.empty() || !file.br.empty() || !file.zst.empty() || m_options.compression_f) {
+    headers->set(s_vary.get(), s_accept_encoding.get());
+  }
+
+  headers->set(s_etag.get(), etag);
+  headers->set(s_accept_ranges.get(), s_bytes.get());
+
+  pjs::Value if_none_match, range, if_range;
+  if (auto h = request->headers.get()) {
+    h->get(s_if_none_match.get(), if_none_match);
+    h->get(s_range.get(), range);
+    h->get(s_if_range.get(), if_range);
+  }
+
+  if (if_none_match.is_string() && match_etag(if_none_match.s()->str(), etag->str())) {
+    head->status = 304;
+    return Message::make(head, nullptr);
+  }
+
+  if (range.is_string() && (!if_range.is_string() || if_range.s()->str() == etag->str())) {
+    size_t size = body->size(), start, end;
+    char buf[100];
+    switch (parse_range(range.s()->str(), size, start, end)) {
+      case Range::SATISFIABLE: {
+        auto part = Data::make(*body);
+        part->shift(start);
+        part->pop(size - end);
+        auto len = std::snprintf(buf, sizeof(buf), "bytes %lu-%lu/%lu", (unsigned long)start, (unsigned long)(end - 1), (unsigned long)size);
+        headers->set(s_content_range.get(), pjs::Str::make(buf, len));
+        head->status = 206;
+        return Message::make(head, part);
+      }
+      case Range::UNSATISFIABLE: {
+        auto len = std::snprintf(buf, sizeof(buf), "bytes */%lu", (unsigned long)size);
+        headers->set(s_content_range.get(), pjs::Str::make(buf, len));
+        head->status = 416;
+        return Message::make(head, nullptr);
+      }
+      default: break;
     }
   }
 
-  return response;
+  return Message::make(head, Data::make(*body));
 }
 
 //
@@ -663,12 +852,16 @@ Directory::FileSystemLoader::FileSystemLoader(const std::string &path)
 {
 }
 
+auto Directory::FileSystemLoader::get_file_time(const std::string &path) -> double {
+  return fs::get_file_time(utils::path_join(m_root_path, path));
+}
+
 bool Directory::FileSystemLoader::load_file(const std::string &path, Data &data) {
-  std::vector<uint8_t> buf;
   auto full_path = utils::path_join(m_root_path, path);
   if (fs::is_file(full_path)) {
-    if (fs::read_file(full_path, buf)) {
-      data.push(&buf[0], buf.size(), &s_dp);
+    Data buf;
+    if (buf.push_file(full_path, &s_dp)) {
+      data = std::move(buf);
       return true;
     }
   }
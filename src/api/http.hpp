@@ -182,6 +182,8 @@ public:
     pjs::Ref<pjs::Function> content_types_f;
     pjs::Ref<pjs::Str> default_content_type;
     pjs::Ref<pjs::Function> compression_f;
+    size_t max_cache_size = 0;
+    double revalidate_interval = 1;
     Options() {}
     Options(pjs::Object *options);
   };
@@ -193,17 +195,25 @@ public:
   auto serve(pjs::Context &ctx, Message *request) -> Message*;
   void set_content_types(pjs::Object *obj);
 
+  static bool match_etag(const std::string &list, const std::string &etag);
+
 private:
   struct File {
     pjs::Ref<pjs::Str> pathname;
     pjs::Ref<pjs::Str> content_type;
-    Data raw, gz, br;
+    pjs::Ref<pjs::Str> etag, etag_gz, etag_br, etag_zst;
+    Data raw, gz, br, zst;
+    size_t size = 0;
+    double time = 0;
+    double check_time = 0;
+    std::list<std::string>::iterator lru;
   };
 
   class Loader {
   public:
     virtual ~Loader() {}
     virtual bool load_file(const std::string &path, Data &data) = 0;
+    virtual auto get_file_time(const std::string &path) -> double { return 0; }
   };
 
   class CodebaseLoader : public Loader {
@@ -217,6 +227,7 @@ private:
   public:
     FileSystemLoader(const std::string &path);
     virtual bool load_file(const std::string &path, Data &data) override;
+    virtual auto get_file_time(const std::string &path) -> double override;
     std::string m_root_path;
   };
 
@@ -230,11 +241,23 @@ private:
   Options m_options;
   Loader* m_loader = nullptr;
   std::unordered_map<std::string, File> m_cache;
+  std::list<std::string> m_cache_lru;
+  size_t m_cache_size = 0;
   std::list<std::string> m_index_filenames;
   std::map<std::string, pjs::Ref<pjs::Str>> m_content_types;
   pjs::Ref<pjs::Str> m_default_content_type;
 
   auto get_encoded_response(pjs::Context &ctx, File &file, RequestHead *request) -> Message*;
+  void update_cache(File &file);
+  void remove_cache(std::unordered_map<std::string, File>::iterator i);
+
+  enum class Range {
+    NONE,
+    SATISFIABLE,
+    UNSATISFIABLE,
+  };
+
+  static auto parse_range(const std::string &range, size_t size, size_t &start, size_t &end) -> Range;
 
   static Data::Producer s_dp;
 };
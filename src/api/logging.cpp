@@ -311,31 +311,86 @@ void Logger::FileTarget::close_all_writers() {
 
 Logger::FileTarget::FileTarget(pjs::Str *filename)
   : m_filename(pjs::Str::make(fs::abs_path(filename->str())))
+  , m_queue(new Queue(m_filename->str()))
 {
 }
 
 void Logger::FileTarget::write(const Data &msg) {
-  auto name = m_filename->data()->retain();
-  auto sd = SharedData::make(msg)->retain();
-  Net::main().post(
-    [=]() {
-      Writer *writer = nullptr;
-      const auto &filename = name->str();
-      auto i = s_all_writers.find(filename);
-      if (i != s_all_writers.end()) {
-        writer = i->second.get();
-      } else {
-        writer = new Writer(filename);
-        s_all_writers[filename].reset(writer);
+  m_queue->write(msg);
+}
+
+auto Logger::FileTarget::writer(const std::string &filename) -> Writer* {
+  auto i = s_all_writers.find(filename);
+  if (i != s_all_writers.end()) return i->second.get();
+  auto *writer = new Writer(filename);
+  s_all_writers[filename].reset(writer);
+  return writer;
+}
+
+//
+// Logger::FileTarget::Queue
+//
+
+Logger::FileTarget::Queue::~Queue() {
+  for (auto *sd : m_overflow) sd->release();
+}
+
+void Logger::FileTarget::Queue::write(const Data &msg) {
+  if (!m_overflowing.load(std::memory_order_acquire)) {
+    pjs::Ref<Data> evt(Data::make(msg));
+    if (m_ring.enqueue(evt)) {
+      schedule();
+      return;
+    }
+  }
+  std::lock_guard<std::mutex> lock(m_overflow_mutex);
+  m_overflow.push_back(SharedData::make(msg)->retain());
+  m_overflowing.store(true, std::memory_order_release);
+  schedule();
+}
+
+void Logger::FileTarget::Queue::schedule() {
+  if (!m_scheduled.exchange(true)) {
+    retain();
+    Net::main().post(
+      [this]() {
+        drain();
+        release();
+      }
+    );
+  }
+}
+
+void Logger::FileTarget::Queue::drain() {
+  InputContext ic;
+  auto *w = writer(m_filename);
+  Event *events[BATCH_SIZE];
+  for (;;) {
+    while (auto n = m_ring.dequeue(events, BATCH_SIZE)) {
+      for (size_t i = 0; i < n; i++) {
+        pjs::Ref<Event> evt(events[i]);
+        if (auto *data = evt->as<Data>()) w->write(*data);
       }
-      InputContext ic;
-      Data data;
-      sd->to_data(data);
-      writer->write(data);
-      name->release();
-      sd->release();
     }
-  );
+    if (m_overflowing.load(std::memory_order_acquire)) {
+      std::list<SharedData*> overflow;
+      {
+        std::lock_guard<std::mutex> lock(m_overflow_mutex);
+        overflow.swap(m_overflow);
+        m_overflowing.store(false, std::memory_order_release);
+      }
+      for (auto *sd : overflow) {
+        Data data;
+        sd->to_data(data);
+        w->write(data);
+        sd->release();
+      }
+    }
+    m_scheduled.store(false);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_ring.empty() && !m_overflowing.load()) break;
+    if (m_scheduled.exchange(true)) break;
+  }
 }
 
 //
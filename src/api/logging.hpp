@@ -29,6 +29,7 @@
 #include "pjs/pjs.hpp"
 #include "options.hpp"
 #include "module.hpp"
+#include "event-queue.hpp"
 #include "fstream.hpp"
 #include "filters/pack.hpp"
 #include "filters/tls.hpp"
@@ -36,6 +37,7 @@
 #include <atomic>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <functional>
 
@@ -44,6 +46,7 @@ namespace pipy {
 class AdminService;
 class AdminLink;
 class Data;
+class SharedData;
 class Pipeline;
 class PipelineLayout;
 class MessageStart;
@@ -104,6 +107,34 @@ public:
   private:
     virtual void write(const Data &msg) override;
 
+    //
+    // Logger::FileTarget::Queue
+    //
+
+    class Queue : public pjs::RefCountMT<Queue> {
+    public:
+      Queue(const std::string &filename)
+        : m_filename(filename)
+        , m_overflowing(false)
+        , m_scheduled(false) {}
+      ~Queue();
+
+      void write(const Data &msg);
+
+    private:
+      enum { BATCH_SIZE = 64 };
+
+      std::string m_filename;
+      EventRing m_ring;
+      std::list<SharedData*> m_overflow;
+      std::mutex m_overflow_mutex;
+      std::atomic<bool> m_overflowing;
+      std::atomic<bool> m_scheduled;
+
+      void schedule();
+      void drain();
+    };
+
     //
     // Logger::FileTarget::Module
     //
@@ -132,8 +163,11 @@ public:
     };
 
     pjs::Ref<pjs::Str> m_filename;
+    pjs::Ref<Queue> m_queue;
 
     static std::map<std::string, std::unique_ptr<Writer>> s_all_writers;
+
+    static auto writer(const std::string &filename) -> Writer*;
   };
 
   //
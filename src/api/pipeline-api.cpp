@@ -30,6 +30,7 @@
 
 // all filters
 #include "filters/bgp.hpp"
+#include "filters/cache.hpp"
 #include "filters/connect.hpp"
 #include "filters/compress.hpp"
 #include "filters/decompress.hpp"
@@ -158,12 +159,16 @@ void PipelineDesigner::accept_tls(pjs::Object *options) {
   require_sub_pipeline(append_filter(new tls::Server(options)));
 }
 
-void PipelineDesigner::compress(const pjs::Value &algorithm) {
-  append_filter(new Compress(algorithm));
+void PipelineDesigner::cache_http(pjs::Object *options) {
+  require_sub_pipeline(append_filter(new CacheHTTP(options)));
 }
 
-void PipelineDesigner::compress_http(const pjs::Value &algorithm) {
-  append_filter(new CompressHTTP(algorithm));
+void PipelineDesigner::compress(const pjs::Value &algorithm, pjs::Object *options) {
+  append_filter(new Compress(algorithm, options));
+}
+
+void PipelineDesigner::compress_http(const pjs::Value &algorithm, pjs::Object *options) {
+  append_filter(new CompressHTTP(algorithm, options));
 }
 
 void PipelineDesigner::connect(const pjs::Value &target, pjs::Object *options) {
@@ -230,12 +235,12 @@ void PipelineDesigner::decode_websocket() {
   append_filter(new websocket::Decoder());
 }
 
-void PipelineDesigner::decompress(const pjs::Value &algorithm) {
-  append_filter(new Decompress(algorithm));
+void PipelineDesigner::decompress(const pjs::Value &algorithm, pjs::Object *options) {
+  append_filter(new Decompress(algorithm, options));
 }
 
-void PipelineDesigner::decompress_http() {
-  append_filter(new DecompressHTTP());
+void PipelineDesigner::decompress_http(pjs::Object *options) {
+  append_filter(new DecompressHTTP(options));
 }
 
 void PipelineDesigner::deframe(pjs::Object *states) {
@@ -725,18 +730,27 @@ template<> void ClassDef<PipelineDesigner>::init() {
     obj->accept_tls(options);
   });
 
+  // PipelineDesigner.cacheHTTP
+  filter("cacheHTTP", [](Context &ctx, PipelineDesigner *obj) {
+    Object *options = nullptr;
+    if (!ctx.arguments(0, &options)) return;
+    obj->cache_http(options);
+  });
+
   // PipelineDesigner.compress
   filter("compress", [](Context &ctx, PipelineDesigner *obj) {
     Value algorithm;
-    if (!ctx.arguments(1, &algorithm)) return;
-    obj->compress(algorithm);
+    Object *options = nullptr;
+    if (!ctx.arguments(1, &algorithm, &options)) return;
+    obj->compress(algorithm, options);
   });
 
   // PipelineDesigner.compressHTTP
   filter("compressHTTP", [](Context &ctx, PipelineDesigner *obj) {
     Value algorithm;
-    if (!ctx.arguments(1, &algorithm)) return;
-    obj->compress_http(algorithm);
+    Object *options = nullptr;
+    if (!ctx.arguments(1, &algorithm, &options)) return;
+    obj->compress_http(algorithm, options);
   });
 
   // PipelineDesigner.connect
@@ -834,13 +848,16 @@ template<> void ClassDef<PipelineDesigner>::init() {
   // PipelineDesigner.decompress
   filter("decompress", [](Context &ctx, PipelineDesigner *obj) {
     Value algorithm;
-    if (!ctx.arguments(1, &algorithm)) return;
-    obj->decompress(algorithm);
+    Object *options = nullptr;
+    if (!ctx.arguments(1, &algorithm, &options)) return;
+    obj->decompress(algorithm, options);
   });
 
   // PipelineDesigner.decompressHTTP
   filter("decompressHTTP", [](Context &ctx, PipelineDesigner *obj) {
-    obj->decompress_http();
+    Object *options = nullptr;
+    if (!ctx.arguments(0, &options)) return;
+    obj->decompress_http(options);
   });
 
   // PipelineDesigner.deframe
@@ -60,8 +60,9 @@ public:
   void accept_proxy_protocol(pjs::Function *handler);
   void accept_socks(pjs::Function *handler);
   void accept_tls(pjs::Object *options);
-  void compress(const pjs::Value &algorithm);
-  void compress_http(const pjs::Value &algorithm);
+  void cache_http(pjs::Object *options);
+  void compress(const pjs::Value &algorithm, pjs::Object *options);
+  void compress_http(const pjs::Value &algorithm, pjs::Object *options);
   void connect(const pjs::Value &target, pjs::Object *options);
   void connect_http_tunnel(pjs::Object *handshake);
   void connect_proxy_protocol(const pjs::Value &address);
@@ -77,8 +78,8 @@ public:
   void decode_resp();
   void decode_thrift();
   void decode_websocket();
-  void decompress(const pjs::Value &algorithm);
-  void decompress_http();
+  void decompress(const pjs::Value &algorithm, pjs::Object *options);
+  void decompress_http(pjs::Object *options);
   void deframe(pjs::Object *states);
   void demux(pjs::Object *options);
   void demux_fcgi();
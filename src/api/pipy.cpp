@@ -144,6 +144,7 @@ static auto exec_argv(const std::list<std::string> &args, const Pipy::ExecOption
       if (pipes[0][0]) dup2(pipes[0][0], 0);
       dup2(pipes[1][1], 1);
       dup2(pipes[2][1] ? pipes[2][1] : pipes[1][1], 2);
+      signal(SIGPIPE, SIG_DFL);
       execvp(argv[0], argv);
       std::terminate();
     } else if (pid < 0) {
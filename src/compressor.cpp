@@ -31,19 +31,117 @@
 #include <zlib.h>
 
 #include <brotli/decode.h>
+#include <zstd.h>
+#include <openssl/sha.h>
+
+#include <cstring>
 
 namespace pipy {
 
 static Data::Producer s_dp_inflate("inflate");
 static Data::Producer s_dp_brotli("brotli");
 
+//
+// CompressionDictionary
+//
+
+CompressionDictionary::CompressionDictionary(const Data &data)
+  : m_data(data.to_bytes())
+{
+  m_id = adler32(adler32(0, Z_NULL, 0), m_data.data(), m_data.size());
+}
+
+CompressionDictionary::~CompressionDictionary() {
+  if (m_zstd_cdict) ZSTD_freeCDict(m_zstd_cdict);
+  if (m_zstd_ddict) ZSTD_freeDDict(m_zstd_ddict);
+}
+
+auto CompressionDictionary::sha256() -> const uint8_t* {
+  if (!m_has_sha256) {
+    SHA256(m_data.data(), m_data.size(), m_sha256);
+    m_has_sha256 = true;
+  }
+  return m_sha256;
+}
+
+auto CompressionDictionary::zstd_cdict() -> ZSTD_CDict* {
+  if (!m_zstd_cdict) {
+    m_zstd_cdict = ZSTD_createCDict(m_data.data(), m_data.size(), ZSTD_CLEVEL_DEFAULT);
+  }
+  return m_zstd_cdict;
+}
+
+auto CompressionDictionary::zstd_ddict() -> ZSTD_DDict* {
+  if (!m_zstd_ddict) {
+    m_zstd_ddict = ZSTD_createDDict(m_data.data(), m_data.size());
+  }
+  return m_zstd_ddict;
+}
+
+//
+// Dictionary-compressed zstd ("dcz") header:
+// a 32-byte skippable frame carrying the SHA-256 of the dictionary
+//
+
+static const uint8_t s_dcz_magic[8] = { 0x5e, 0x2a, 0x4d, 0x18, 0x20, 0x00, 0x00, 0x00 };
+static const size_t s_dcz_header_size = sizeof(s_dcz_magic) + 32;
+
+//
+// StreamPool
+//
+
+template<class T>
+class StreamPool {
+public:
+  enum { MAX_SIZE = 16 };
+
+  ~StreamPool() {
+    while (auto s = get()) delete s;
+  }
+
+  auto get() -> T* {
+    if (auto s = m_head) {
+      m_head = s->m_next_free;
+      m_size--;
+      return s;
+    }
+    return nullptr;
+  }
+
+  bool put(T *s) {
+    if (m_size >= MAX_SIZE) return false;
+    s->m_next_free = m_head;
+    m_head = s;
+    m_size++;
+    return true;
+  }
+
+private:
+  T* m_head = nullptr;
+  int m_size = 0;
+};
+
 //
 // Inflate
 //
 
-class Inflate : public pjs::Pooled<Inflate>, public Decompressor {
+class Inflate : public Decompressor {
 public:
-  Inflate(const std::function<void(Data&)> &out, bool gzip)
+  static auto make(const Output &out, bool gzip, CompressionDictionary *dictionary) -> Inflate* {
+    auto s = s_pool.get();
+    if (s) {
+      inflateReset2(&s->m_zs, gzip ? 16 + MAX_WBITS : MAX_WBITS);
+      s->m_out = out;
+      s->m_done = false;
+    } else {
+      s = new Inflate(out, gzip);
+    }
+    s->m_dictionary = dictionary;
+    return s;
+  }
+
+private:
+  Inflate(const Output &out, bool gzip)
     : m_out(out)
   {
     m_zs.zalloc = Z_NULL;
@@ -54,15 +152,16 @@ public:
     inflateInit2(&m_zs, gzip ? 16 + MAX_WBITS : MAX_WBITS);
   }
 
-private:
-  const std::function<void(Data&)> m_out;
-  z_stream m_zs;
-  bool m_done = false;
-
   ~Inflate() {
     inflateEnd(&m_zs);
   }
 
+  Output m_out;
+  z_stream m_zs;
+  pjs::Ref<CompressionDictionary> m_dictionary;
+  Inflate* m_next_free = nullptr;
+  bool m_done = false;
+
   virtual bool input(const Data &data) override {
     if (m_done) return true;
 
@@ -77,6 +176,12 @@ private:
         m_zs.next_out = buf;
         m_zs.avail_out = sizeof(buf);
         auto ret = ::inflate(&m_zs, Z_NO_FLUSH);
+        if (ret == Z_NEED_DICT) {
+          auto dict = m_dictionary.get();
+          if (!dict || dict->id() != m_zs.adler) return false;
+          if (inflateSetDictionary(&m_zs, dict->data(), dict->size()) != Z_OK) return false;
+          ret = ::inflate(&m_zs, Z_NO_FLUSH);
+        }
         if (auto size = sizeof(buf) - m_zs.avail_out) {
           db.push(buf, size);
         }
@@ -92,13 +197,19 @@ private:
   }
 
   virtual bool finalize() override {
-    delete this;
+    m_out = nullptr;
+    m_dictionary = nullptr;
+    if (!s_pool.put(this)) delete this;
     return true;
   }
 
+  thread_local static StreamPool<Inflate> s_pool;
   static Data::Producer s_dp;
+
+  friend class StreamPool<Inflate>;
 };
 
+thread_local StreamPool<Inflate> Inflate::s_pool;
 Data::Producer Inflate::s_dp("Decompress (inflate)");
 
 //
@@ -182,19 +293,116 @@ private:
 
 Data::Producer BrotliDecoder::s_dp("Decompress (brotli)");
 
+//
+// ZstdDecoder
+//
+
+class ZstdDecoder : public Decompressor {
+public:
+  static auto make(const Output &out, CompressionDictionary *dictionary, bool dcz) -> ZstdDecoder* {
+    auto s = s_pool.get();
+    if (s) {
+      s->m_out = out;
+    } else {
+      s = new ZstdDecoder(out);
+    }
+    if (dictionary) {
+      ZSTD_DCtx_refDDict(s->m_ds, dictionary->zstd_ddict());
+    }
+    s->m_dictionary = dictionary;
+    s->m_header_size = dcz ? 0 : s_dcz_header_size;
+    return s;
+  }
+
+private:
+  ZstdDecoder(const Output &out)
+    : m_out(out)
+    , m_ds(ZSTD_createDCtx())
+  {
+  }
+
+  ~ZstdDecoder() {
+    ZSTD_freeDCtx(m_ds);
+  }
+
+  Output m_out;
+  ZSTD_DCtx* m_ds;
+  pjs::Ref<CompressionDictionary> m_dictionary;
+  ZstdDecoder* m_next_free = nullptr;
+  uint8_t m_header[s_dcz_header_size];
+  size_t m_header_size;
+
+  virtual bool input(const Data &data) override {
+    uint8_t buf[DATA_CHUNK_SIZE];
+    Data output;
+    Data::Builder db(output, &s_dp);
+
+    for (const auto chk : data.chunks()) {
+      ZSTD_inBuffer in = { std::get<0>(chk), (size_t)std::get<1>(chk), 0 };
+      if (m_header_size < s_dcz_header_size) {
+        auto n = std::min(in.size, s_dcz_header_size - m_header_size);
+        std::memcpy(m_header + m_header_size, in.src, n);
+        m_header_size += n;
+        in.pos = n;
+        if (m_header_size < s_dcz_header_size) continue;
+        if (std::memcmp(m_header, s_dcz_magic, sizeof(s_dcz_magic))) return false;
+        if (std::memcmp(m_header + sizeof(s_dcz_magic), m_dictionary->sha256(), 32)) return false;
+      }
+      for (;;) {
+        ZSTD_outBuffer out = { buf, sizeof(buf), 0 };
+        auto ret = ZSTD_decompressStream(m_ds, &out, &in);
+        if (ZSTD_isError(ret)) return false;
+        if (out.pos > 0) db.push(buf, out.pos);
+        if (in.pos == in.size && out.pos < out.size) break;
+      }
+    }
+
+    db.flush();
+    m_out(output);
+    return true;
+  }
+
+  virtual bool finalize() override {
+    ZSTD_DCtx_reset(m_ds, ZSTD_reset_session_and_parameters);
+    m_out = nullptr;
+    m_dictionary = nullptr;
+    if (!s_pool.put(this)) delete this;
+    return true;
+  }
+
+  thread_local static StreamPool<ZstdDecoder> s_pool;
+  static Data::Producer s_dp;
+
+  friend class StreamPool<ZstdDecoder>;
+};
+
+thread_local StreamPool<ZstdDecoder> ZstdDecoder::s_pool;
+Data::Producer ZstdDecoder::s_dp("Decompress (zstd)");
+
 //
 // Deflate
 //
 
-class Deflate : public pjs::Pooled<Deflate>, public Compressor {
+class Deflate : public Compressor {
 public:
-  enum class Method {
-    deflate,
-    gzip,
-  };
+  static auto make(const Output &out, bool gzip, CompressionDictionary *dictionary) -> Deflate* {
+    auto s = s_pools[gzip ? 1 : 0].get();
+    if (s) {
+      deflateReset(&s->m_zs);
+      s->m_out = out;
+    } else {
+      s = new Deflate(out, gzip);
+    }
+    if (dictionary) {
+      deflateSetDictionary(&s->m_zs, dictionary->data(), dictionary->size());
+    }
+    return s;
+  }
 
+private:
   Deflate(const Output &out, bool gzip)
     : m_out(out)
+    , m_gzip(gzip)
   {
     m_zs.zalloc = Z_NULL;
     m_zs.zfree = Z_NULL;
@@ -212,14 +420,15 @@ public:
     );
   }
 
-private:
-  Output m_out;
-  z_stream m_zs;
-
-  ~Deflate(){
+  ~Deflate() {
     deflateEnd(&m_zs);
   }
 
+  Output m_out;
+  z_stream m_zs;
+  Deflate* m_next_free = nullptr;
+  bool m_gzip;
+
   virtual bool input(const Data &data, bool flush) override {
     Data output;
     Data::Builder db(output, &s_dp);
@@ -245,7 +454,8 @@ private:
   }
 
   virtual bool finalize() override {
-    delete this;
+    m_out = nullptr;
+    if (!s_pools[m_gzip ? 1 : 0].put(this)) delete this;
     return true;
   }
 
@@ -263,37 +473,156 @@ private:
     return true;
   }
 
+  thread_local static StreamPool<Deflate> s_pools[2];
   static Data::Producer s_dp;
+
+  friend class StreamPool<Deflate>;
 };
 
+thread_local StreamPool<Deflate> Deflate::s_pools[2];
 Data::Producer Deflate::s_dp("Compress (defalte)");
 
+//
+// ZstdEncoder
+//
+
+class ZstdEncoder : public Compressor {
+public:
+  static auto make(const Output &out, CompressionDictionary *dictionary, bool dcz) -> ZstdEncoder* {
+    auto s = s_pool.get();
+    if (s) {
+      s->m_out = out;
+    } else {
+      s = new ZstdEncoder(out);
+    }
+    if (dictionary) {
+      ZSTD_CCtx_refCDict(s->m_cs, dictionary->zstd_cdict());
+    }
+    s->m_dictionary = dictionary;
+    s->m_header_pending = dcz;
+    return s;
+  }
+
+private:
+  ZstdEncoder(const Output &out)
+    : m_out(out)
+    , m_cs(ZSTD_createCCtx())
+  {
+  }
+
+  ~ZstdEncoder() {
+    ZSTD_freeCCtx(m_cs);
+  }
+
+  Output m_out;
+  ZSTD_CCtx* m_cs;
+  pjs::Ref<CompressionDictionary> m_dictionary;
+  ZstdEncoder* m_next_free = nullptr;
+  bool m_header_pending = false;
+
+  virtual bool input(const Data &data, bool flush) override {
+    Data output;
+    Data::Builder db(output, &s_dp);
+
+    for (const auto chk : data.chunks()) {
+      auto buf = std::get<0>(chk);
+      auto len = std::get<1>(chk);
+      if (!compress(buf, len, ZSTD_e_continue, db)) return false;
+    }
+
+    if (flush && !compress(nullptr, 0, ZSTD_e_flush, db)) return false;
+
+    db.flush();
+    m_out(output);
+    return true;
+  }
+
+  virtual bool flush() override {
+    Data output;
+    Data::Builder db(output, &s_dp);
+    if (!compress(nullptr, 0, ZSTD_e_end, db)) return false;
+    db.flush();
+    m_out(output);
+    return true;
+  }
+
+  virtual bool finalize() override {
+    ZSTD_CCtx_reset(m_cs, ZSTD_reset_session_and_parameters);
+    m_out = nullptr;
+    m_dictionary = nullptr;
+    if (!s_pool.put(this)) delete this;
+    return true;
+  }
+
+  bool compress(const char *data, size_t size, ZSTD_EndDirective mode, Data::Builder &db) {
+    if (m_header_pending) {
+      db.push(s_dcz_magic, sizeof(s_dcz_magic));
+      db.push(m_dictionary->sha256(), 32);
+      m_header_pending = false;
+    }
+    uint8_t buf[DATA_CHUNK_SIZE];
+    ZSTD_inBuffer in = { data, size, 0 };
+    for (;;) {
+      ZSTD_outBuffer out = { buf, sizeof(buf), 0 };
+      auto ret = ZSTD_compressStream2(m_cs, &out, &in, mode);
+      if (ZSTD_isError(ret)) return false;
+      if (out.pos > 0) db.push(buf, out.pos);
+      if (mode == ZSTD_e_continue ? in.pos == in.size : ret == 0) break;
+    }
+    return true;
+  }
+
+  thread_local static StreamPool<ZstdEncoder> s_pool;
+  static Data::Producer s_dp;
+
+  friend class StreamPool<ZstdEncoder>;
+};
+
+thread_local StreamPool<ZstdEncoder> ZstdEncoder::s_pool;
+Data::Producer ZstdEncoder::s_dp("Compress (zstd)");
+
 //
 // Decompressor
 //
 
-Decompressor* Decompressor::inflate(const std::function<void(Data&)> &out) {
-  return new Inflate(out, false);
+Decompressor* Decompressor::inflate(const Output &out, CompressionDictionary *dictionary) {
+  return Inflate::make(out, false, dictionary);
 }
 
-Decompressor* Decompressor::gzip(const std::function<void(Data&)> &out) {
-  return new Inflate(out, true);
+Decompressor* Decompressor::gzip(const Output &out) {
+  return Inflate::make(out, true, nullptr);
 }
 
 Decompressor* Decompressor::brotli(const std::function<void(Data&)> &out) {
   return new BrotliDecoder(out);
 }
 
+Decompressor* Decompressor::zstd(const Output &out, CompressionDictionary *dictionary) {
+  return ZstdDecoder::make(out, dictionary, false);
+}
+
+Decompressor* Decompressor::dcz(const Output &out, CompressionDictionary *dictionary) {
+  return ZstdDecoder::make(out, dictionary, true);
+}
+
 //
 // Compressor
 //
 
-Compressor *Compressor::deflate(const Output &out) {
-  return new Deflate(out, false);
+Compressor *Compressor::deflate(const Output &out, CompressionDictionary *dictionary) {
+  return Deflate::make(out, false, dictionary);
 }
 
 Compressor *Compressor::gzip(const Output &out) {
-  return new Deflate(out, true);
+  return Deflate::make(out, true, nullptr);
+}
+
+Compressor *Compressor::zstd(const Output &out, CompressionDictionary *dictionary) {
+  return ZstdEncoder::make(out, dictionary, false);
+}
+
+Compressor *Compressor::dcz(const Output &out, CompressionDictionary *dictionary) {
+  return ZstdEncoder::make(out, dictionary, true);
 }
 
 } // namespace pipy
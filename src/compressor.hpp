@@ -26,13 +26,52 @@
 #ifndef COMPRESSOR_HPP
 #define COMPRESSOR_HPP
 
+#include "pjs/pjs.hpp"
+
 #include <cstddef>
 #include <functional>
+#include <vector>
+
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
 
 namespace pipy {
 
 class Data;
 
+//
+// CompressionDictionary
+//
+
+class CompressionDictionary :
+  public pjs::RefCount<CompressionDictionary>,
+  public pjs::Pooled<CompressionDictionary>
+{
+public:
+  static auto make(const Data &data) -> CompressionDictionary* {
+    return new CompressionDictionary(data);
+  }
+
+  auto data() const -> const uint8_t* { return m_data.data(); }
+  auto size() const -> size_t { return m_data.size(); }
+  auto id() const -> uint32_t { return m_id; }
+  auto sha256() -> const uint8_t*;
+  auto zstd_cdict() -> ZSTD_CDict_s*;
+  auto zstd_ddict() -> ZSTD_DDict_s*;
+
+  ~CompressionDictionary();
+
+private:
+  CompressionDictionary(const Data &data);
+
+  std::vector<uint8_t> m_data;
+  uint32_t m_id;
+  uint8_t m_sha256[32];
+  bool m_has_sha256 = false;
+  ZSTD_CDict_s* m_zstd_cdict = nullptr;
+  ZSTD_DDict_s* m_zstd_ddict = nullptr;
+};
+
 //
 // Decompressor
 //
@@ -41,9 +80,11 @@ class Decompressor {
 public:
   typedef std::function<void(Data&)> Output;
 
-  static Decompressor* inflate(const Output &out);
+  static Decompressor* inflate(const Output &out, CompressionDictionary *dictionary = nullptr);
   static Decompressor* gzip(const Output &out);
   static Decompressor* brotli(const Output &out);
+  static Decompressor* zstd(const Output &out, CompressionDictionary *dictionary = nullptr);
+  static Decompressor* dcz(const Output &out, CompressionDictionary *dictionary);
 
   virtual bool input(const Data &data) = 0;
   virtual bool finalize() = 0;
@@ -60,8 +101,10 @@ class Compressor {
 public:
   typedef std::function<void(Data&)> Output;
 
-  static Compressor* deflate(const Output &out);
+  static Compressor* deflate(const Output &out, CompressionDictionary *dictionary = nullptr);
   static Compressor* gzip(const Output &out);
+  static Compressor* zstd(const Output &out, CompressionDictionary *dictionary = nullptr);
+  static Compressor* dcz(const Output &out, CompressionDictionary *dictionary);
 
   virtual bool input(const Data &data, bool flush) = 0;
   virtual bool flush() = 0;
@@ -29,6 +29,8 @@
 namespace pipy {
 
 const size_t DATA_CHUNK_SIZE = 0x4000;
+const int DATA_CHUNK_CLASSES = 4;
+constexpr size_t DATA_CHUNK_CLASS_SIZES[DATA_CHUNK_CLASSES] = { 0x200, 0x1000, 0x4000, 0x10000 };
 const size_t RECEIVE_BUFFER_SIZE = 0x4000;
 
 } // namespace pipy
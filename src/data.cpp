@@ -25,8 +25,17 @@
 
 #include "data.hpp"
 
+#include <cerrno>
+#include <climits>
+#include <cstdio>
 #include <stdexcept>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // !_WIN32
+
 namespace pipy {
 
 List<Data::Producer> Data::Producer::s_all_producers;
@@ -41,6 +50,118 @@ auto Data::Producer::producer_list_mutex() -> std::mutex& {
   return s_mutex;
 }
 
+Data::File::~File() {
+#ifndef _WIN32
+  ::close(fd);
+#endif // !_WIN32
+}
+
+//
+// File chunks hold no bytes until something reads them. Sockets send them
+// with sendfile() directly from the descriptor. Any other reader gets them
+// loaded by pread() on first access, with bytes past the end of a truncated
+// file read as zeros.
+//
+
+auto Data::FileChunk::load() -> char* {
+  if (auto p = buffer.load(std::memory_order_acquire)) return p;
+  auto buf = new char[m_size];
+  int n = 0;
+#ifndef _WIN32
+  while (n < m_size) {
+    auto r = ::pread(m_file->fd, buf + n, m_size - n, m_position + n);
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0) break;
+    n += r;
+  }
+#endif // !_WIN32
+  if (n < m_size) std::memset(buf + n, 0, m_size - n);
+  char *p = nullptr;
+  if (!buffer.compare_exchange_strong(p, buf, std::memory_order_acq_rel)) {
+    delete [] buf;
+    return p;
+  }
+  return buf;
+}
+
+bool Data::push_file(const std::string &filename, Producer *producer) {
+  assert_same_thread(*this);
+  char buf[DATA_CHUNK_SIZE];
+
+#ifndef _WIN32
+  auto fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (::fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size > INT_MAX - m_size) {
+    ::close(fd);
+    return false;
+  }
+
+  size_t size = st.st_size;
+  if (size >= DATA_CHUNK_SIZE) {
+    auto file = new File(fd);
+    for (size_t offset = 0; offset < size; offset += DATA_CHUNK_SIZE) {
+      int length = std::min(size - offset, size_t(DATA_CHUNK_SIZE));
+      push_view(new View(new FileChunk(file, offset, length), 0, length));
+    }
+    return true;
+  }
+
+  for (;;) {
+    auto n = ::read(fd, buf, sizeof(buf));
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      ::close(fd);
+      return false;
+    }
+    if (n == 0) break;
+    push(buf, n, producer);
+  }
+
+  ::close(fd);
+  return true;
+
+#else // _WIN32
+  auto f = std::fopen(filename.c_str(), "rb");
+  if (!f) return false;
+  while (auto n = std::fread(buf, 1, sizeof(buf), f)) {
+    push(buf, n, producer);
+  }
+  auto err = std::ferror(f);
+  std::fclose(f);
+  return !err;
+
+#endif // _WIN32
+}
+
+auto Data::file_head(int &fd, size_t &offset) const -> size_t {
+  assert_same_thread(*this);
+  auto view = m_head;
+  if (!view) return 0;
+  auto file = view->chunk->file();
+  if (!file) return 0;
+  fd = file->fd;
+  offset = view->chunk->position() + view->offset;
+  size_t size = 0;
+  while (view && view->chunk->file() == file) {
+    if (view->chunk->position() + view->offset != offset + size) break;
+    size += view->length;
+    view = view->next;
+  }
+  return size;
+}
+
+auto Data::file_ahead(int max_views) const -> int {
+  assert_same_thread(*this);
+  int offset = 0;
+  for (auto view = m_head; view && max_views > 0; view = view->next, max_views--) {
+    if (view->chunk->file()) return offset;
+    offset += view->length;
+  }
+  return -1;
+}
+
 void Data::pack(const Data &data, Producer *producer, double vacancy) {
   assert_same_thread(*this);
   if (&data == this) return;
@@ -48,23 +169,26 @@ void Data::pack(const Data &data, Producer *producer, double vacancy) {
   auto occupancy = DATA_CHUNK_SIZE - int(DATA_CHUNK_SIZE * vacancy);
   for (auto view = data.m_head; view; view = view->next) {
     auto tail = m_tail;
-    if (!tail) {
+    if (!tail || !tail->chunk->writable() || !view->chunk->writable()) {
       push_view(new View(view));
       continue;
     }
     auto tail_offset = tail->offset;
     auto tail_length = tail->length;
     if (tail_length < occupancy || view->length + tail_length <= DATA_CHUNK_SIZE) {
-      if (tail_offset > 0 || tail->chunk->retain_count > 1) {
-        tail = tail->clone(producer);
+      if (
+        tail_offset > 0 || tail->chunk->retain_count > 1 ||
+        tail->chunk->size() < std::min(int(DATA_CHUNK_SIZE), tail_length + view->length)
+      ) {
+        tail = tail->clone(producer, DATA_CHUNK_SIZE);
         delete pop_view();
         push_view(tail);
       }
-      auto tail_room = DATA_CHUNK_SIZE - tail_length;
+      auto tail_room = tail->chunk->size() - tail_length;
       auto length = std::min(view->length, int(tail_room));
       std::memcpy(
         tail->chunk->data + tail_length,
-        view->chunk->data + view->offset,
+        view->chunk->bytes() + view->offset,
         length
       );
       tail->length += length;
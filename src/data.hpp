@@ -30,6 +30,7 @@
 #include "constants.hpp"
 #include "list.hpp"
 #include "options.hpp"
+#include "simd.hpp"
 #include "utils.hpp"
 
 #include <cstring>
@@ -47,6 +48,7 @@ class SharedData;
 
 class Data : public EventTemplate<Data> {
 private:
+  struct File;
   struct Chunk;
   struct View;
 
@@ -66,6 +68,13 @@ public:
     base64url,
   };
 
+  static auto chunk_class(size_t size) -> int {
+    for (int i = 0; i < DATA_CHUNK_CLASSES - 1; i++) {
+      if (size <= DATA_CHUNK_CLASS_SIZES[i]) return i;
+    }
+    return DATA_CHUNK_CLASSES - 1;
+  }
+
   //
   // Data::Producer
   //
@@ -81,13 +90,26 @@ public:
       }
     }
 
-    Producer(const std::string &name) : m_name(name), m_count(0) {
+    Producer(const std::string &name) : m_name(name) {
+      for (auto &n : m_counts) n.store(0, std::memory_order_relaxed);
       std::lock_guard<std::mutex> lock(producer_list_mutex());
       s_all_producers.push(this);
     }
 
     auto name() const -> const std::string& { return m_name; }
-    auto count() const -> size_t { return m_count.load(std::memory_order_relaxed); }
+    auto count(int chunk_class) const -> size_t { return m_counts[chunk_class].load(std::memory_order_relaxed); }
+
+    auto count() const -> size_t {
+      size_t n = 0;
+      for (int i = 0; i < DATA_CHUNK_CLASSES; i++) n += count(i);
+      return n;
+    }
+
+    auto size() const -> size_t {
+      size_t n = 0;
+      for (int i = 0; i < DATA_CHUNK_CLASSES; i++) n += count(i) * DATA_CHUNK_CLASS_SIZES[i];
+      return n;
+    }
 
     Data* make(int size) { return Data::make(size, this); }
     Data* make(int size, int value) { return Data::make(size, value, this); }
@@ -107,12 +129,12 @@ public:
 
   private:
     std::string m_name;
-    std::atomic<size_t> m_count;
+    std::atomic<size_t> m_counts[DATA_CHUNK_CLASSES];
 
     static auto producer_list_mutex() -> std::mutex&;
 
-    void increase() { m_count.fetch_add(1, std::memory_order_relaxed); }
-    void decrease() { m_count.fetch_sub(1, std::memory_order_relaxed); }
+    void increase(int chunk_class) { m_counts[chunk_class].fetch_add(1, std::memory_order_relaxed); }
+    void decrease(int chunk_class) { m_counts[chunk_class].fetch_sub(1, std::memory_order_relaxed); }
 
     static List<Producer> s_all_producers;
 
@@ -128,7 +150,7 @@ public:
     Builder(Data &data, Producer *producer = nullptr)
       : m_data(data)
       , m_producer(producer)
-      , m_chunk(new Chunk(producer)) {}
+      , m_chunk(make_chunk(0, producer)) {}
 
     ~Builder() {
       delete m_chunk;
@@ -146,7 +168,7 @@ public:
     void flush() {
       if (m_ptr > 0) {
         m_data.push_view(new View(m_chunk, 0, m_ptr));
-        m_chunk = new Chunk(m_producer);
+        m_chunk = make_chunk(m_size + 1, m_producer);
         m_ptr = 0;
       }
     }
@@ -154,7 +176,7 @@ public:
     void push(char c) {
       m_chunk->data[m_ptr++] = c;
       m_size++;
-      if (m_ptr >= sizeof(m_chunk->data)) {
+      if (m_ptr >= m_chunk->size()) {
         flush();
       }
     }
@@ -167,14 +189,14 @@ public:
       auto &p = m_ptr;
       m_size += n;
       while (n > 0) {
-        int l = sizeof(m_chunk->data) - p;
+        int l = m_chunk->size() - p;
         if (l > n) l = n;
         std::memset(m_chunk->data + p, c, l);
         p += l;
         n -= l;
-        if (p >= sizeof(m_chunk->data)) {
+        if (p >= m_chunk->size()) {
           m_data.push_view(new View(m_chunk, 0, p));
-          m_chunk = new Chunk(m_producer);
+          m_chunk = make_chunk(m_size - n + 1, m_producer);
           p = 0;
         }
       }
@@ -188,15 +210,15 @@ public:
       auto &p = m_ptr;
       m_size += n;
       while (n > 0) {
-        int l = sizeof(m_chunk->data) - p;
+        int l = m_chunk->size() - p;
         if (l > n) l = n;
         std::memcpy(m_chunk->data + p, s, l);
         s += l;
         p += l;
         n -= l;
-        if (p >= sizeof(m_chunk->data)) {
+        if (p >= m_chunk->size()) {
           m_data.push_view(new View(m_chunk, 0, p));
-          m_chunk = new Chunk(m_producer);
+          m_chunk = make_chunk(m_size - n + 1, m_producer);
           p = 0;
         }
       }
@@ -256,7 +278,7 @@ public:
     int get() {
       auto v = m_view;
       if (!v) return -1;
-      uint8_t c = v->chunk->data[v->offset + m_offset];
+      uint8_t c = v->chunk->bytes()[v->offset + m_offset];
       if (++m_offset >= v->length) {
         m_view = v->next;
         m_offset = 0;
@@ -294,13 +316,13 @@ public:
         auto a = v->length - m_offset;
         auto b = n - i;
         if (a <= b) {
-          std::memcpy(p, v->chunk->data + v->offset + m_offset, a);
+          std::memcpy(p, v->chunk->bytes() + v->offset + m_offset, a);
           p += a;
           i += a;
           m_view = v->next;
           m_offset = 0;
         } else {
-          std::memcpy(p, v->chunk->data + v->offset + m_offset, b);
+          std::memcpy(p, v->chunk->bytes() + v->offset + m_offset, b);
           p += b;
           i += b;
           m_offset += b;
@@ -356,27 +378,102 @@ public:
 
 private:
 
+  //
+  // Data::File
+  //
+
+  struct File {
+    std::atomic<int> retain_count;
+    int fd;
+
+    File(int f)
+      : retain_count(0)
+      , fd(f) {}
+
+    ~File();
+
+    void retain() { retain_count.fetch_add(1, std::memory_order_relaxed); }
+    void release() { if (retain_count.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this; }
+  };
+
   //
   // Data::Chunk
   //
 
-  struct Chunk : public Pooled<Chunk> {
+  struct Chunk {
     std::atomic<int> retain_count;
-    char data[DATA_CHUNK_SIZE];
+    char* data;
 
-    Chunk(Producer *producer)
+    Chunk(char *d, int size, Producer *producer)
       : retain_count(0)
-      , m_producer(producer ? producer : Producer::unknown()) { m_producer->increase(); }
-    ~Chunk() { m_producer->decrease(); }
+      , data(d)
+      , m_size(size)
+      , m_producer(producer) { if (producer) producer->increase(chunk_class(size)); }
 
-    auto size() const -> int { return sizeof(data); }
+    virtual ~Chunk() { if (m_producer) m_producer->decrease(chunk_class(m_size)); }
+
+    auto size() const -> int { return m_size; }
+    auto file() const -> File* { return m_file; }
+    auto position() const -> size_t { return m_position; }
+    auto bytes() -> char* { return m_file ? load() : data; }
+    bool writable() const { return !m_file; }
     void retain() { retain_count.fetch_add(1, std::memory_order_relaxed); }
     void release() { if (retain_count.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this; }
 
-  private:
+  protected:
+    int m_size;
     Producer* m_producer;
+    File* m_file = nullptr;
+    size_t m_position = 0;
+
+    virtual auto load() -> char* { return data; }
+  };
+
+  //
+  // Data::BufferChunk
+  //
+
+  template<size_t N>
+  struct BufferChunk : public Pooled<BufferChunk<N>, Chunk> {
+    char buffer[N];
+
+    BufferChunk(Producer *producer)
+      : Pooled<BufferChunk<N>, Chunk>(buffer, N, producer ? producer : Producer::unknown()) {}
   };
 
+  //
+  // Data::FileChunk
+  //
+
+  struct FileChunk : public Pooled<FileChunk, Chunk> {
+    std::atomic<char*> buffer;
+
+    FileChunk(File *file, size_t position, int size)
+      : Pooled<FileChunk, Chunk>(nullptr, size, nullptr)
+      , buffer(nullptr)
+    {
+      m_file = file;
+      m_position = position;
+      file->retain();
+    }
+
+    ~FileChunk() {
+      delete [] buffer.load();
+      m_file->release();
+    }
+
+    virtual auto load() -> char* override;
+  };
+
+  static auto make_chunk(size_t size, Producer *producer) -> Chunk* {
+    switch (chunk_class(size)) {
+      case 0: return new BufferChunk<DATA_CHUNK_CLASS_SIZES[0]>(producer);
+      case 1: return new BufferChunk<DATA_CHUNK_CLASS_SIZES[1]>(producer);
+      case 2: return new BufferChunk<DATA_CHUNK_CLASS_SIZES[2]>(producer);
+      default: return new BufferChunk<DATA_CHUNK_CLASS_SIZES[3]>(producer);
+    }
+  }
+
   //
   // Data::View
   //
@@ -409,6 +506,7 @@ private:
     }
 
     int push(const void *p, int n) {
+      if (!chunk->writable()) return 0;
       int tail = offset + length;
       int room = std::min(chunk->size() - tail, n);
       if (room > 0) {
@@ -432,10 +530,10 @@ private:
       return view;
     }
 
-    View* clone(Producer *producer) {
+    View* clone(Producer *producer, int size = 0) {
       if (!producer) producer = &s_unknown_producer;
-      auto new_chunk = new Chunk(producer);
-      std::memcpy(new_chunk->data, chunk->data + offset, length);
+      auto new_chunk = make_chunk(std::max(size, length), producer);
+      std::memcpy(new_chunk->data, chunk->bytes() + offset, length);
       return new View(new_chunk, 0, length);
     }
   };
@@ -476,7 +574,7 @@ public:
       }
 
       auto operator*() const -> std::tuple<char*, int> {
-        return std::make_tuple(m_p->chunk->data + m_p->offset, m_p->length);
+        return std::make_tuple(m_p->chunk->bytes() + m_p->offset, m_p->length);
       }
     };
 
@@ -501,7 +599,7 @@ public:
   {
     if (!producer) producer = &s_unknown_producer;
     while (size > 0) {
-      auto chunk = new Chunk(producer);
+      auto chunk = make_chunk(std::min(size, int(DATA_CHUNK_SIZE)), producer);
       auto length = std::min(size, chunk->size());
       push_view(new View(chunk, 0, length));
       size -= length;
@@ -515,7 +613,7 @@ public:
   {
     if (!producer) producer = &s_unknown_producer;
     while (size > 0) {
-      auto chunk = new Chunk(producer);
+      auto chunk = make_chunk(std::min(size, int(DATA_CHUNK_SIZE)), producer);
       auto length = std::min(size, chunk->size());
       std::memset(chunk->data, value, length);
       push_view(new View(chunk, 0, length));
@@ -723,7 +821,8 @@ public:
       }
     }
     while (n > 0) {
-      auto view = new View(new Chunk(producer), 0, 0);
+      auto hint = std::max(n, std::min(m_size, int(DATA_CHUNK_SIZE)));
+      auto view = new View(make_chunk(hint, producer), 0, 0);
       auto added = view->push(p, n);
       p += added;
       n -= added;
@@ -739,7 +838,7 @@ public:
     assert_same_thread(*this);
     if (auto tail = m_tail) {
       auto chunk = tail->chunk;
-      if (chunk->retain_count == 1) {
+      if (chunk->retain_count == 1 && chunk->writable()) {
         int end = tail->offset + tail->length;
         if (end < chunk->size()) {
           chunk->data[end] = ch;
@@ -749,16 +848,20 @@ public:
         }
       }
     }
-    auto chunk = new Chunk(producer ? producer : &s_unknown_producer);
+    auto chunk = make_chunk(std::min(m_size + 1, int(DATA_CHUNK_SIZE)), producer ? producer : &s_unknown_producer);
     auto view = new View(chunk, 0, 1);
     chunk->data[0] = ch;
     push_view(view);
   }
 
+  bool push_file(const std::string &filename, Producer *producer);
+  auto file_head(int &fd, size_t &offset) const -> size_t;
+  auto file_ahead(int max_views) const -> int;
+
   void scan(const std::function<bool(int)> &f) {
     assert_same_thread(*this);
     for (auto view = m_head; view; view = view->next) {
-      auto data = view->chunk->data;
+      auto data = view->chunk->bytes();
       auto size = view->length;
       auto head = view->offset;
       for (int i = 0; i < size; ++i) if (!f(data[head + i])) return;
@@ -816,7 +919,7 @@ public:
     auto i = 0;
     while (auto view = m_head) {
       if (n <= 0) break;
-      auto p = view->chunk->data + view->offset;
+      auto p = view->chunk->bytes() + view->offset;
       auto l = view->length;
       if (l <= n) {
         std::memcpy(out + i, p, l);
@@ -853,7 +956,7 @@ public:
     assert_same_thread(*this);
     assert_same_thread(out);
     while (auto view = m_head) {
-      auto data = view->chunk->data;
+      auto data = view->chunk->bytes();
       auto size = view->length;
       auto head = view->offset;
       auto n = 0;
@@ -879,7 +982,7 @@ public:
     assert_same_thread(*this);
     assert_same_thread(out);
     while (auto view = m_head) {
-      auto data = view->chunk->data;
+      auto data = view->chunk->bytes();
       auto size = view->length;
       auto head = view->offset;
       auto n = 0;
@@ -900,11 +1003,33 @@ public:
     }
   }
 
+  bool shift_to(char c, Data &out) {
+    assert_same_thread(*this);
+    assert_same_thread(out);
+    while (auto view = m_head) {
+      auto size = view->length;
+      auto n = simd::find(view->chunk->bytes() + view->offset, size, c);
+      if (n == size) {
+        out.push_view(shift_view());
+      } else {
+        n++;
+        if (n == size) {
+          out.push_view(shift_view());
+        } else {
+          out.push_view(view->shift(n));
+          m_size -= n;
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+
   void shift_to(const std::function<bool(int)> &f, Data &out) {
     assert_same_thread(*this);
     assert_same_thread(out);
     while (auto view = m_head) {
-      auto data = view->chunk->data;
+      auto data = view->chunk->bytes();
       auto size = view->length;
       auto head = view->offset;
       auto n = 0;
@@ -931,14 +1056,14 @@ public:
   void to_chunks(const std::function<void(const uint8_t*, int)> &cb) const {
     assert_same_thread(*this);
     for (auto view = m_head; view; view = view->next) {
-      cb((uint8_t*)view->chunk->data + view->offset, view->length);
+      cb((uint8_t*)view->chunk->bytes() + view->offset, view->length);
     }
   }
 
   void to_bytes(const std::function<bool(uint8_t)>& cb) const {
     assert_same_thread(*this);
     for (auto view = m_head; view; view = view->next) {
-      auto p = (uint8_t*)view->chunk->data + view->offset;
+      auto p = (uint8_t*)view->chunk->bytes() + view->offset;
       auto n = view->length;
       for (int i = 0; i < n; i++) {
         if (!cb(p[i])) return;
@@ -951,7 +1076,7 @@ public:
     auto p = buf;
     for (auto view = m_head; view; view = view->next) {
       auto length = view->length;
-      std::memcpy(p, view->chunk->data + view->offset, length);
+      std::memcpy(p, view->chunk->bytes() + view->offset, length);
       p += length;
     }
   }
@@ -962,7 +1087,7 @@ public:
     for (auto view = m_head; view && len > 0; view = view->next) {
       auto length = view->length;
       auto n = length < len ? length : len;
-      std::memcpy(ptr, view->chunk->data + view->offset, n);
+      std::memcpy(ptr, view->chunk->bytes() + view->offset, n);
       len -= n;
       ptr += n;
     }
@@ -983,7 +1108,7 @@ public:
     for (auto view = m_head; n > 0 && view; view = view->next) {
       auto length = view->length;
       if (length > n) length = n;
-      str.replace(i, length, view->chunk->data + view->offset, length);
+      str.replace(i, length, view->chunk->bytes() + view->offset, length);
       i += length;
       n -= length;
     }
@@ -83,6 +83,77 @@ auto EventQueue::dequeue() -> Event* {
   }
 }
 
+//
+// EventRing
+//
+
+EventRing::EventRing(size_t capacity)
+  : m_tail(0)
+  , m_head(0)
+{
+  size_t n = 2;
+  while (n < capacity) n <<= 1;
+  m_cells = new Cell[n];
+  m_mask = n - 1;
+  for (size_t i = 0; i < n; i++) {
+    m_cells[i].sequence.store(0, std::memory_order_relaxed);
+    m_cells[i].event = nullptr;
+  }
+}
+
+EventRing::~EventRing() {
+  auto head = m_head.load(std::memory_order_relaxed);
+  auto tail = m_tail.load(std::memory_order_relaxed);
+  for (auto i = head; i != tail; i++) {
+    auto &cell = m_cells[i & m_mask];
+    if (cell.sequence.load(std::memory_order_acquire) == i + 1) {
+      cell.event->release();
+    }
+  }
+  delete [] m_cells;
+}
+
+bool EventRing::empty() const {
+  auto head = m_head.load(std::memory_order_relaxed);
+  auto &cell = m_cells[head & m_mask];
+  return cell.sequence.load(std::memory_order_acquire) != head + 1;
+}
+
+auto EventRing::enqueue(Event **evts, size_t count) -> size_t {
+  size_t tail, n;
+  for (;;) {
+    tail = m_tail.load(std::memory_order_relaxed);
+    auto head = m_head.load(std::memory_order_acquire);
+    if (head > tail) continue;
+    n = std::min(count, capacity() - (tail - head));
+    if (!n) return 0;
+    if (m_tail.compare_exchange_weak(tail, tail + n, std::memory_order_relaxed)) break;
+  }
+  for (size_t i = 0; i < n; i++) {
+    auto pos = tail + i;
+    auto &cell = m_cells[pos & m_mask];
+    cell.event = SharedEvent::make(evts[i])->retain();
+    cell.sequence.store(pos + 1, std::memory_order_release);
+  }
+  return n;
+}
+
+auto EventRing::dequeue(Event **evts, size_t count) -> size_t {
+  auto head = m_head.load(std::memory_order_relaxed);
+  size_t n = 0;
+  while (n < count) {
+    auto &cell = m_cells[head & m_mask];
+    if (cell.sequence.load(std::memory_order_acquire) != head + 1) break;
+    auto *se = cell.event;
+    cell.event = nullptr;
+    head++;
+    if (auto evt = se->to_event()) evts[n++] = evt;
+    se->release();
+  }
+  m_head.store(head, std::memory_order_release);
+  return n;
+}
+
 //
 // EventQueue::SharedEvent
 //
@@ -121,6 +121,44 @@ private:
   static SharedTable<SharedEvent> s_event_pool;
 };
 
+//
+// EventRing
+//
+
+class EventRing {
+public:
+  EventRing(size_t capacity = 256);
+  ~EventRing();
+
+  auto capacity() const -> size_t { return m_mask + 1; }
+  bool empty() const;
+  bool enqueue(Event *evt) { return enqueue(&evt, 1) == 1; }
+  auto enqueue(Event **evts, size_t count) -> size_t;
+  auto dequeue(Event **evts, size_t count) -> size_t;
+
+  auto dequeue() -> Event* {
+    Event *evt = nullptr;
+    dequeue(&evt, 1);
+    return evt;
+  }
+
+private:
+  enum { CACHE_LINE_SIZE = 64 };
+
+  struct Cell {
+    std::atomic<size_t> sequence;
+    SharedEvent* event;
+  };
+
+  Cell* m_cells;
+  size_t m_mask;
+  char m_padding0[CACHE_LINE_SIZE];
+  std::atomic<size_t> m_tail;
+  char m_padding1[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> m_head;
+  char m_padding2[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+};
+
 } // namespace pipy
 
 #endif // EVENT_QUEUE_HPP
@@ -63,6 +63,11 @@ auto Filter::context() const -> Context* {
   }
 }
 
+bool Filter::spliceable() const {
+  if (!m_pipeline || !m_pipeline->spliceable()) return false;
+  return !List<Filter>::Item::back() && !List<Filter>::Item::next();
+}
+
 void Filter::set_location(const pjs::Location &loc) {
   m_location = loc;
   if (auto src = loc.source) {
@@ -85,6 +85,7 @@ public:
 
   auto module_legacy() const -> ModuleBase*;
   auto context() const -> Context*;
+  bool spliceable() const;
   auto location() const -> const pjs::Location& { return m_location; }
   auto buffer_stats() const -> std::shared_ptr<BufferStats> { return m_buffer_stats; }
 
@@ -0,0 +1,697 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "cache.hpp"
+#include "data.hpp"
+#include "input.hpp"
+#include "net.hpp"
+#include "utils.hpp"
+#include "api/http.hpp"
+
+#include <cmath>
+#include <cstdlib>
+
+namespace pipy {
+
+thread_local static const pjs::ConstStr s_GET("GET");
+thread_local static const pjs::ConstStr s_host("host");
+thread_local static const pjs::ConstStr s_age("age");
+thread_local static const pjs::ConstStr s_vary("vary");
+thread_local static const pjs::ConstStr s_authorization("authorization");
+thread_local static const pjs::ConstStr s_cache_control("cache-control");
+thread_local static const pjs::ConstStr s_set_cookie("set-cookie");
+thread_local static const pjs::ConstStr s_connection("connection");
+thread_local static const pjs::ConstStr s_keep_alive("keep-alive");
+thread_local static const pjs::ConstStr s_transfer_encoding("transfer-encoding");
+thread_local static const pjs::ConstStr s_content_length("content-length");
+thread_local static const pjs::ConstStr s_etag("etag");
+thread_local static const pjs::ConstStr s_if_none_match("if-none-match");
+
+//
+// CacheControl
+//
+
+struct CacheControl {
+  bool no_store = false;
+  bool no_cache = false;
+  bool is_private = false;
+  double max_age = -1;
+  double s_maxage = -1;
+  double stale_while_revalidate = -1;
+
+  CacheControl(pjs::Object *headers) {
+    pjs::Value v;
+    if (!headers || !headers->get(s_cache_control, v)) return;
+    if (v.is_string()) {
+      parse(v.s()->str());
+    } else if (v.is_array()) {
+      v.as<pjs::Array>()->iterate_all(
+        [this](pjs::Value &v, int) {
+          if (v.is_string()) parse(v.s()->str());
+        }
+      );
+    }
+  }
+
+  void parse(const std::string &s) {
+    size_t i = 0, n = s.length();
+    while (i < n) {
+      while (i < n && (std::isblank((unsigned char)s[i]) || s[i] == ',')) i++;
+      auto p = i;
+      while (i < n && s[i] != '=' && s[i] != ',' && !std::isblank((unsigned char)s[i])) i++;
+      auto name = s.substr(p, i - p);
+      for (auto &c : name) c = std::tolower((unsigned char)c);
+      double value = -1;
+      while (i < n && std::isblank((unsigned char)s[i])) i++;
+      if (i < n && s[i] == '=') {
+        i++;
+        if (i < n && s[i] == '"') i++;
+        if (i < n && std::isdigit((unsigned char)s[i])) {
+          value = 0;
+          while (i < n && std::isdigit((unsigned char)s[i])) value = value * 10 + (s[i++] - '0');
+        }
+        while (i < n && s[i] != ',') i++;
+      }
+      if (name == "no-store") no_store = true;
+      else if (name == "no-cache") no_cache = true;
+      else if (name == "private") is_private = true;
+      else if (name == "max-age") max_age = value;
+      else if (name == "s-maxage") s_maxage = value;
+      else if (name == "stale-while-revalidate") stale_while_revalidate = value;
+    }
+  }
+};
+
+static auto header_string(pjs::Object *headers, pjs::Str *name) -> std::string {
+  pjs::Value v;
+  if (!headers || !headers->get(name, v) || v.is_undefined()) return std::string();
+  auto s = v.to_string();
+  auto str = s->str();
+  s->release();
+  return str;
+}
+
+//
+// CacheHTTP::Options
+//
+
+CacheHTTP::Options::Options(pjs::Object *options) {
+  Value(options, "name")
+    .get(name)
+    .check_nullable();
+  Value(options, "key")
+    .get(key_f)
+    .check_nullable();
+  Value(options, "maxSize")
+    .get_binary_size(max_size)
+    .check_nullable();
+  Value(options, "ttl")
+    .get_seconds(ttl)
+    .check_nullable();
+  Value(options, "staleWhileRevalidate")
+    .get_seconds(stale_while_revalidate)
+    .check_nullable();
+  Value(options, "timeout")
+    .get_seconds(timeout)
+    .check_nullable();
+}
+
+//
+// CacheHTTP
+//
+
+CacheHTTP::CacheHTTP(const Options &options)
+  : m_options(options)
+  , m_cache(Cache::get(options.name ? options.name->str() : std::string(), options.max_size))
+  , m_buffer(Filter::buffer_stats())
+{
+}
+
+CacheHTTP::CacheHTTP(const CacheHTTP &r)
+  : Filter(r)
+  , m_options(r.m_options)
+  , m_cache(r.m_cache)
+  , m_buffer(r.m_buffer)
+{
+}
+
+CacheHTTP::~CacheHTTP()
+{
+}
+
+void CacheHTTP::dump(Dump &d) {
+  Filter::dump(d);
+  d.name = "cacheHTTP";
+}
+
+auto CacheHTTP::clone() -> Filter* {
+  return new CacheHTTP(*this);
+}
+
+void CacheHTTP::reset() {
+  Filter::reset();
+  EventSource::close();
+  m_timer.cancel();
+  if (m_waiter) {
+    m_waiter->m_filter = nullptr;
+    m_waiter = nullptr;
+  }
+  leave();
+  m_request_reader.reset();
+  m_response_reader.reset();
+  m_buffer.clear();
+  m_request = nullptr;
+  m_request_head = nullptr;
+  m_pipeline = nullptr;
+  m_key.clear();
+  m_state = IDLE;
+  m_response_size = 0;
+  m_is_storing = false;
+}
+
+void CacheHTTP::process(Event *evt) {
+  switch (m_state) {
+    case IDLE:
+      if (auto start = evt->as<MessageStart>()) {
+        auto head = pjs::coerce<http::RequestHead>(start->head());
+        auto headers = head->headers.get();
+        if (
+          head->method != s_GET ||
+          (headers && headers->has(s_authorization)) ||
+          CacheControl(headers).no_store
+        ) {
+          m_state = BYPASS;
+          m_pipeline = sub_pipeline(0, false, EventSource::reply())->start();
+          m_pipeline->input()->input(evt);
+          return;
+        }
+        m_request_head = head;
+        m_state = READING;
+      } else {
+        if (evt->is<StreamEnd>()) Filter::output(evt);
+        return;
+      }
+      // fall through
+
+    case READING:
+      if (auto msg = m_request_reader.read(evt)) {
+        m_request = msg;
+        msg->release();
+        if (m_options.key_f) {
+          pjs::Value arg(m_request_head.get()), ret;
+          if (!Filter::callback(m_options.key_f, 1, &arg, ret)) return;
+          auto s = ret.to_string();
+          m_key = s->str();
+          s->release();
+        } else {
+          auto host = m_request_head->authority
+            ? m_request_head->authority->str()
+            : header_string(m_request_head->headers, s_host);
+          auto path = m_request_head->path ? m_request_head->path->str() : std::string();
+          m_key = host + path;
+        }
+        auto cc = CacheControl(m_request_head->headers);
+        if (cc.no_cache || cc.max_age == 0) {
+          fetch(true);
+        } else {
+          lookup();
+        }
+      } else if (evt->is<StreamEnd>()) {
+        m_state = DONE;
+        Filter::output(evt);
+      }
+      break;
+
+    case WAITING:
+      m_buffer.push(evt);
+      break;
+
+    case FETCHING:
+    case BYPASS:
+      m_pipeline->input()->input(evt);
+      break;
+
+    case DONE:
+      if (evt->is<StreamEnd>()) Filter::output(evt);
+      break;
+  }
+}
+
+void CacheHTTP::on_reply(Event *evt) {
+  if (m_is_storing) {
+    if (!keep_reading(m_options, m_cache, evt, m_response_size)) {
+      m_response_reader.reset();
+      m_is_storing = false;
+      leave();
+    } else if (auto msg = m_response_reader.read(evt)) {
+      if (evt->is<MessageEnd>()) {
+        pjs::Ref<Entry> entry = make_entry(m_options, m_request_head, msg);
+        if (entry) m_cache->store(m_key, entry);
+      }
+      msg->release();
+      m_is_storing = false;
+      leave();
+    } else if (evt->is<StreamEnd>()) {
+      m_is_storing = false;
+      leave();
+    }
+  }
+  Filter::output(evt);
+}
+
+bool CacheHTTP::lookup() {
+  auto now = utils::now();
+  auto entry = m_cache->find(m_key);
+  if (entry && entry->matches(m_request_head)) {
+    if (entry->is_fresh(now)) {
+      serve(entry, now);
+      return true;
+    }
+    if (entry->is_usable(now)) {
+      if (m_cache->begin_fetch(m_key, nullptr)) {
+        auto r = new Revalidator(this);
+        r->start(this, m_request);
+      }
+      serve(entry, now);
+      return true;
+    }
+  }
+
+  pjs::Ref<Waiter> waiter = new Waiter(this);
+  if (m_cache->begin_fetch(m_key, waiter)) {
+    m_is_leader = true;
+    fetch(true);
+  } else {
+    m_waiter = waiter;
+    m_state = WAITING;
+    schedule_timeout();
+  }
+  return false;
+}
+
+void CacheHTTP::fetch(bool store) {
+  m_state = FETCHING;
+  m_is_storing = store;
+  if (m_is_leader) schedule_timeout();
+  m_pipeline = sub_pipeline(0, false, EventSource::reply())->start();
+  m_request->write(m_pipeline->input());
+  m_buffer.flush(m_pipeline->input());
+}
+
+void CacheHTTP::wake(bool failed) {
+  m_timer.cancel();
+  m_waiter->m_filter = nullptr;
+  m_waiter = nullptr;
+  if (m_state != WAITING) return;
+
+  auto now = utils::now();
+  auto entry = m_cache->find(m_key);
+  if (entry && entry->matches(m_request_head) && entry->is_usable(now)) {
+    serve(entry, now);
+  } else if (failed) {
+    fail();
+  } else {
+    m_is_leader = m_cache->begin_fetch(m_key, nullptr);
+    fetch(true);
+  }
+}
+
+void CacheHTTP::serve(Entry *entry, double now) {
+  auto head = http::ResponseHead::make();
+  auto headers = pjs::Object::make();
+  head->status = entry->status;
+  head->headers = headers;
+
+  for (const auto &p : entry->headers) {
+    pjs::Ref<pjs::Str> k(pjs::Str::make(p.first));
+    pjs::Value v(pjs::Str::make(p.second)), old;
+    if (headers->get(k, old)) {
+      if (old.is_array()) {
+        old.as<pjs::Array>()->push(v);
+      } else {
+        auto a = pjs::Array::make(2);
+        a->set(0, old);
+        a->set(1, v);
+        headers->set(k, a);
+      }
+    } else {
+      headers->set(k, v);
+    }
+  }
+
+  auto age = std::floor(entry->age(now) / 1000);
+  headers->set(s_age, pjs::Str::make(age > 0 ? age : 0));
+
+  auto etag = header_string(headers, s_etag);
+  if (!etag.empty() && (head->status == 200 || head->status == 203)) {
+    auto if_none_match = header_string(m_request_head->headers, s_if_none_match);
+    if (etag.compare(0, 2, "W/") == 0) etag = etag.substr(2);
+    if (!if_none_match.empty() && http::Directory::match_etag(if_none_match, etag)) {
+      head->status = 304;
+      respond(Message::make(head, nullptr));
+      return;
+    }
+  }
+
+  Data body;
+  if (entry->body) entry->body->to_data(body);
+  respond(Message::make(head, Data::make(std::move(body))));
+}
+
+void CacheHTTP::fail() {
+  auto head = http::ResponseHead::make();
+  head->status = 504;
+  respond(Message::make(head, Data::make()));
+}
+
+void CacheHTTP::respond(Message *response) {
+  m_state = DONE;
+  Filter::output(response);
+  m_buffer.flush(
+    [this](Event *evt) {
+      if (evt->is<StreamEnd>()) Filter::output(evt);
+    }
+  );
+}
+
+void CacheHTTP::leave(bool failed) {
+  if (m_is_leader) {
+    m_is_leader = false;
+    m_timer.cancel();
+    m_cache->end_fetch(m_key, failed);
+  }
+}
+
+void CacheHTTP::schedule_timeout() {
+  if (m_options.timeout > 0) {
+    m_timer.schedule(
+      m_options.timeout,
+      [this]() {
+        InputContext ic;
+        on_timeout();
+      }
+    );
+  }
+}
+
+void CacheHTTP::on_timeout() {
+  if (m_state == WAITING) {
+    wake(true);
+  } else {
+    leave(true);
+  }
+}
+
+auto CacheHTTP::lifetime(
+  const Options &options,
+  http::ResponseHead *head,
+  double &stale_while_revalidate
+) -> double {
+  switch (head->status) {
+    case 200: case 203: case 204: case 300:
+    case 301: case 308: case 404: case 410:
+      break;
+    default: return 0;
+  }
+
+  auto headers = head->headers.get();
+  if (headers && headers->has(s_set_cookie)) return 0;
+
+  CacheControl cc(headers);
+  if (cc.no_store || cc.no_cache || cc.is_private) return 0;
+
+  stale_while_revalidate = (
+    cc.stale_while_revalidate >= 0 ? cc.stale_while_revalidate :
+    options.stale_while_revalidate
+  );
+
+  return (
+    cc.s_maxage >= 0 ? cc.s_maxage :
+    cc.max_age >= 0 ? cc.max_age : options.ttl
+  );
+}
+
+bool CacheHTTP::keep_reading(const Options &options, Cache *cache, Event *evt, size_t &size) {
+  auto limit = cache->max_size() / 8;
+  if (auto start = evt->as<MessageStart>()) {
+    auto head = pjs::coerce<http::ResponseHead>(start->head());
+    double swr;
+    if (lifetime(options, head, swr) <= 0) return false;
+    auto len = header_string(head->headers, s_content_length);
+    if (!len.empty() && std::strtoull(len.c_str(), nullptr, 10) > limit) return false;
+    size = 0;
+  } else if (auto data = evt->as<Data>()) {
+    size += data->size();
+    if (size > limit) return false;
+  }
+  return true;
+}
+
+auto CacheHTTP::make_entry(
+  const Options &options,
+  http::RequestHead *request,
+  Message *response
+) -> Entry* {
+  auto head = pjs::coerce<http::ResponseHead>(response->head());
+  auto headers = head->headers.get();
+
+  double swr = 0;
+  auto max_age = lifetime(options, head, swr);
+  if (max_age <= 0) return nullptr;
+
+  Entry::Fields vary;
+  auto vary_str = header_string(headers, s_vary);
+  for (size_t i = 0, n = vary_str.length(); i < n; i++) {
+    while (i < n && std::isblank((unsigned char)vary_str[i])) i++;
+    auto p = i;
+    while (i < n && vary_str[i] != ',' && !std::isblank((unsigned char)vary_str[i])) i++;
+    if (i == p) continue;
+    auto name = vary_str.substr(p, i - p);
+    if (name == "*") return nullptr;
+    for (auto &c : name) c = std::tolower((unsigned char)c);
+    pjs::Ref<pjs::Str> k(pjs::Str::make(name));
+    vary.emplace_back(name, header_string(request->headers, k));
+    while (i < n && vary_str[i] != ',') i++;
+  }
+
+  auto age = std::atof(header_string(headers, s_age).c_str());
+  auto entry = new Entry;
+  entry->status = head->status;
+  entry->vary = std::move(vary);
+  entry->time = utils::now() - (age > 0 ? age * 1000 : 0);
+  entry->max_age = max_age * 1000;
+  entry->stale_while_revalidate = swr * 1000;
+
+  size_t size = 0;
+  if (headers) {
+    headers->iterate_all(
+      [&](pjs::Str *k, pjs::Value &v) {
+        if (k == s_connection || k == s_keep_alive) return;
+        if (k == s_transfer_encoding || k == s_content_length) return;
+        if (k == s_age) return;
+        auto add = [&](const pjs::Value &v) {
+          auto s = v.to_string();
+          entry->headers.emplace_back(k->str(), s->str());
+          size += k->size() + s->size();
+          s->release();
+        };
+        if (v.is_array()) {
+          v.as<pjs::Array>()->iterate_all([&](pjs::Value &v, int) { add(v); });
+        } else {
+          add(v);
+        }
+      }
+    );
+  }
+
+  if (auto body = response->body()) {
+    entry->body = SharedData::make(*body);
+    size += body->size();
+  }
+
+  entry->size = size;
+  return entry;
+}
+
+//
+// CacheHTTP::Entry
+//
+
+bool CacheHTTP::Entry::matches(http::RequestHead *head) const {
+  for (const auto &p : vary) {
+    pjs::Ref<pjs::Str> k(pjs::Str::make(p.first));
+    if (header_string(head->headers, k) != p.second) return false;
+  }
+  return true;
+}
+
+//
+// CacheHTTP::Waiter
+//
+
+CacheHTTP::Waiter::Waiter(CacheHTTP *filter)
+  : m_net(Net::current())
+  , m_filter(filter)
+{
+}
+
+void CacheHTTP::Waiter::wake(bool failed) {
+  retain();
+  m_net.post(
+    [=]() {
+      InputContext ic;
+      if (auto f = m_filter) f->wake(failed);
+      release();
+    }
+  );
+}
+
+//
+// CacheHTTP::Cache
+//
+
+std::unordered_map<std::string, CacheHTTP::Cache*> CacheHTTP::Cache::s_caches;
+std::mutex CacheHTTP::Cache::s_caches_mutex;
+
+auto CacheHTTP::Cache::get(const std::string &name, size_t max_size) -> Cache* {
+  std::lock_guard<std::mutex> lock(s_caches_mutex);
+  auto &c = s_caches[name];
+  if (!c) c = new Cache(max_size);
+  return c;
+}
+
+auto CacheHTTP::Cache::find(const std::string &key) -> pjs::Ref<Entry> {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto i = m_slots.find(key);
+  if (i == m_slots.end()) return nullptr;
+  auto &slot = i->second;
+  if (!slot.entry) return nullptr;
+  m_lru.splice(m_lru.begin(), m_lru, slot.lru);
+  return slot.entry;
+}
+
+bool CacheHTTP::Cache::begin_fetch(const std::string &key, Waiter *waiter) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto &slot = m_slots[key];
+  if (slot.fetching) {
+    if (waiter) slot.waiters.push_back(waiter);
+    return false;
+  }
+  slot.fetching = true;
+  return true;
+}
+
+void CacheHTTP::Cache::end_fetch(const std::string &key, bool failed) {
+  std::vector<pjs::Ref<Waiter>> waiters;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto i = m_slots.find(key);
+    if (i == m_slots.end()) return;
+    auto &slot = i->second;
+    slot.fetching = false;
+    waiters.swap(slot.waiters);
+    if (!slot.entry) m_slots.erase(i);
+  }
+  for (const auto &w : waiters) w->wake(failed);
+}
+
+void CacheHTTP::Cache::store(const std::string &key, Entry *entry) {
+  if (entry->size > m_max_size / 8) return;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto &slot = m_slots[key];
+  if (slot.entry) {
+    m_size -= slot.entry->size;
+    m_lru.splice(m_lru.begin(), m_lru, slot.lru);
+  } else {
+    slot.lru = m_lru.insert(m_lru.begin(), key);
+  }
+  slot.entry = entry;
+  m_size += entry->size;
+  while (m_size > m_max_size && m_lru.size() > 1) {
+    remove(m_slots.find(m_lru.back()));
+  }
+}
+
+void CacheHTTP::Cache::remove(std::unordered_map<std::string, Slot>::iterator i) {
+  auto &slot = i->second;
+  m_size -= slot.entry->size;
+  m_lru.erase(slot.lru);
+  slot.entry = nullptr;
+  if (!slot.fetching) m_slots.erase(i);
+}
+
+//
+// CacheHTTP::Revalidator
+//
+
+CacheHTTP::Revalidator::Revalidator(CacheHTTP *filter)
+  : m_cache(filter->m_cache)
+  , m_options(filter->m_options)
+  , m_key(filter->m_key)
+  , m_request(filter->m_request_head)
+{
+}
+
+void CacheHTTP::Revalidator::start(CacheHTTP *filter, Message *request) {
+  if (m_options.timeout > 0) {
+    m_timer.schedule(
+      m_options.timeout,
+      [this]() {
+        if (!m_done) finish(true);
+      }
+    );
+  }
+  m_pipeline = filter->sub_pipeline(0, true, EventTarget::input())->start();
+  request->write(m_pipeline->input());
+}
+
+void CacheHTTP::Revalidator::on_event(Event *evt) {
+  if (m_done) return;
+  if (!keep_reading(m_options, m_cache, evt, m_size)) {
+    finish();
+  } else if (auto msg = m_reader.read(evt)) {
+    if (evt->is<MessageEnd>()) {
+      pjs::Ref<Entry> entry = make_entry(m_options, m_request, msg);
+      if (entry) m_cache->store(m_key, entry);
+    }
+    msg->release();
+    finish();
+  } else if (evt->is<StreamEnd>()) {
+    finish();
+  }
+}
+
+void CacheHTTP::Revalidator::finish(bool failed) {
+  m_done = true;
+  m_timer.cancel();
+  m_reader.reset();
+  m_cache->end_fetch(m_key, failed);
+  Net::current().post(
+    [this]() {
+      delete this;
+    }
+  );
+}
+
+} // namespace pipy
@@ -0,0 +1,224 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include "filter.hpp"
+#include "buffer.hpp"
+#include "message.hpp"
+#include "options.hpp"
+#include "timer.hpp"
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pipy {
+
+class Net;
+class SharedData;
+
+namespace http {
+class RequestHead;
+class ResponseHead;
+}
+
+//
+// CacheHTTP
+//
+
+class CacheHTTP : public Filter, public EventSource {
+public:
+  struct Options : public pipy::Options {
+    pjs::Ref<pjs::Str> name;
+    pjs::Ref<pjs::Function> key_f;
+    size_t max_size = 64*1024*1024;
+    double ttl = 0;
+    double stale_while_revalidate = 0;
+    double timeout = 10;
+    Options() {}
+    Options(pjs::Object *options);
+  };
+
+  CacheHTTP(const Options &options);
+
+private:
+  CacheHTTP(const CacheHTTP &r);
+  ~CacheHTTP();
+
+  virtual auto clone() -> Filter* override;
+  virtual void reset() override;
+  virtual void process(Event *evt) override;
+  virtual void on_reply(Event *evt) override;
+  virtual void dump(Dump &d) override;
+
+  //
+  // CacheHTTP::Entry
+  //
+
+  struct Entry : public pjs::RefCountMT<Entry> {
+    typedef std::vector<std::pair<std::string, std::string>> Fields;
+
+    int status = 200;
+    Fields headers;
+    Fields vary;
+    pjs::Ref<SharedData> body;
+    size_t size = 0;
+    double time = 0;
+    double max_age = 0;
+    double stale_while_revalidate = 0;
+
+    bool matches(http::RequestHead *head) const;
+    auto age(double now) const -> double { return now - time; }
+    bool is_fresh(double now) const { return age(now) < max_age; }
+    bool is_usable(double now) const { return age(now) < max_age + stale_while_revalidate; }
+  };
+
+  //
+  // CacheHTTP::Waiter
+  //
+
+  class Waiter : public pjs::RefCountMT<Waiter> {
+  public:
+    Waiter(CacheHTTP *filter);
+    void wake(bool failed);
+
+  private:
+    Net& m_net;
+    CacheHTTP* m_filter;
+
+    friend class CacheHTTP;
+  };
+
+  //
+  // CacheHTTP::Cache
+  //
+
+  class Cache {
+  public:
+    static auto get(const std::string &name, size_t max_size) -> Cache*;
+
+    auto max_size() const -> size_t { return m_max_size; }
+    auto find(const std::string &key) -> pjs::Ref<Entry>;
+    bool begin_fetch(const std::string &key, Waiter *waiter);
+    void end_fetch(const std::string &key, bool failed = false);
+    void store(const std::string &key, Entry *entry);
+
+  private:
+    Cache(size_t max_size) : m_max_size(max_size) {}
+
+    struct Slot {
+      pjs::Ref<Entry> entry;
+      std::list<std::string>::iterator lru;
+      std::vector<pjs::Ref<Waiter>> waiters;
+      bool fetching = false;
+    };
+
+    std::unordered_map<std::string, Slot> m_slots;
+    std::list<std::string> m_lru;
+    size_t m_max_size;
+    size_t m_size = 0;
+    std::mutex m_mutex;
+
+    void remove(std::unordered_map<std::string, Slot>::iterator i);
+
+    static std::unordered_map<std::string, Cache*> s_caches;
+    static std::mutex s_caches_mutex;
+  };
+
+  //
+  // CacheHTTP::Revalidator
+  //
+
+  class Revalidator : public pjs::Pooled<Revalidator>, public EventTarget {
+  public:
+    Revalidator(CacheHTTP *filter);
+
+    void start(CacheHTTP *filter, Message *request);
+
+  private:
+    Cache* m_cache;
+    Options m_options;
+    std::string m_key;
+    pjs::Ref<http::RequestHead> m_request;
+    pjs::Ref<Pipeline> m_pipeline;
+    MessageReader m_reader;
+    Timer m_timer;
+    size_t m_size = 0;
+    bool m_done = false;
+
+    virtual void on_event(Event *evt) override;
+    void finish(bool failed = false);
+  };
+
+  enum State {
+    IDLE,
+    READING,
+    WAITING,
+    FETCHING,
+    BYPASS,
+    DONE,
+  };
+
+  Options m_options;
+  Cache* m_cache;
+  State m_state = IDLE;
+  MessageReader m_request_reader;
+  MessageReader m_response_reader;
+  EventBuffer m_buffer;
+  pjs::Ref<Message> m_request;
+  pjs::Ref<http::RequestHead> m_request_head;
+  pjs::Ref<Pipeline> m_pipeline;
+  pjs::Ref<Waiter> m_waiter;
+  std::string m_key;
+  Timer m_timer;
+  size_t m_response_size = 0;
+  bool m_is_leader = false;
+  bool m_is_storing = false;
+
+  bool lookup();
+  void fetch(bool store);
+  void wake(bool failed);
+  void serve(Entry *entry, double now);
+  void fail();
+  void respond(Message *response);
+  void leave(bool failed = false);
+  void schedule_timeout();
+  void on_timeout();
+
+  static auto lifetime(const Options &options, http::ResponseHead *head, double &stale_while_revalidate) -> double;
+  static bool keep_reading(const Options &options, Cache *cache, Event *evt, size_t &size);
+  static auto make_entry(
+    const Options &options,
+    http::RequestHead *request,
+    Message *response
+  ) -> Entry*;
+};
+
+} // namespace pipy
+
+#endif // CACHE_HPP
@@ -35,21 +35,43 @@ thread_local static const pjs::ConstStr s_content_encoding("content-encoding");
 thread_local static const pjs::ConstStr s_gzip("gzip");
 thread_local static const pjs::ConstStr s_deflate("deflate");
 thread_local static const pjs::ConstStr s_inflate("inflate");
+thread_local static const pjs::ConstStr s_zstd("zstd");
+thread_local static const pjs::ConstStr s_dcz("dcz");
 
 static Data::Producer s_dp("compressMessage()");
 
+//
+// Compress::Options
+//
+
+Compress::Options::Options(pjs::Object *options) {
+  pjs::Ref<Data> data;
+  pjs::Ref<pjs::Str> str;
+  Value(options, "dictionary")
+    .get(data)
+    .get(str)
+    .check_nullable();
+  if (data) {
+    dictionary = CompressionDictionary::make(*data);
+  } else if (str) {
+    dictionary = CompressionDictionary::make(Data(str->str(), &s_dp));
+  }
+}
+
 //
 // Compress
 //
 
-Compress::Compress(const pjs::Value &algorithm)
+Compress::Compress(const pjs::Value &algorithm, const Options &options)
   : m_algorithm(algorithm)
+  , m_options(options)
 {
 }
 
 Compress::Compress(const Compress &r)
   : Filter(r)
   , m_algorithm(r.m_algorithm)
+  , m_options(r.m_options)
 {
 }
 
@@ -87,9 +109,15 @@ void Compress::process(Event *evt) {
     auto out = [this](Data &data) { compressor_output(data); };
     auto str = algorithm.s();
     if (str == s_deflate) {
-      m_compressor = Compressor::deflate(out);
+      m_compressor = Compressor::deflate(out, m_options.dictionary);
     } else if (str == s_gzip) {
+      if (m_options.dictionary) {
+        Filter::error("dictionary is not supported by gzip");
+        return;
+      }
       m_compressor = Compressor::gzip(out);
+    } else if (str == s_zstd) {
+      m_compressor = Compressor::zstd(out, m_options.dictionary);
     } else {
       Filter::error("unknown compression algorithm: %s", str->c_str());
       return;
@@ -119,15 +147,16 @@ void Compress::compressor_output(Data &data) {
 // CompressHTTP
 //
 
-
-CompressHTTP::CompressHTTP(const pjs::Value &algorithm)
+CompressHTTP::CompressHTTP(const pjs::Value &algorithm, const Compress::Options &options)
   : m_algorithm(algorithm)
+  , m_options(options)
 {
 }
 
 CompressHTTP::CompressHTTP(const CompressHTTP &r)
   : Filter(r)
   , m_algorithm(r.m_algorithm)
+  , m_options(r.m_options)
 {
 }
 
@@ -193,6 +222,16 @@ void CompressHTTP::process(Event *evt) {
         } else if (algorithm == s_deflate) {
           m_compressor = Compressor::deflate(out);
           headers->set(s_content_encoding, s_deflate.get());
+        } else if (algorithm == s_zstd) {
+          m_compressor = Compressor::zstd(out);
+          headers->set(s_content_encoding, s_zstd.get());
+        } else if (algorithm == s_dcz) {
+          if (!m_options.dictionary) {
+            Filter::error("dcz requires a dictionary");
+            return;
+          }
+          m_compressor = Compressor::dcz(out, m_options.dictionary);
+          headers->set(s_content_encoding, s_dcz.get());
         }
       }
       m_is_message_started = true;
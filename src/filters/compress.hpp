@@ -27,10 +27,11 @@
 #define COMPRESS_HPP
 
 #include "filter.hpp"
+#include "compressor.hpp"
+#include "options.hpp"
 
 namespace pipy {
 
-class Compressor;
 class Data;
 
 //
@@ -39,7 +40,13 @@ class Data;
 
 class Compress : public Filter {
 public:
-  Compress(const pjs::Value &algorithm);
+  struct Options : public pipy::Options {
+    pjs::Ref<CompressionDictionary> dictionary;
+    Options() {}
+    Options(pjs::Object *options);
+  };
+
+  Compress(const pjs::Value &algorithm, const Options &options);
 
 private:
   Compress(const Compress &r);
@@ -51,6 +58,7 @@ private:
   virtual void dump(Dump &d) override;
 
   pjs::Value m_algorithm;
+  Options m_options;
   Compressor* m_compressor = nullptr;
   bool m_is_started = false;
 
@@ -63,7 +71,7 @@ private:
 
 class CompressHTTP : public Filter {
 public:
-  CompressHTTP(const pjs::Value &algorithm);
+  CompressHTTP(const pjs::Value &algorithm, const Compress::Options &options);
 
 private:
   CompressHTTP(const CompressHTTP &r);
@@ -75,6 +83,7 @@ private:
   virtual void dump(Dump &d) override;
 
   pjs::Value m_algorithm;
+  Compress::Options m_options;
   Compressor* m_compressor = nullptr;
   bool m_is_message_started = false;
 
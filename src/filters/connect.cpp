@@ -24,7 +24,9 @@
  */
 
 #include "connect.hpp"
+#include "inbound.hpp"
 #include "outbound.hpp"
+#include "context.hpp"
 #include "utils.hpp"
 
 namespace pipy {
@@ -77,6 +79,12 @@ Connect::Options::Options(pjs::Object *options) {
   Value(options, "noDelay")
     .get(no_delay)
     .check_nullable();
+  Value(options, "batchSize")
+    .get(batch_size)
+    .check_nullable();
+  Value(options, "splice")
+    .get(splice)
+    .check_nullable();
 }
 
 //
@@ -221,6 +229,14 @@ void Connect::process(Event *evt) {
         m_outbound->connect(target.s()->str());
       }
 
+      if (options.splice && Filter::spliceable()) {
+        if (auto *inbound = Filter::context()->inbound()) {
+          auto *a = inbound->get_tcp_socket();
+          auto *b = m_outbound->get_tcp_socket();
+          if (a && b) a->splice(b);
+        }
+      }
+
     } catch (std::runtime_error &e) {
       m_outbound = nullptr;
       Filter::error("%s", e.what());
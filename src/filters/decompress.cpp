@@ -36,19 +36,43 @@ thread_local static const pjs::ConstStr s_br("br");
 thread_local static const pjs::ConstStr s_deflate("deflate");
 thread_local static const pjs::ConstStr s_inflate("inflate");
 thread_local static const pjs::ConstStr s_brotli("brotli");
+thread_local static const pjs::ConstStr s_zstd("zstd");
+thread_local static const pjs::ConstStr s_dcz("dcz");
+
+static Data::Producer s_dp("decompress()");
+
+//
+// Decompress::Options
+//
+
+Decompress::Options::Options(pjs::Object *options) {
+  pjs::Ref<Data> data;
+  pjs::Ref<pjs::Str> str;
+  Value(options, "dictionary")
+    .get(data)
+    .get(str)
+    .check_nullable();
+  if (data) {
+    dictionary = CompressionDictionary::make(*data);
+  } else if (str) {
+    dictionary = CompressionDictionary::make(Data(str->str(), &s_dp));
+  }
+}
 
 //
 // Decompress
 //
 
-Decompress::Decompress(const pjs::Value &algorithm)
+Decompress::Decompress(const pjs::Value &algorithm, const Options &options)
   : m_algorithm(algorithm)
+  , m_options(options)
 {
 }
 
 Decompress::Decompress(const Decompress &r)
   : Filter(r)
   , m_algorithm(r.m_algorithm)
+  , m_options(r.m_options)
 {
 }
 
@@ -86,7 +110,12 @@ void Decompress::process(Event *evt) {
     auto out = [this](Data &data) { decompressor_output(data); };
     auto str = algorithm.s();
     if (str == s_inflate) {
-      m_decompressor = Decompressor::inflate(out);
+      m_decompressor = Decompressor::inflate(out, m_options.dictionary);
+    } else if (str == s_zstd) {
+      m_decompressor = Decompressor::zstd(out, m_options.dictionary);
+    } else if (m_options.dictionary) {
+      Filter::error("dictionary is not supported by %s", str->c_str());
+      return;
     } else if (str == s_gzip) {
       m_decompressor = Decompressor::gzip(out);
     } else if (str == s_brotli) {
@@ -119,12 +148,14 @@ void Decompress::decompressor_output(Data &data) {
 // DecompressHTTP
 //
 
-DecompressHTTP::DecompressHTTP()
+DecompressHTTP::DecompressHTTP(const Decompress::Options &options)
+  : m_options(options)
 {
 }
 
 DecompressHTTP::DecompressHTTP(const DecompressHTTP &r)
   : Filter(r)
+  , m_options(r.m_options)
 {
 }
 
@@ -160,8 +191,10 @@ void DecompressHTTP::process(Event *evt) {
           auto str = v.s();
           auto out = [this](Data &data) { decompressor_output(data); };
           if (str == s_gzip) m_decompressor = Decompressor::gzip(out);
-          if (str == s_deflate) m_decompressor = Decompressor::inflate(out);
+          else if (str == s_deflate) m_decompressor = Decompressor::inflate(out);
           else if (str == s_br) m_decompressor = Decompressor::brotli(out);
+          else if (str == s_zstd) m_decompressor = Decompressor::zstd(out);
+          else if (str == s_dcz && m_options.dictionary) m_decompressor = Decompressor::dcz(out, m_options.dictionary);
           if (m_decompressor) head->headers->ht_delete(s_content_encoding);
         }
       }
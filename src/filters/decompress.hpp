@@ -27,10 +27,11 @@
 #define DECOMPRESS_HPP
 
 #include "filter.hpp"
+#include "compressor.hpp"
+#include "options.hpp"
 
 namespace pipy {
 
-class Decompressor;
 class Data;
 
 //
@@ -39,7 +40,13 @@ class Data;
 
 class Decompress : public Filter {
 public:
-  Decompress(const pjs::Value &algorithm);
+  struct Options : public pipy::Options {
+    pjs::Ref<CompressionDictionary> dictionary;
+    Options() {}
+    Options(pjs::Object *options);
+  };
+
+  Decompress(const pjs::Value &algorithm, const Options &options);
 
 private:
   Decompress(const Decompress &r);
@@ -51,6 +58,7 @@ private:
   virtual void dump(Dump &d) override;
 
   pjs::Value m_algorithm;
+  Options m_options;
   Decompressor* m_decompressor = nullptr;
   bool m_is_started = false;
 
@@ -63,7 +71,7 @@ private:
 
 class DecompressHTTP : public Filter {
 public:
-  DecompressHTTP();
+  DecompressHTTP(const Decompress::Options &options);
 
 private:
   DecompressHTTP(const DecompressHTTP &r);
@@ -74,6 +82,7 @@ private:
   virtual void process(Event *evt) override;
   virtual void dump(Dump &d) override;
 
+  Decompress::Options m_options;
   Decompressor* m_decompressor = nullptr;
   bool m_is_message_started = false;
 
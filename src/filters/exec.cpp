@@ -34,6 +34,7 @@
 
 #ifndef _WIN32
 
+#include <signal.h>
 #include <unistd.h>
 #include <sys/wait.h>
 
@@ -247,6 +248,7 @@ bool Exec::exec_argv(const std::list<std::string> &args) {
     pid = forkpty(&master_fd, nullptr, &term, nullptr);
 
     if (pid == 0) {
+      signal(SIGPIPE, SIG_DFL);
       execvp(argv[0], argv);
       std::terminate();
     }
@@ -274,6 +276,7 @@ bool Exec::exec_argv(const std::list<std::string> &args) {
       dup2(in[0], 0);
       dup2(out[1], 1);
       dup2(err[1], 2);
+      signal(SIGPIPE, SIG_DFL);
       execvp(argv[0], argv);
       std::terminate();
     }
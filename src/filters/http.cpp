@@ -31,9 +31,11 @@
 #include "module.hpp"
 #include "inbound.hpp"
 #include "str-map.hpp"
+#include "simd.hpp"
 #include "utils.hpp"
 
 #include <cctype>
+#include <cstring>
 #include <queue>
 #include <limits>
 
@@ -101,6 +103,10 @@ thread_local static const StrMap s_strmap_headers({
   "content-length",
   "content-type",
   "transfer-encoding",
+  "keep-alive",
+  "upgrade",
+  "cookie",
+  "set-cookie",
 });
 
 thread_local static const StrMap s_strmap_header_values({
@@ -256,75 +262,195 @@ static auto lookup_status_text(int status) -> const char* {
   return nullptr;
 }
 
-static auto read_str(Data::Reader &dr, char ending, const StrMap &strmap) -> pjs::Str* {
-  size_t i = 0;
-  StrMap::Parser p(strmap);
-  pjs::Str *found = nullptr;
-  for (;;) {
-    auto c = dr.get();
-    if (c < 0) return nullptr;
-    if (c == ending) return found;
-    if (c == ' ' && !i) continue;
-    found = p.parse(c);
-    if (found == pjs::Str::empty) return nullptr;
-    i++;
-  }
-}
-
-static auto read_str(Data::Reader &dr, char ending, const StrMap &strmap, char *buf) -> pjs::Str* {
-  size_t i = 0;
-  StrMap::Parser p(strmap);
-  pjs::Str *found = nullptr;
-  for (;;) {
-    auto c = dr.get();
-    if (c < 0) return nullptr;
-    if (c == ending) {
-      if (found && found != pjs::Str::empty) {
-        return found;
-      } else {
-        return i > 0 ? pjs::Str::make(buf, i) : pjs::Str::empty.get();
-      }
-    }
-    if (c == ' ' && !i) continue;
-    found = p.parse(c);
-    buf[i++] = c;
-  }
-}
-
-static auto read_str_lower(Data::Reader &dr, char ending, const StrMap &strmap, char *buf, char *buf_lower) -> pjs::Str* {
-  size_t i = 0;
-  StrMap::Parser p(strmap);
-  pjs::Str *found = nullptr;
-  for (;;) {
-    auto c = dr.get();
-    if (c < 0) return nullptr;
-    if (c == ending) {
-      if (found && found != pjs::Str::empty) {
-        return found;
-      } else {
-        return i > 0 ? pjs::Str::make(buf_lower, i) : nullptr;
-      }
-    }
-    if (c == ' ' && !i) continue;
-    auto l = std::tolower(c);
-    found = p.parse(l);
-    buf_lower[i] = l;
-    buf[i++] = c;
-  }
+static auto read_field(const char *&p, const char *end, char ending, size_t &len) -> const char* {
+  auto s = p;
+  while (s < end && *s == ' ') s++;
+  auto n = simd::find(s, end - s, ending);
+  if (s + n >= end) return nullptr;
+  p = s + n + 1;
+  len = n;
+  return s;
+}
+
+static auto read_str(const char *&p, const char *end, char ending, const StrMap &strmap) -> pjs::Str* {
+  size_t len;
+  auto s = read_field(p, end, ending, len);
+  if (!s) return nullptr;
+  return strmap.find(s, len);
 }
 
-static auto read_uint(Data::Reader &dr, char ending) -> int {
+static auto read_str(const char *&p, const char *end, char ending, const StrMap &strmap, bool) -> pjs::Str* {
+  size_t len;
+  auto s = read_field(p, end, ending, len);
+  if (!s) return nullptr;
+  if (!len) return pjs::Str::empty;
+  if (auto str = strmap.find(s, len)) return str;
+  return pjs::Str::make(s, len);
+}
+
+static auto read_uint(const char *&p, const char *end, char ending) -> int {
+  size_t len;
+  auto s = read_field(p, end, ending, len);
+  if (!s) return -1;
   int n = 0;
-  for (;;) {
-    auto c = dr.get();
-    if (c < 0) return -1;
-    if (c == ending) return n;
+  for (size_t i = 0; i < len; i++) {
+    auto c = s[i];
     if ('0' <= c && c <= '9') {
       n = n * 10 + (c - '0');
     } else {
       return -1;
     }
   }
+  return n;
+}
+
+static auto head_line(const Data &data, char *buf) -> const char* {
+  auto chunks = data.chunks();
+  auto i = chunks.begin();
+  if (i != chunks.end()) {
+    auto chunk = *i;
+    if (++i == chunks.end()) return std::get<0>(chunk);
+  }
+  data.to_bytes((uint8_t *)buf);
+  return buf;
+}
+
+//
+// HeaderBlock
+//
+
+auto HeaderBlock::key(size_t i) -> pjs::Str* {
+  auto &f = m_fields[i];
+  if (!f.key) {
+    auto len = f.name_length;
+    pjs::vl_array<char> buf(len);
+    simd::to_lower(name(f), buf, len);
+    f.key = pjs::Str::make(buf, len);
+  }
+  return f.key;
+}
+
+auto HeaderBlock::value(size_t i) -> pjs::Str* {
+  auto &f = m_fields[i];
+  if (!f.value) {
+    auto s = value(f);
+    auto len = f.value_length;
+    if (!len) {
+      f.value = pjs::Str::empty;
+    } else if (auto str = s_strmap_header_values.find(s, len)) {
+      f.value = str;
+    } else {
+      f.value = pjs::Str::make(s, len);
+    }
+  }
+  return f.value;
+}
+
+auto HeaderBlock::original_name(size_t i) -> pjs::Str* {
+  const auto &f = m_fields[i];
+  return pjs::Str::make(name(f), f.name_length);
+}
+
+auto HeaderBlock::find(pjs::Str *key) const -> int {
+  auto len = key->size();
+  auto str = key->c_str();
+  for (int i = int(m_fields.size()) - 1; i >= 0; i--) {
+    const auto &f = m_fields[i];
+    if (f.key) {
+      if (f.key == key) return i;
+    } else if (f.name_length == len) {
+      auto s = name(f);
+      size_t j = 0;
+      while (j < len && std::tolower((unsigned char)s[j]) == str[j]) j++;
+      if (j == len) return i;
+    }
+  }
+  return -1;
+}
+
+void HeaderBlock::add(pjs::Str *key, const char *name, size_t name_len, const char *value, size_t value_len, bool lower_case) {
+  Field f;
+  f.key = key;
+  f.offset = m_raw.size();
+  f.name_length = name_len;
+  f.value_offset = f.offset + (value - name);
+  f.value_length = value_len;
+  f.lower_case = lower_case;
+  m_raw.append(name, value + value_len - name);
+  m_fields.push_back(std::move(f));
+}
+
+//
+// LazyHeaders
+//
+
+auto LazyHeaders::block_of(pjs::Object *headers, pjs::Object *names) -> HeaderBlock* {
+  if (!headers || !headers->is_lazy() || !headers->is<LazyHeaders>()) return nullptr;
+  if (!names || !names->is_lazy() || !names->is<LazyHeaders>()) return nullptr;
+  auto block = headers->as<LazyHeaders>()->m_block.get();
+  if (names->as<LazyHeaders>()->m_block != block) return nullptr;
+  return block;
+}
+
+bool LazyHeaders::lazy_get(pjs::Str *key, pjs::Value &val) {
+  if (m_is_names) {
+    for (int i = m_block->size() - 1; i >= 0; i--) {
+      if (m_block->field(i).lower_case) continue;
+      if (m_block->key(i) == key) {
+        val.set(m_block->original_name(i));
+        return true;
+      }
+    }
+    return false;
+  }
+
+  if (key == s_connection) return false;
+  auto i = m_block->find(key);
+  if (i < 0) return false;
+
+  // Repeated cookies become an array that must stay the same object
+  if (key == s_cookie || key == s_set_cookie) {
+    for (int j = 0; j < i; j++) {
+      if (m_block->key(j) == key) {
+        ht_materialize();
+        return ht_get(key, val);
+      }
+    }
+  }
+
+  val.set(m_block->value(i));
+  return true;
+}
+
+void LazyHeaders::lazy_materialize() {
+  for (size_t i = 0, n = m_block->size(); i < n; i++) {
+    auto &f = m_block->field(i);
+    if (m_is_names) {
+      if (!f.lower_case) {
+        pjs::Ref<pjs::Str> name(m_block->original_name(i));
+        ht_set(m_block->key(i), name.get());
+      }
+      continue;
+    }
+    auto key = m_block->key(i);
+    auto val = m_block->value(i);
+    if (key == s_connection) continue;
+    if (key == s_cookie || key == s_set_cookie) {
+      pjs::Value old;
+      ht_get(key, old);
+      if (old.is_array()) {
+        old.as<pjs::Array>()->push(val);
+        continue;
+      } else if (old.is_string()) {
+        auto a = pjs::Array::make(2);
+        a->set(0, old.s());
+        a->set(1, val);
+        ht_set(key, a);
+        continue;
+      }
+    }
+    ht_set(key, val);
+  }
 }
 
 //
@@ -373,25 +499,17 @@ void Decoder::on_event(Event *evt) {
       data->shift(n, output);
       if (0 == (m_current_size -= n)) state = (state == BODY ? HEAD : CHUNK_TAIL);
 
-    // byte scan the head
+    // vectorized scan for the end of a head line
+    } else if (state == HEAD || state == HEADER) {
+      if (data->shift_to('\n', output)) {
+        state = (state == HEAD ? HEAD_EOL : HEADER_EOL);
+      }
+
+    // byte scan the rest
     } else {
       data->shift_to(
         [&](int c) -> bool {
           switch (state) {
-          case HEAD:
-            if (c == '\n') {
-              state = HEAD_EOL;
-              return true;
-            }
-            return false;
-
-          case HEADER:
-            if (c == '\n') {
-              state = HEADER_EOL;
-              return true;
-            }
-            return false;
-
           case CHUNK_HEAD:
             m_body_size++;
             if (c == '\n') {
@@ -473,15 +591,16 @@ void Decoder::on_event(Event *evt) {
     // new state
     switch (state) {
       case HEAD_EOL: {
-        Data::Reader dr(m_head_buffer);
         auto len = m_head_buffer.size();
         pjs::vl_array<char, DATA_CHUNK_SIZE> buf(len);
+        auto p = head_line(m_head_buffer, buf);
+        auto end = p + len;
         m_head_size += len;
         if (m_is_response) {
           pjs::Ref<pjs::Str> protocol, status_text; int status;
-          protocol = read_str(dr, ' ', s_strmap_protocols); if (!protocol) { error(); break; }
-          status = read_uint(dr, ' '); if (status < 100 || status > 599) { error(); break; }
-          status_text = read_str(dr, '\r', s_strmap_statuses, buf); if (!status_text) { error(); break; }
+          protocol = read_str(p, end, ' ', s_strmap_protocols); if (!protocol) { error(); break; }
+          status = read_uint(p, end, ' '); if (status < 100 || status > 599) { error(); break; }
+          status_text = read_str(p, end, '\r', s_strmap_statuses, true); if (!status_text) { error(); break; }
           auto res = ResponseHead::make();
           res->protocol = protocol;
           res->status = status;
@@ -489,9 +608,9 @@ void Decoder::on_event(Event *evt) {
           m_head = res;
         } else {
           pjs::Ref<pjs::Str> method, path, protocol;
-          method = read_str(dr, ' ', s_strmap_methods); if (!method) { error(); break; }
-          path = read_str(dr, ' ', s_strmap_paths, buf); if (!path) { error(); break; }
-          protocol = read_str(dr, '\r', s_strmap_protocols); if (!protocol) { error(); break; }
+          method = read_str(p, end, ' ', s_strmap_methods); if (!method) { error(); break; }
+          path = read_str(p, end, ' ', s_strmap_paths, true); if (!path) { error(); break; }
+          protocol = read_str(p, end, '\r', s_strmap_protocols); if (!protocol) { error(); break; }
           if (
             (s_http2_preface_method == method) &&
             (s_http2_preface_path == path) &&
@@ -511,8 +630,9 @@ void Decoder::on_event(Event *evt) {
             m_head = req;
           }
         }
-        m_head->headers = pjs::Object::make();
-        m_head->headerNames = pjs::Object::make();
+        m_header_block = HeaderBlock::make();
+        m_head->headers = LazyHeaders::make(m_header_block, false);
+        m_head->headerNames = LazyHeaders::make(m_header_block, true);
         m_header_transfer_encoding = nullptr;
         m_header_content_length = nullptr;
         m_header_connection = nullptr;
@@ -523,41 +643,25 @@ void Decoder::on_event(Event *evt) {
       }
       case HEADER_EOL: {
         auto len = m_head_buffer.size();
-        pjs::vl_array<char, DATA_CHUNK_SIZE> buf(len);
-        pjs::vl_array<char, DATA_CHUNK_SIZE> buf_lower(len);
         m_head_size += len;
         if (len > 2) {
-          Data::Reader dr(m_head_buffer);
-          pjs::Ref<pjs::Str> key(read_str_lower(dr, ':', s_strmap_headers, buf, buf_lower));
-          pjs::Ref<pjs::Str> val(read_str(dr, '\r', s_strmap_header_values, buf_lower));
-          if (!key || !val) { error(); break; }
-          auto headers = m_head->headers.get();
-          if (key == s_cookie || key == s_set_cookie) {
-            pjs::Value old;
-            headers->get(key, old);
-            if (old.is_array()) {
-              old.as<pjs::Array>()->push(val.get());
-            } else if (old.is_string()) {
-              auto a = pjs::Array::make(2);
-              a->set(0, old.s());
-              a->set(1, val.get());
-              headers->set(key, a);
-            } else {
-              headers->set(key, val.get());
-            }
-          } else {
-            auto v = val.get();
-            if (key == s_transfer_encoding) m_header_transfer_encoding = v;
-            else if (key == s_content_length) m_header_content_length = v;
-            else if (key == s_connection) { m_header_connection = v; v = nullptr; }
-            else if (key == s_upgrade) m_header_upgrade = v;
-            if (v) headers->set(key, v);
-          }
-          if (auto names = m_head->headerNames.get()) {
-            pjs::Ref<pjs::Str> name(pjs::Str::make(buf, key->size()));
-            if (name != key) {
-              names->set(key, name.get());
-            }
+          pjs::vl_array<char, DATA_CHUNK_SIZE> buf(len);
+          pjs::vl_array<char, DATA_CHUNK_SIZE> buf_lower(len);
+          auto p = head_line(m_head_buffer, buf);
+          auto end = p + len;
+          size_t name_len, value_len;
+          auto name = read_field(p, end, ':', name_len);
+          auto value = name && name_len > 0 ? read_field(p, end, '\r', value_len) : nullptr;
+          if (!value) { error(); break; }
+          simd::to_lower(name, buf_lower, name_len);
+          auto key = s_strmap_headers.find(buf_lower, name_len);
+          m_header_block->add(key, name, name_len, value, value_len, !std::memcmp(name, buf_lower, name_len));
+          if (key) {
+            auto i = m_header_block->size() - 1;
+            if (key == s_transfer_encoding) m_header_transfer_encoding = m_header_block->value(i);
+            else if (key == s_content_length) m_header_content_length = m_header_block->value(i);
+            else if (key == s_connection) m_header_connection = m_header_block->value(i);
+            else if (key == s_upgrade) m_header_upgrade = m_header_block->value(i);
           }
           state = HEADER;
           m_head_buffer.clear();
@@ -828,7 +932,7 @@ void Encoder::output_head() {
 
     auto status = m_status_code;
     if (
-      (status < 200 || status == 204) ||
+      (status < 200 || status == 204 || status == 304) ||
       (m_responded_tunnel_type != TunnelType::NONE)
     ) {
       no_content_length = true;
@@ -843,7 +947,24 @@ void Encoder::output_head() {
     db.push("\r\n");
   }
 
-  if (auto headers = m_head->headers.get()) {
+  if (auto block = LazyHeaders::block_of(m_head->headers, m_head->headerNames)) {
+    for (size_t i = 0, n = block->size(); i < n; i++) {
+      const auto &f = block->field(i);
+      if (auto k = f.key.get()) {
+        if (k == s_keep_alive) continue;
+        if (k == s_transfer_encoding) continue;
+        if (k == s_connection) continue;
+        if (k == s_content_length) {
+          if (m_method == s_HEAD) no_content_length = true; else continue;
+        } else if (k == s_upgrade) {
+          m_header_upgrade = block->value(i);
+        }
+      }
+      db.push(block->name(f), f.value_offset - f.offset + f.value_length);
+      db.push("\r\n");
+    }
+
+  } else if (auto headers = m_head->headers.get()) {
     auto names = m_head->headerNames.get();
     headers->iterate_all(
       [&](pjs::Str *k, pjs::Value &v) {
@@ -1396,6 +1517,10 @@ auto Demux::on_encode_response(ResponseHead *head) -> RequestQueue::Request* {
   }
 }
 
+void Demux::on_demux_queue_dedicate(EventFunction *stream) {
+  static_cast<Pipeline*>(stream)->spliceable(Filter::spliceable());
+}
+
 bool Demux::on_decode_tunnel(TunnelType tt) {
   if (tt == TunnelType::HTTP2) {
     m_http2 = true;
@@ -1432,6 +1557,12 @@ Mux::Options::Options(pjs::Object *options)
   Value(options, "maxHeaderSize")
     .get_binary_size(max_header_size)
     .check_nullable();
+  Value(options, "maxPipeline")
+    .get(max_pipeline)
+    .check_nullable();
+  Value(options, "pipelineFallback")
+    .get_seconds(pipeline_fallback)
+    .check_nullable();
   Value(options, "version")
     .get(version)
     .get(version_s)
@@ -1448,12 +1579,14 @@ Mux::Options::Options(pjs::Object *options)
 
 Mux::Mux()
   : m_waiting_events(Filter::buffer_stats())
+  , m_pipeline_blacklist(new PipelineBlacklist)
 {
 }
 
 Mux::Mux(pjs::Function *session_selector)
   : MuxBase(session_selector)
   , m_waiting_events(Filter::buffer_stats())
+  , m_pipeline_blacklist(new PipelineBlacklist)
 {
 }
 
@@ -1461,12 +1594,14 @@ Mux::Mux(pjs::Function *session_selector, const Options &options)
   : MuxBase(session_selector)
   , m_options(options)
   , m_waiting_events(Filter::buffer_stats())
+  , m_pipeline_blacklist(new PipelineBlacklist)
 {
 }
 
 Mux::Mux(pjs::Function *session_selector, pjs::Function *options)
   : MuxBase(session_selector, options)
   , m_waiting_events(Filter::buffer_stats())
+  , m_pipeline_blacklist(new PipelineBlacklist)
 {
 }
 
@@ -1474,6 +1609,7 @@ Mux::Mux(const Mux &r)
   : MuxBase(r)
   , m_options(r.m_options)
   , m_waiting_events(r.m_waiting_events)
+  , m_pipeline_blacklist(r.m_pipeline_blacklist)
 {
 }
 
@@ -1495,13 +1631,13 @@ auto Mux::on_mux_new_pool(pjs::Object *options) -> MuxSessionPool* {
   if (options) {
     try {
       Options opts(options);
-      return new SessionPool(opts, Filter::buffer_stats());
+      return new SessionPool(opts, Filter::buffer_stats(), m_pipeline_blacklist);
     } catch (std::runtime_error &err) {
       Filter::error(err.what());
       return nullptr;
     }
   } else {
-    return new SessionPool(m_options, Filter::buffer_stats());
+    return new SessionPool(m_options, Filter::buffer_stats(), m_pipeline_blacklist);
   }
 }
 
@@ -1523,6 +1659,45 @@ auto Mux::verify_http_version(pjs::Str *name) -> int {
   return 0;
 }
 
+//
+// Mux::SessionPool
+//
+// When maxPipeline is set, upstreams found breaking pipelined requests are
+// remembered by session key and only get one request at a time on each
+// connection for the time given by pipelineFallback.
+//
+
+auto Mux::SessionPool::max_pipeline() -> int {
+  auto max = m_options.max_pipeline;
+  if (max <= 0) return max;
+  if (!m_pipelining_checked) {
+    auto &keys = m_pipeline_blacklist->keys;
+    auto i = keys.find(key());
+    if (i != keys.end()) m_pipelining_disabled_until = i->second;
+    m_pipelining_checked = true;
+  }
+  if (m_pipelining_disabled_until > 0) {
+    if (utils::now() < m_pipelining_disabled_until) return 1;
+    m_pipelining_disabled_until = 0;
+  }
+  return max;
+}
+
+void Mux::SessionPool::disable_pipelining() {
+  if (m_options.max_pipeline <= 0) return;
+  if (m_pipelining_disabled_until > 0) return;
+  auto now = utils::now();
+  m_pipelining_disabled_until = now + m_options.pipeline_fallback * 1000;
+  m_pipelining_checked = true;
+  if (!key().is_undefined()) {
+    auto &keys = m_pipeline_blacklist->keys;
+    for (auto i = keys.begin(); i != keys.end(); ) {
+      if (i->second <= now) i = keys.erase(i); else i++;
+    }
+    keys[key()] = m_pipelining_disabled_until;
+  }
+}
+
 //
 // Mux::Session
 //
@@ -1583,6 +1758,14 @@ void Mux::Session::mux_session_close() {
   }
 }
 
+auto Mux::Session::mux_session_max_queue() -> int {
+  if (m_http2) return 0;
+  if (auto p = MuxSession::pool()) {
+    return static_cast<SessionPool*>(p)->max_pipeline();
+  }
+  return 0;
+}
+
 void Mux::Session::on_encode_request(RequestQueue::Request *req) {
   m_request_queue.push(req);
 }
@@ -1604,11 +1787,16 @@ bool Mux::Session::on_decode_tunnel(TunnelType tt) {
 }
 
 void Mux::Session::on_decode_final() {
+  if (!m_request_queue.empty()) {
+    disable_pipelining();
+    MuxQueue::abort(StreamEnd::make(StreamEnd::CONNECTION_RESET));
+  }
   MuxSession::end(StreamEnd::make());
 }
 
-void Mux::Session::on_decode_error()
-{
+void Mux::Session::on_decode_error() {
+  auto r = m_request_queue.head();
+  if (r && r->next()) disable_pipelining();
 }
 
 void Mux::Session::on_ping(const Data &data) {
@@ -1619,6 +1807,8 @@ void Mux::Session::on_ping(const Data &data) {
 }
 
 void Mux::Session::on_queue_end(StreamEnd *eos) {
+  auto r = m_request_queue.head();
+  if (r && r->next()) disable_pipelining();
   MuxSession::end(eos);
 }
 
@@ -1700,6 +1890,12 @@ void Mux::Session::schedule_ping(Data *ack) {
   }
 }
 
+void Mux::Session::disable_pipelining() {
+  if (auto p = MuxSession::pool()) {
+    static_cast<SessionPool*>(p)->disable_pipelining();
+  }
+}
+
 //
 // Server
 //
@@ -1741,7 +1937,9 @@ void Server::on_demux_close_stream(EventFunction *stream) {
 
 void Server::on_demux_queue_dedicate(EventFunction *stream) {
   if (num_sub_pipelines() > 0) {
-    auto p = sub_pipeline(0, false, Filter::output())->start();
+    auto p = sub_pipeline(0, false, Filter::output());
+    p->spliceable(Filter::spliceable());
+    p->start();
     static_cast<Handler*>(stream)->tunnel(p);
   }
 }
@@ -1899,6 +2097,7 @@ void TunnelServer::start_tunnel(Message *response) {
   response->write(Filter::output());
 
   if (m_pipeline) {
+    m_pipeline->spliceable(Filter::spliceable());
     m_pipeline->start();
     m_buffer.flush(m_pipeline->input());
   }
@@ -2012,6 +2211,9 @@ namespace pjs {
 
 using namespace pipy::http;
 
+template<> void ClassDef<LazyHeaders>::init() {
+}
+
 template<> void ClassDef<Mux::Session::VersionSelector>::init() {
   method("select", [](Context &ctx, Object *obj, Value &) {
     Value version; ctx.get(0, version);
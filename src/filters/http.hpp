@@ -34,6 +34,8 @@
 #include "http2.hpp"
 #include "options.hpp"
 
+#include <unordered_map>
+
 namespace pipy {
 namespace http {
 
@@ -67,6 +69,71 @@ private:
   List<Request> m_queue;
 };
 
+//
+// HeaderBlock
+//
+
+class HeaderBlock : public pjs::Pooled<HeaderBlock>, public pjs::RefCount<HeaderBlock> {
+public:
+  struct Field {
+    pjs::Ref<pjs::Str> key;
+    pjs::Ref<pjs::Str> value;
+    uint32_t offset;
+    uint32_t name_length;
+    uint32_t value_offset;
+    uint32_t value_length;
+    bool lower_case;
+  };
+
+  static auto make() -> HeaderBlock* {
+    return new HeaderBlock();
+  }
+
+  auto size() const -> size_t { return m_fields.size(); }
+  auto field(size_t i) -> Field& { return m_fields[i]; }
+  auto name(const Field &f) const -> const char* { return m_raw.c_str() + f.offset; }
+  auto value(const Field &f) const -> const char* { return m_raw.c_str() + f.value_offset; }
+  auto key(size_t i) -> pjs::Str*;
+  auto value(size_t i) -> pjs::Str*;
+  auto original_name(size_t i) -> pjs::Str*;
+  auto find(pjs::Str *key) const -> int;
+
+  void add(pjs::Str *key, const char *name, size_t name_len, const char *value, size_t value_len, bool lower_case);
+
+private:
+  HeaderBlock() { m_fields.reserve(16); }
+
+  std::string m_raw;
+  std::vector<Field> m_fields;
+
+  friend class pjs::RefCount<HeaderBlock>;
+};
+
+//
+// LazyHeaders
+//
+
+class LazyHeaders : public pjs::ObjectTemplate<LazyHeaders> {
+public:
+  auto block() const -> HeaderBlock* { return m_block; }
+  bool is_names() const { return m_is_names; }
+
+  static auto block_of(pjs::Object *headers, pjs::Object *names) -> HeaderBlock*;
+
+private:
+  LazyHeaders(HeaderBlock *block, bool is_names)
+    : m_block(block)
+    , m_is_names(is_names) { set_lazy(); }
+
+  pjs::Ref<HeaderBlock> m_block;
+  bool m_is_names;
+
+  virtual bool lazy_get(pjs::Str *key, pjs::Value &val) override;
+  virtual void lazy_materialize() override;
+
+  friend class pjs::ObjectTemplate<LazyHeaders>;
+};
+
 //
 // Decoder
 //
@@ -107,6 +174,7 @@ private:
   Data m_head_buffer;
   size_t m_max_header_size = DATA_CHUNK_SIZE;
   pjs::Ref<MessageHead> m_head;
+  pjs::Ref<HeaderBlock> m_header_block;
   pjs::Ref<pjs::Str> m_method;
   pjs::Ref<pjs::Str> m_header_transfer_encoding;
   pjs::Ref<pjs::Str> m_header_content_length;
@@ -322,6 +390,7 @@ protected:
   virtual auto on_demux_open_stream() -> EventFunction* override;
   virtual void on_demux_close_stream(EventFunction *stream) override;
   virtual void on_demux_complete() override;
+  virtual void on_demux_queue_dedicate(EventFunction *stream) override;
 
   virtual void on_decode_error() override;
   virtual void on_decode_request(RequestQueue::Request *req) override;
@@ -342,6 +411,8 @@ public:
   {
     size_t buffer_size = DATA_CHUNK_SIZE;
     size_t max_header_size = DATA_CHUNK_SIZE;
+    int max_pipeline = 0;
+    double pipeline_fallback = 60;
     int version = 1;
     pjs::Ref<pjs::Str> version_s;
     pjs::Ref<pjs::Function> version_f;
@@ -393,6 +464,7 @@ public:
     virtual auto mux_session_open_stream(MuxSource *source) -> EventFunction* override;
     virtual void mux_session_close_stream(EventFunction *stream) override;
     virtual void mux_session_close() override;
+    virtual auto mux_session_max_queue() -> int override;
 
     virtual void on_encode_request(RequestQueue::Request *req) override;
     virtual auto on_decode_response(ResponseHead *head) -> RequestQueue::Request* override;
@@ -415,14 +487,24 @@ public:
     bool select_protocol(Mux *muxer);
     bool select_protocol(Mux *muxer, const pjs::Value &version);
     void schedule_ping(Data *ack = nullptr);
+    void disable_pipelining();
   };
 
 private:
   Mux(const Mux &r);
   ~Mux();
 
+  //
+  // Mux::PipelineBlacklist
+  //
+
+  struct PipelineBlacklist : public pjs::RefCount<PipelineBlacklist> {
+    std::unordered_map<pjs::Value, double> keys; // key -> expiration time
+  };
+
   Options m_options;
   EventBuffer m_waiting_events;
+  pjs::Ref<PipelineBlacklist> m_pipeline_blacklist;
 
   virtual auto clone() -> Filter* override;
   virtual void dump(Dump &d) override;
@@ -436,16 +518,23 @@ private:
   //
 
   struct SessionPool : public pjs::Pooled<SessionPool, MuxSessionPool> {
-    SessionPool(const Options &options, std::shared_ptr<BufferStats> buffer_stats)
+    SessionPool(const Options &options, std::shared_ptr<BufferStats> buffer_stats, PipelineBlacklist *blacklist)
       : pjs::Pooled<SessionPool, MuxSessionPool>(options)
       , m_options(options)
-      , m_buffer_stats(buffer_stats) {}
+      , m_buffer_stats(buffer_stats)
+      , m_pipeline_blacklist(blacklist) {}
 
     virtual auto session() -> MuxSession* override { return new Session(m_options, m_buffer_stats); }
     virtual void free() override { delete this; }
 
+    auto max_pipeline() -> int;
+    void disable_pipelining();
+
     Options m_options;
     std::shared_ptr<BufferStats> m_buffer_stats;
+    pjs::Ref<PipelineBlacklist> m_pipeline_blacklist;
+    double m_pipelining_disabled_until = 0;
+    bool m_pipelining_checked = false;
   };
 };
 
@@ -53,6 +53,15 @@ namespace http2 {
 
 static Data::Producer s_dp("HTTP/2");
 
+static const uint8_t s_bdp_ping[8] = { 'p', 'i', 'p', 'y', '-', 'b', 'd', 'p' };
+
+static bool is_bdp_ping(const Data &payload) {
+  uint8_t buf[sizeof(s_bdp_ping)];
+  if (payload.size() != sizeof(buf)) return false;
+  payload.to_bytes(buf, sizeof(buf));
+  return !std::memcmp(buf, s_bdp_ping, sizeof(buf));
+}
+
 //
 // HPACK static table
 //
@@ -85,6 +94,13 @@ thread_local static const pjs::ConstStr s_trailers("trailers");
 thread_local static const pjs::ConstStr s_content_length("content-length");
 thread_local static const pjs::ConstStr s_cookie("cookie");
 thread_local static const pjs::ConstStr s_set_cookie("set-cookie");
+thread_local static const pjs::ConstStr s_authorization("authorization");
+thread_local static const pjs::ConstStr s_proxy_authorization("proxy-authorization");
+thread_local static const pjs::ConstStr s_etag("etag");
+thread_local static const pjs::ConstStr s_age("age");
+thread_local static const pjs::ConstStr s_location("location");
+thread_local static const pjs::ConstStr s_if_modified_since("if-modified-since");
+thread_local static const pjs::ConstStr s_if_none_match("if-none-match");
 
 static struct {
   const char *name;
@@ -719,7 +735,7 @@ void DynamicTable::evict() {
 
 thread_local
 const HeaderDecoder::StaticTable HeaderDecoder::s_static_table;
-const HeaderDecoder::HuffmanTree HeaderDecoder::s_huffman_tree;
+const HeaderDecoder::HuffmanTable HeaderDecoder::s_huffman_table;
 
 HeaderDecoder::HeaderDecoder(const Settings &settings)
   : m_settings(settings)
@@ -853,35 +869,28 @@ bool HeaderDecoder::read_int(uint8_t c) {
 
 bool HeaderDecoder::read_str(uint8_t c, bool lowercase_only) {
   if (m_prefix & 0x80) {
-    const auto &tree = s_huffman_tree.get();
-    int last_bit = 8;
-    for (int b = 7; b >= 0; b--) {
-      bool bit = (c >> b) & 1;
-      m_ptr = bit ? tree[m_ptr].right : tree[m_ptr].left;
-      auto &node = tree[m_ptr];
-      if (!node.left) {
-        auto ch = node.right;
-        if (ch == 256) {
-          error(); // EOS is considered an error
-          return false;
-        }
-        if (lowercase_only) {
+    const auto &t = s_huffman_table.get(m_ptr, c);
+    if (t.flags & HuffmanTable::FAILED) {
+      error(); // EOS is considered an error
+      return false;
+    }
+    auto n = t.flags & HuffmanTable::SYMBOL_COUNT_MASK;
+    if (n > 0) {
+      if (lowercase_only) {
+        for (int i = 0; i < n; i++) {
+          auto ch = t.symbols[i];
           if (std::tolower(ch) != ch) {
             error(PROTOCOL_ERROR);
             return false;
           }
         }
-        s_dp.push(&m_buffer, char(ch));
-        m_ptr = 0;
-        last_bit = b;
       }
+      s_dp.push(&m_buffer, t.symbols, n);
     }
-    if (m_int == 1) {
-      uint8_t mask = uint8_t(1 << last_bit) - 1;
-      if (mask == 0xff || (c & mask) != mask) {
-        error();
-        return false;
-      }
+    m_ptr = t.state;
+    if (m_int == 1 && !(t.flags & HuffmanTable::ACCEPTED)) {
+      error(); // padding longer than 7 bits or not all ones
+      return false;
     }
   } else {
     if (lowercase_only) {
@@ -1096,26 +1105,71 @@ HeaderDecoder::StaticTable::StaticTable() {
 }
 
 //
-// HeaderDecoder::HuffmanTree
+// HeaderDecoder::HuffmanTable
 //
 
-HeaderDecoder::HuffmanTree::HuffmanTree() {
+HeaderDecoder::HuffmanTable::HuffmanTable() {
+  struct Node {
+    int children[2] = { -1, -1 };
+    int symbol = -1;
+    int state = -1;
+    bool accepted = false;
+  };
+
+  // Build the code tree first
+  std::vector<Node> tree(1);
   int n = sizeof(s_hpack_huffman_table) / sizeof(s_hpack_huffman_table[0]);
-  m_tree.resize(1);
   for (int i = 0; i < n; i++) {
     auto &p = s_hpack_huffman_table[i];
     int ptr = 0;
     for (int b = p.bits - 1; b >= 0; b--) {
-      bool bit = (p.code >> b) & 1;
-      auto &node = m_tree[ptr];
-      ptr = bit ? node.right : node.left;
-      if (!ptr) {
-        ptr = m_tree.size();
-        (bit ? node.right : node.left) = ptr;
-        m_tree.emplace_back();
+      int bit = (p.code >> b) & 1;
+      auto next = tree[ptr].children[bit];
+      if (next < 0) {
+        next = tree.size();
+        tree[ptr].children[bit] = next;
+        tree.emplace_back();
+      }
+      ptr = next;
+    }
+    tree[ptr].symbol = i;
+  }
+
+  // Number the internal nodes as states, marking the ones that
+  // can end a string: the root and up to 7 padding bits of all ones
+  std::vector<int> states;
+  for (int i = 0; i < int(tree.size()); i++) {
+    if (tree[i].symbol < 0) {
+      tree[i].state = states.size();
+      states.push_back(i);
+    }
+  }
+  for (int i = 0, ptr = 0; i <= 7 && ptr >= 0; i++) {
+    tree[ptr].accepted = true;
+    ptr = tree[ptr].children[1];
+  }
+
+  // Walk every octet from every state
+  for (int s = 0; s < int(states.size()) && s < STATE_COUNT; s++) {
+    for (int c = 0; c < 256; c++) {
+      auto &t = m_transitions[s][c];
+      int ptr = states[s];
+      int count = 0;
+      bool failed = false;
+      for (int b = 7; b >= 0; b--) {
+        ptr = tree[ptr].children[(c >> b) & 1];
+        auto sym = tree[ptr].symbol;
+        if (sym >= 0) {
+          if (sym == 256) failed = true;
+          else t.symbols[count++] = sym;
+          ptr = 0;
+        }
       }
+      t.state = tree[ptr].state;
+      t.flags = count;
+      if (tree[ptr].accepted) t.flags |= ACCEPTED;
+      if (failed) t.flags |= FAILED;
     }
-    m_tree[ptr].right = i;
   }
 }
 
@@ -1125,9 +1179,33 @@ HeaderDecoder::HuffmanTree::HuffmanTree() {
 
 thread_local HeaderEncoder::StaticTable HeaderEncoder::m_static_table;
 
+void HeaderEncoder::reset() {
+  m_dynamic_table.reset();
+  m_dynamic_table.resize(Settings::DEFAULT_HEADER_TABLE_SIZE);
+  m_has_table_size_update = false;
+}
+
+void HeaderEncoder::set_table_size(size_t size) {
+  size = std::min(size, size_t(Settings::DEFAULT_HEADER_TABLE_SIZE));
+  if (size == m_dynamic_table.capacity()) return;
+  if (!m_has_table_size_update || size < m_table_size_update) {
+    m_table_size_update = size;
+  }
+  m_has_table_size_update = true;
+  m_dynamic_table.resize(size);
+}
+
 void HeaderEncoder::encode(bool is_response, bool is_tail, pjs::Object *head, Data &data) {
   Data::Builder db(data, &s_dp);
   bool has_authority = false;
+
+  // Signal table size changes at the start of the next header block
+  if (m_has_table_size_update) {
+    auto size = m_dynamic_table.capacity();
+    if (m_table_size_update < size) encode_int(db, 0x20, 3, m_table_size_update);
+    encode_int(db, 0x20, 3, size);
+    m_has_table_size_update = false;
+  }
   if (!is_tail) {
     if (is_response) {
       pjs::Ref<http::ResponseHead> h = pjs::coerce<http::ResponseHead>(head);
@@ -1199,19 +1277,63 @@ void HeaderEncoder::encode(bool is_response, bool is_tail, pjs::Object *head, Da
 }
 
 void HeaderEncoder::encode_header_field(Data::Builder &db, pjs::Str *k, pjs::Str *v) {
+  static const int static_table_size = sizeof(s_hpack_static_table) / sizeof(s_hpack_static_table[0]);
+
+  int name_index = 0;
   if (const auto *ent = m_static_table.find(k)) {
     auto i = ent->values.find(v);
-    if (i == ent->values.end()) {
-      encode_int(db, 0x00, 4, ent->index);
-      encode_str(db, v, false);
-    } else {
+    if (i != ent->values.end()) {
       encode_int(db, 0x80, 1, i->second);
+      return;
     }
-  } else {
-    encode_int(db, 0x00, 4, 0);
-    encode_str(db, k, true);
+    name_index = ent->index;
+  }
+
+  // Credentials and short cookies are never indexed, not even by intermediaries
+  if (
+    k == s_authorization ||
+    k == s_proxy_authorization ||
+    (k == s_cookie && v->size() < 20)
+  ) {
+    encode_int(db, 0x10, 4, name_index);
+    if (!name_index) encode_str(db, k, true);
+    encode_str(db, v, false);
+    return;
+  }
+
+  int dynamic_name_index;
+  auto i = m_dynamic_table.find(k, v, dynamic_name_index);
+  if (i >= 0) {
+    encode_int(db, 0x80, 1, static_table_size + 1 + i);
+    return;
+  }
+  if (!name_index && dynamic_name_index >= 0) {
+    name_index = static_table_size + 1 + dynamic_name_index;
+  }
+
+  // Values that seldom repeat would only push useful entries out of the table
+  auto entry_size = 32 + k->size() + v->size();
+  if (
+    entry_size > m_dynamic_table.capacity() * 3 / 4 ||
+    k == s_colon_path ||
+    k == s_content_length ||
+    k == s_set_cookie ||
+    k == s_etag ||
+    k == s_age ||
+    k == s_location ||
+    k == s_if_modified_since ||
+    k == s_if_none_match
+  ) {
+    encode_int(db, 0x00, 4, name_index);
+    if (!name_index) encode_str(db, k, true);
     encode_str(db, v, false);
+    return;
   }
+
+  encode_int(db, 0x40, 2, name_index);
+  if (!name_index) encode_str(db, k, true);
+  encode_str(db, v, false);
+  m_dynamic_table.add(k, v);
 }
 
 void HeaderEncoder::encode_int(Data::Builder &db, uint8_t prefix, int prefix_len, uint32_t n) {
@@ -1221,28 +1343,111 @@ void HeaderEncoder::encode_int(Data::Builder &db, uint8_t prefix, int prefix_len
   } else {
     db.push(uint8_t(prefix | mask));
     n -= mask;
-    while (n) {
-      if (n >> 7) {
-        db.push(uint8_t(0x80 | (n & 0x7f)));
-      } else {
-        db.push(uint8_t(n & 0x7f));
-      }
+    while (n >> 7) {
+      db.push(uint8_t(0x80 | (n & 0x7f)));
       n >>= 7;
     }
+    db.push(uint8_t(n));
   }
 }
 
 void HeaderEncoder::encode_str(Data::Builder &db, pjs::Str *s, bool lowercase) {
-  encode_int(db, 0, 1, s->size());
-  if (lowercase) {
-    for (auto ch : s->str()) {
-      db.push(char(std::tolower(ch)));
+  auto str = s->c_str();
+  auto len = s->size();
+
+  size_t bits = 0;
+  for (size_t i = 0; i < len; i++) {
+    auto ch = uint8_t(str[i]);
+    if (lowercase) ch = std::tolower(ch);
+    bits += s_hpack_huffman_table[ch].bits;
+  }
+
+  // Use Huffman coding only when it is shorter
+  auto huffman_len = (bits + 7) / 8;
+  if (huffman_len < len) {
+    encode_int(db, 0x80, 1, huffman_len);
+    uint64_t buf = 0;
+    int buf_bits = 0;
+    for (size_t i = 0; i < len; i++) {
+      auto ch = uint8_t(str[i]);
+      if (lowercase) ch = std::tolower(ch);
+      const auto &code = s_hpack_huffman_table[ch];
+      buf = (buf << code.bits) | code.code;
+      buf_bits += code.bits;
+      while (buf_bits >= 8) {
+        buf_bits -= 8;
+        db.push(uint8_t(buf >> buf_bits));
+      }
+    }
+    if (buf_bits > 0) {
+      db.push(uint8_t((buf << (8 - buf_bits)) | (0xff >> buf_bits)));
     }
   } else {
-    db.push(s->str());
+    encode_int(db, 0, 1, len);
+    if (lowercase) {
+      for (size_t i = 0; i < len; i++) {
+        db.push(char(std::tolower(str[i])));
+      }
+    } else {
+      db.push(str, len);
+    }
   }
 }
 
+//
+// HeaderEncoder::DynamicTable
+//
+
+void HeaderEncoder::DynamicTable::reset() {
+  while (m_tail < m_head) evict_one();
+  m_names.clear();
+  m_fields.clear();
+  m_size = 0;
+  m_head = 0;
+  m_tail = 0;
+}
+
+auto HeaderEncoder::DynamicTable::find(pjs::Str *name, pjs::Str *value, int &name_index) const -> int {
+  auto i = m_names.find(name);
+  if (i == m_names.end()) {
+    name_index = -1;
+    return -1;
+  }
+  name_index = m_head - i->second;
+  auto j = m_fields.find(std::make_pair(name, value));
+  if (j == m_fields.end()) return -1;
+  return m_head - j->second;
+}
+
+void HeaderEncoder::DynamicTable::add(pjs::Str *name, pjs::Str *value) {
+  auto i = ++m_head;
+  if (i - m_tail >= MAX_ENTRY_COUNT) evict_one();
+  auto entry = m_entries[i % MAX_ENTRY_COUNT] = new TableEntry;
+  entry->name = name;
+  entry->value = value;
+  m_names[name] = i;
+  m_fields[std::make_pair(name, value)] = i;
+  m_size += 32 + name->size() + value->size();
+  evict();
+}
+
+void HeaderEncoder::DynamicTable::evict() {
+  while (m_size > m_capacity) evict_one();
+}
+
+void HeaderEncoder::DynamicTable::evict_one() {
+  auto i = ++m_tail;
+  auto entry = m_entries[i % MAX_ENTRY_COUNT];
+  auto name = entry->name.get();
+  auto value = entry->value.get();
+  auto n = m_names.find(name);
+  if (n != m_names.end() && n->second == i) m_names.erase(n);
+  auto f = m_fields.find(std::make_pair(name, value));
+  if (f != m_fields.end() && f->second == i) m_fields.erase(f);
+  m_size -= 32 + name->size() + value->size();
+  delete entry;
+}
+
 HeaderEncoder::StaticTable::StaticTable() {
   int n = sizeof(s_hpack_static_table) / sizeof(s_hpack_static_table[0]);
   for (int i = 0; i < n; i++) {
@@ -1277,6 +1482,17 @@ Endpoint::Options::Options(pjs::Object *options) {
   Value(options, "streamWindowSize")
     .get_binary_size(stream_window_size)
     .check_nullable();
+  Value(options, "maxConnectionWindowSize")
+    .get_binary_size(max_connection_window_size)
+    .check_nullable();
+  Value(options, "maxStreamWindowSize")
+    .get_binary_size(max_stream_window_size)
+    .check_nullable();
+  Value(options, "maxConcurrentStreams")
+    .get(max_concurrent_streams)
+    .check_nullable();
+  max_connection_window_size = std::min(std::max(max_connection_window_size, connection_window_size), size_t(0x7fffffff));
+  max_stream_window_size = std::min(std::max(max_stream_window_size, stream_window_size), size_t(0x7fffffff));
 }
 
 Endpoint::Endpoint(bool is_server_side, const Options &options)
@@ -1288,6 +1504,7 @@ Endpoint::Endpoint(bool is_server_side, const Options &options)
   init_metrics();
   m_settings.enable_push = false;
   m_settings.initial_window_size = options.stream_window_size;
+  m_settings.max_concurrent_streams = options.max_concurrent_streams;
   m_recv_window_max = options.connection_window_size;
   m_recv_window_low = m_recv_window_max / 2;
 }
@@ -1302,11 +1519,19 @@ void Endpoint::reset() {
   m_streams.clear();
   m_streams_pending.clear();
   m_header_decoder.reset();
+  m_header_encoder.reset();
   m_peer_settings = Settings();
   m_output_buffer.clear();
   m_last_received_stream_id = 0;
   m_send_window = INITIAL_SEND_WINDOW_SIZE;
   m_recv_window = INITIAL_RECV_WINDOW_SIZE;
+  m_settings.initial_window_size = m_options.stream_window_size;
+  m_recv_window_max = m_options.connection_window_size;
+  m_recv_window_low = m_recv_window_max / 2;
+  m_bdp_bytes = 0;
+  m_active_stream_count = 0;
+  m_pending_weight = 0;
+  m_bdp_ping_sent = false;
   m_has_sent_preface = false;
   m_has_shutdown = false;
   m_has_gone_away = false;
@@ -1314,6 +1539,7 @@ void Endpoint::reset() {
 
 void Endpoint::init_settings(const uint8_t *data, size_t size) {
   m_peer_settings.decode(data, size);
+  m_header_encoder.set_table_size(m_peer_settings.header_table_size);
 }
 
 void Endpoint::process_event(Event *evt) {
@@ -1461,6 +1687,7 @@ void Endpoint::on_deframe(Frame &frm) {
             auto err = m_peer_settings.decode(buf, len);
             if (err == NO_ERROR) {
               bool ok = true;
+              m_header_encoder.set_table_size(m_peer_settings.header_table_size);
               if (m_peer_settings.initial_window_size != old_initial_window_size) {
                 auto delta = m_peer_settings.initial_window_size - old_initial_window_size;
                 ok = for_each_stream(
@@ -1488,6 +1715,8 @@ void Endpoint::on_deframe(Frame &frm) {
         } else if (!frm.is_ACK()) {
           frm.flags |= Frame::BIT_ACK;
           frame(frm);
+        } else if (is_bdp_ping(frm.payload)) {
+          update_bdp();
         } else {
           on_ping(frm.payload);
         }
@@ -1507,12 +1736,7 @@ void Endpoint::on_deframe(Frame &frm) {
               connection_error(FLOW_CONTROL_ERROR);
             } else {
               m_send_window = n;
-              for_each_pending_stream(
-                [this](StreamBase *s) {
-                  s->update_connection_send_window();
-                  return m_send_window > 0;
-                }
-              );
+              schedule_pending_streams();
             }
           }
         } else {
@@ -1553,6 +1777,31 @@ bool Endpoint::for_each_pending_stream(const std::function<bool(StreamBase*)> &c
   return true;
 }
 
+void Endpoint::schedule_pending_streams() {
+  auto total_weight = m_pending_weight;
+
+  // Share the window by stream weight first, then hand out what is left
+  if (total_weight > 0) {
+    auto window = m_send_window;
+    for_each_pending_stream(
+      [&](StreamBase *s) {
+        auto quota = int(int64_t(window) * s->m_weight / total_weight);
+        s->update_connection_send_window(std::max(quota, int(MIN_SEND_QUOTA)));
+        return m_send_window > 0;
+      }
+    );
+  }
+
+  if (m_send_window > 0) {
+    for_each_pending_stream(
+      [this](StreamBase *s) {
+        s->update_connection_send_window();
+        return m_send_window > 0;
+      }
+    );
+  }
+}
+
 void Endpoint::send_window_updates() {
   if (m_has_gone_away) return;
 
@@ -1588,6 +1837,66 @@ void Endpoint::send_window_updates() {
   }
 }
 
+void Endpoint::estimate_bdp(int size) {
+  if (
+    m_recv_window_max >= m_options.max_connection_window_size &&
+    m_settings.initial_window_size >= m_options.max_stream_window_size
+  ) return;
+
+  // Count what arrives within one PING round trip
+  m_bdp_bytes += size;
+  if (!m_bdp_ping_sent) {
+    m_bdp_ping_sent = true;
+    Frame frm;
+    frm.stream_id = 0;
+    frm.type = Frame::PING;
+    frm.flags = 0;
+    frm.payload.push(s_bdp_ping, sizeof(s_bdp_ping), &s_dp);
+    frame(frm);
+  }
+}
+
+void Endpoint::update_bdp() {
+  auto bdp = m_bdp_bytes;
+  m_bdp_bytes = 0;
+  m_bdp_ping_sent = false;
+
+  // Grow the windows when a round trip carried most of them
+  auto target = int64_t(bdp) * 2;
+  if (bdp * 3 >= int64_t(m_recv_window_max) * 2) {
+    auto size = int(std::min(target, int64_t(m_options.max_connection_window_size)));
+    if (size > m_recv_window_max) {
+      m_recv_window_max = size;
+      m_recv_window_low = size / 2;
+      FlushTarget::need_flush();
+    }
+  }
+
+  auto old_size = m_settings.initial_window_size;
+  if (bdp * 3 >= int64_t(old_size) * 2) {
+    auto size = int(std::min(target, int64_t(m_options.max_stream_window_size)));
+    if (size > old_size) {
+      auto delta = size - old_size;
+      m_settings.initial_window_size = size;
+      for_each_stream(
+        [=](StreamBase *s) {
+          s->m_recv_window += delta;
+          s->m_recv_window_max += delta;
+          s->m_recv_window_low = s->m_recv_window_max / 2;
+          return true;
+        }
+      );
+      uint8_t buf[Settings::MAX_SIZE];
+      Frame frm;
+      frm.stream_id = 0;
+      frm.type = Frame::SETTINGS;
+      frm.flags = 0;
+      frm.payload.push(buf, m_settings.encode(buf), &s_dp);
+      frame(frm);
+    }
+  }
+}
+
 void Endpoint::frame(Frame &frm) {
   if (m_has_gone_away) return;
 
@@ -1793,6 +2102,7 @@ Endpoint::StreamBase::StreamBase(
 }
 
 Endpoint::StreamBase::~StreamBase() {
+  set_state(CLOSED);
   if (m_is_server_side) {
     s_server_stream_count--;
   } else {
@@ -1807,9 +2117,9 @@ void Endpoint::StreamBase::encoder_input(Event *evt) {
       m_header_encoder.encode(m_is_server_side, false, start->head(), buf);
       write_header_block(buf);
       if (m_state == IDLE) {
-        m_state = OPEN;
+        set_state(OPEN);
       } else if (m_state == RESERVED_LOCAL) {
-        m_state = HALF_CLOSED_REMOTE;
+        set_state(HALF_CLOSED_REMOTE);
       }
       if (m_is_server_side) {
         if (m_is_tunnel_requested) {
@@ -1842,7 +2152,11 @@ void Endpoint::StreamBase::encoder_input(Event *evt) {
     if (m_is_message_started && !data->empty()) {
       if (m_state == OPEN || m_state == HALF_CLOSED_REMOTE) {
         m_send_buffer.push(*data);
-        pump();
+
+        // Join the pending streams so that new data gets a weighted
+        // share of the connection window like everyone else
+        set_pending(true);
+        m_endpoint->schedule_pending_streams();
         set_pending(true);
         flush();
       }
@@ -1857,14 +2171,12 @@ void Endpoint::StreamBase::encoder_input(Event *evt) {
           } else {
             if (m_is_tunnel_requested) return;
           }
-          if (auto tail = end->tail()) {
-            m_header_encoder.encode(m_is_server_side, true, tail, m_tail_buffer);
-          }
+          m_tail = end->tail();
         }
         if (m_state == OPEN) {
-          m_state = HALF_CLOSED_LOCAL;
+          set_state(HALF_CLOSED_LOCAL);
         } else if (m_state == HALF_CLOSED_REMOTE) {
-          m_state = CLOSED;
+          set_state(CLOSED);
         }
         m_is_message_ended = true;
         m_end_stream_send = true;
@@ -1873,9 +2185,9 @@ void Endpoint::StreamBase::encoder_input(Event *evt) {
     } else if (evt->is<StreamEnd>()) { // EOS without message start
       if (m_is_server_side) {
         if (m_state == OPEN) {
-          m_state = HALF_CLOSED_LOCAL;
+          set_state(HALF_CLOSED_LOCAL);
         } else if (m_state == HALF_CLOSED_REMOTE) {
-          m_state = CLOSED;
+          set_state(CLOSED);
         }
         m_end_stream_send = true;
         pjs::Ref<http::ResponseHead> head = http::ResponseHead::make();
@@ -1917,10 +2229,10 @@ void Endpoint::StreamBase::on_frame(Frame &frm) {
         if (frm.is_END_STREAM()) {
           set_clearing(false);
           if (m_state == OPEN) {
-            m_state = HALF_CLOSED_REMOTE;
+            set_state(HALF_CLOSED_REMOTE);
             if (check_content_length()) stream_end(nullptr);
           } else if (m_state == HALF_CLOSED_LOCAL) {
-            m_state = CLOSED;
+            set_state(CLOSED);
             if (check_content_length()) stream_end(nullptr);
           }
         }
@@ -1961,7 +2273,7 @@ void Endpoint::StreamBase::on_frame(Frame &frm) {
       } else if (frm.payload.size() != 4) {
         connection_error(FRAME_SIZE_ERROR);
       } else {
-        m_state = CLOSED;
+        set_state(CLOSED);
         stream_end(nullptr);
       }
       break;
@@ -1980,7 +2292,7 @@ void Endpoint::StreamBase::on_frame(Frame &frm) {
       auto inc = 0;
       auto err = frm.decode_window_update(inc);
       if (err == NO_ERROR) {
-        update_send_window(inc);
+        update_send_window(inc, true);
       } else {
         connection_error(err);
       }
@@ -2024,6 +2336,9 @@ bool Endpoint::StreamBase::parse_priority(Frame &frm) {
     connection_error(PROTOCOL_ERROR);
     return false;
   }
+  auto weight = int(buf[4]) + 1;
+  if (m_is_pending) m_endpoint->m_pending_weight += weight - m_weight;
+  m_weight = weight;
   return true;
 }
 
@@ -2043,9 +2358,9 @@ void Endpoint::StreamBase::parse_headers(Frame &frm) {
     }
 
     if (m_state == IDLE) {
-      m_state = OPEN;
+      set_state(OPEN);
     } else if (m_state == RESERVED_REMOTE) {
-      m_state = HALF_CLOSED_LOCAL;
+      set_state(HALF_CLOSED_LOCAL);
     }
 
     http::MessageTail *tail = nullptr;
@@ -2055,6 +2370,11 @@ void Endpoint::StreamBase::parse_headers(Frame &frm) {
       tail->headers = head->headers;
 
     } else {
+      auto max = m_endpoint->m_settings.max_concurrent_streams;
+      if (m_is_server_side && max >= 0 && m_endpoint->active_stream_count() > max) {
+        stream_error(REFUSED_STREAM);
+        return;
+      }
       m_end_headers = true;
       decoder_output(MessageStart::make(head));
     }
@@ -2074,10 +2394,10 @@ void Endpoint::StreamBase::parse_headers(Frame &frm) {
 
     if (m_end_stream_recv) {
       if (m_state == OPEN) {
-        m_state = HALF_CLOSED_REMOTE;
+        set_state(HALF_CLOSED_REMOTE);
         if (check_content_length()) stream_end(tail);
       } else if (m_state == HALF_CLOSED_LOCAL) {
-        m_state = CLOSED;
+        set_state(CLOSED);
         if (check_content_length()) stream_end(tail);
       }
     }
@@ -2105,6 +2425,7 @@ bool Endpoint::StreamBase::deduct_recv(int size) {
   }
   connection_recv_window -= size;
   m_recv_window -= size;
+  m_endpoint->estimate_bdp(size);
   if (m_recv_window <= m_recv_window_low) set_clearing(true);
   if (m_is_clearing || connection_recv_window <= m_endpoint->m_recv_window_low) flush();
   return true;
@@ -2119,7 +2440,7 @@ auto Endpoint::StreamBase::deduct_send(int size) -> int {
   return size;
 }
 
-bool Endpoint::StreamBase::update_send_window(int delta) {
+bool Endpoint::StreamBase::update_send_window(int delta, bool reschedule) {
   if (!delta) {
     stream_error(PROTOCOL_ERROR);
     return false;
@@ -2132,13 +2453,21 @@ bool Endpoint::StreamBase::update_send_window(int delta) {
     }
   }
   m_send_window += delta;
+
+  // A stream that becomes writable competes for the connection
+  // window with the other pending streams by weight
+  if (reschedule && m_is_pending) {
+    m_endpoint->schedule_pending_streams();
+    return true;
+  }
+
   pump();
   recycle();
   return true;
 }
 
-void Endpoint::StreamBase::update_connection_send_window() {
-  pump();
+void Endpoint::StreamBase::update_connection_send_window(int quota) {
+  pump(quota);
   recycle();
 }
 
@@ -2166,16 +2495,28 @@ void Endpoint::StreamBase::stream_end(http::MessageTail *tail) {
   }
 }
 
+void Endpoint::StreamBase::set_state(State state) {
+  auto is_active = [](State s) {
+    return s == OPEN || s == HALF_CLOSED_LOCAL || s == HALF_CLOSED_REMOTE;
+  };
+  if (is_active(state) != is_active(m_state)) {
+    m_endpoint->m_active_stream_count += is_active(state) ? 1 : -1;
+  }
+  m_state = state;
+}
+
 void Endpoint::StreamBase::set_pending(bool pending) {
   if (pending != m_is_pending) {
     if (pending) {
       if (m_endpoint->m_has_gone_away) return;
       m_endpoint->m_streams.remove(this);
       m_endpoint->m_streams_pending.push(this);
+      m_endpoint->m_pending_weight += m_weight;
     } else {
       if (m_is_clearing) return;
       m_endpoint->m_streams_pending.remove(this);
       m_endpoint->m_streams.push(this);
+      m_endpoint->m_pending_weight -= m_weight;
       m_is_clearing = false;
     }
     m_is_pending = pending;
@@ -2192,6 +2533,7 @@ void Endpoint::StreamBase::set_clearing(bool clearing) {
       } else {
         m_endpoint->m_streams.remove(this);
         m_endpoint->m_streams_pending.unshift(this);
+        m_endpoint->m_pending_weight += m_weight;
         m_is_pending = true;
       }
     } else {
@@ -2199,6 +2541,7 @@ void Endpoint::StreamBase::set_clearing(bool clearing) {
         m_endpoint->m_streams_pending.remove(this);
         if (m_send_buffer.empty()) {
           m_endpoint->m_streams.push(this);
+          m_endpoint->m_pending_weight -= m_weight;
           m_is_pending = false;
         } else {
           m_endpoint->m_streams_pending.push(this);
@@ -2209,10 +2552,11 @@ void Endpoint::StreamBase::set_clearing(bool clearing) {
   }
 }
 
-void Endpoint::StreamBase::pump() {
-  bool is_empty_end = (m_end_stream_send && m_send_buffer.empty() && m_tail_buffer.empty());
+void Endpoint::StreamBase::pump(int quota) {
+  bool is_empty_end = (m_end_stream_send && m_send_buffer.empty() && !m_tail);
   int size = m_send_buffer.size();
   if (size > m_send_window) size = m_send_window;
+  if (size > quota) size = quota;
   if (size > 0) size = deduct_send(size);
   if (size > 0 || is_empty_end) {
     auto remain = size;
@@ -2223,7 +2567,7 @@ void Endpoint::StreamBase::pump() {
       frm.stream_id = m_id;
       frm.type = Frame::DATA;
       if (n > 0) m_send_buffer.shift(n, frm.payload);
-      if (m_end_stream_send && m_send_buffer.empty() && m_tail_buffer.empty()) {
+      if (m_end_stream_send && m_send_buffer.empty() && !m_tail) {
         frm.flags = Frame::BIT_END_STREAM;
         m_end_stream_send = false;
       } else {
@@ -2234,7 +2578,20 @@ void Endpoint::StreamBase::pump() {
     m_send_window -= size;
   }
   if (m_send_buffer.empty()) {
-    if (!m_tail_buffer.empty()) write_header_block(m_tail_buffer);
+
+    // Trailers are encoded only when they are written out, since
+    // the dynamic table requires header blocks to go out in order
+    if (auto tail = m_tail.get()) {
+      Data buf;
+      m_header_encoder.encode(m_is_server_side, true, tail, buf);
+      m_tail = nullptr;
+      if (buf.empty()) {
+        pump();
+        return;
+      }
+      write_header_block(buf);
+      m_end_stream_send = false;
+    }
     set_pending(false);
   } else {
     set_pending(true);
@@ -239,14 +239,6 @@ private:
     VALUE_STRING,
   };
 
-  struct Huffman {
-    uint16_t left = 0;
-    union {
-      uint16_t right = 0;
-      uint16_t code;
-    };
-  };
-
   const Settings& m_settings;
   State m_state;
   ErrorCode m_error;
@@ -291,20 +283,41 @@ private:
   };
 
   //
-  // HeaderDecoder::HuffmanTree
+  // HeaderDecoder::HuffmanTable
+  //
+  // A finite-state decoder that consumes one octet per step. States are
+  // the internal nodes of the Huffman tree, and each step emits up to
+  // two symbols since no code is shorter than 5 bits.
   //
 
-  class HuffmanTree {
+  class HuffmanTable {
   public:
-    HuffmanTree();
-    auto get() const -> const std::vector<Huffman>& { return m_tree; }
+    enum {
+      STATE_COUNT = 256,
+      SYMBOL_COUNT_MASK = 0x03,
+      ACCEPTED = 0x04,
+      FAILED = 0x08,
+    };
+
+    struct Transition {
+      uint8_t state;
+      uint8_t flags;
+      uint8_t symbols[2];
+    };
+
+    HuffmanTable();
+
+    auto get(int state, uint8_t c) const -> const Transition& {
+      return m_transitions[state][c];
+    }
+
   private:
-    std::vector<Huffman> m_tree;
+    Transition m_transitions[STATE_COUNT][256];
   };
 
   thread_local
   static const StaticTable s_static_table;
-  static const HuffmanTree s_huffman_tree;
+  static const HuffmanTable s_huffman_table;
 };
 
 //
@@ -313,6 +326,9 @@ private:
 
 class HeaderEncoder {
 public:
+  void reset();
+  void set_table_size(size_t size);
+
   void encode(
     bool is_response,
     bool is_tail,
@@ -335,6 +351,35 @@ private:
     std::map<pjs::Ref<pjs::Str>, int> values;
   };
 
+  //
+  // HeaderEncoder::DynamicTable
+  //
+
+  class DynamicTable {
+  public:
+    ~DynamicTable() { reset(); }
+
+    void reset();
+    auto capacity() const -> size_t { return m_capacity; }
+    void resize(size_t size) { m_capacity = size; evict(); }
+    auto find(pjs::Str *name, pjs::Str *value, int &name_index) const -> int;
+    void add(pjs::Str *name, pjs::Str *value);
+
+  private:
+    enum { MAX_ENTRY_COUNT = 128 };
+
+    TableEntry* m_entries[MAX_ENTRY_COUNT];
+    std::map<pjs::Str*, size_t> m_names;
+    std::map<std::pair<pjs::Str*, pjs::Str*>, size_t> m_fields;
+    size_t m_capacity = Settings::DEFAULT_HEADER_TABLE_SIZE;
+    size_t m_size = 0;
+    size_t m_head = 0;
+    size_t m_tail = 0;
+
+    void evict();
+    void evict_one();
+  };
+
   //
   // HeaderEncoder::StaticTable
   //
@@ -347,6 +392,10 @@ private:
     std::map<pjs::Ref<pjs::Str>, Entry> m_table;
   };
 
+  DynamicTable m_dynamic_table;
+  size_t m_table_size_update = 0;
+  bool m_has_table_size_update = false;
+
   thread_local static StaticTable m_static_table;
 };
 
@@ -363,6 +412,9 @@ public:
   struct Options : public pipy::Options {
     size_t connection_window_size = 0x100000;
     size_t stream_window_size = 0x100000;
+    size_t max_connection_window_size = 0x1000000;
+    size_t max_stream_window_size = 0x1000000;
+    int max_concurrent_streams = -1;
     Options() {}
     Options(pjs::Object *options);
   };
@@ -393,6 +445,7 @@ private:
   enum {
     INITIAL_SEND_WINDOW_SIZE = 0xffff,
     INITIAL_RECV_WINDOW_SIZE = 0xffff,
+    MIN_SEND_QUOTA = 0x400,
   };
 
   uint32_t m_id;
@@ -410,6 +463,10 @@ private:
   int m_recv_window = INITIAL_RECV_WINDOW_SIZE;
   int m_recv_window_max;
   int m_recv_window_low;
+  int m_bdp_bytes = 0;
+  int m_active_stream_count = 0;
+  int m_pending_weight = 0;
+  bool m_bdp_ping_sent = false;
   bool m_is_server_side;
   bool m_has_sent_preface = false;
   bool m_has_shutdown = false;
@@ -429,7 +486,11 @@ private:
 
   bool for_each_stream(const std::function<bool(StreamBase*)> &cb);
   bool for_each_pending_stream(const std::function<bool(StreamBase*)> &cb);
+  auto active_stream_count() const -> int { return m_active_stream_count; }
+  void schedule_pending_streams();
   void send_window_updates();
+  void estimate_bdp(int size);
+  void update_bdp();
   void frame(Frame &frm);
   void flush();
   void end(StreamEnd *eos);
@@ -485,8 +546,8 @@ protected:
     bool check_content_length();
     bool deduct_recv(int size);
     auto deduct_send(int size) -> int;
-    bool update_send_window(int delta);
-    void update_connection_send_window();
+    bool update_send_window(int delta, bool reschedule = false);
+    void update_connection_send_window(int quota = 0x7fffffff);
     void write_header_block(Data &data);
     void stream_end(http::MessageTail *tail);
 
@@ -496,9 +557,10 @@ protected:
     void stream_error(ErrorCode err) { m_endpoint->stream_error(m_id, err); }
     void connection_error(ErrorCode err) { m_endpoint->connection_error(err); }
   
+    void set_state(State state);
     void set_pending(bool pending);
     void set_clearing(bool clearing);
-    void pump();
+    void pump(int quota = 0x7fffffff);
     void recycle();
 
     Endpoint* m_endpoint;
@@ -519,12 +581,13 @@ protected:
     HeaderDecoder& m_header_decoder;
     HeaderEncoder& m_header_encoder;
     Data m_send_buffer;
-    Data m_tail_buffer;
+    pjs::Ref<pjs::Object> m_tail;
     int m_send_window = INITIAL_SEND_WINDOW_SIZE;
     int m_recv_window;
     int m_recv_window_max;
     int m_recv_window_low;
     int m_recv_payload_size = 0;
+    int m_weight = 16;
     const Settings& m_peer_settings;
 
     friend class Endpoint;
@@ -182,7 +182,9 @@ auto MuxSessionPool::alloc() -> MuxSession* {
   auto max_message_count = m_max_messages;
   auto *s = m_sessions.head();
   while (s) {
+    auto max_queue = s->mux_session_max_queue();
     if ((max_share_count <= 0 || s->m_share_count < max_share_count) &&
+        (max_queue <= 0 || s->m_share_count < max_queue) &&
         (max_message_count <= 0 || s->m_message_count < max_message_count)
       ) {
       s->m_share_count++;
@@ -524,6 +526,14 @@ void MuxQueue::dedicate() {
   }
 }
 
+void MuxQueue::abort(StreamEnd *eos) {
+  while (auto r = m_receivers.head()) {
+    m_receivers.remove(r);
+    r->stream()->output(eos->clone());
+    delete r;
+  }
+}
+
 auto MuxQueue::stream(MuxSource *source) -> EventFunction* {
   auto s = new Stream(this, source);
   s->retain();
@@ -71,6 +71,7 @@ public:
   virtual auto mux_session_open_stream(MuxSource *source) -> EventFunction* = 0;
   virtual void mux_session_close_stream(EventFunction *stream) = 0;
   virtual void mux_session_close() = 0;
+  virtual auto mux_session_max_queue() -> int { return 0; }
 
 protected:
   auto pool() const -> MuxSessionPool* { return m_pool; }
@@ -117,6 +118,8 @@ class MuxSessionPool :
 protected:
   MuxSessionPool(const MuxSession::Options &options);
 
+  auto key() const -> const pjs::Value& { return m_key; }
+
   virtual auto session() -> MuxSession* = 0;
   virtual void free() = 0;
 
@@ -222,6 +225,7 @@ protected:
   void close(EventFunction *stream);
   void increase_output_count(int n);
   void dedicate();
+  void abort(StreamEnd *eos);
 
   virtual auto on_queue_message(MuxSource *source, MessageStart *msg) -> int { return 1; }
   virtual void on_queue_end(StreamEnd *eos) {}
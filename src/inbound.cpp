@@ -120,6 +120,7 @@ void Inbound::start() {
     auto ctx = layout->new_context();
     ctx->m_inbound = this;
     auto p = Pipeline::make(layout, ctx);
+    p->spliceable(get_tcp_socket() != nullptr);
     m_pipeline = p;
 
     p->chain(EventTarget::input());
@@ -282,6 +283,35 @@ void InboundTCP::accept(asio::ip::tcp::acceptor &acceptor) {
   retain();
 }
 
+#ifdef PIPY_USE_IO_URING
+
+void InboundTCP::accept(const asio::ip::tcp &protocol, int fd) {
+  InputContext ic(this);
+  retain();
+
+  std::error_code ec;
+  auto &s = SocketTCP::socket();
+  s.assign(protocol, fd, ec);
+  if (ec) {
+    ::close(fd);
+  } else {
+    m_peer = s.remote_endpoint(ec);
+  }
+
+  if (ec == asio::error::not_connected) {
+    log_debug("connection reset before accepted");
+  } else if (ec) {
+    log_error("error accepting connection", ec);
+  } else if (m_listener && m_listener->pipeline_layout()) {
+    log_debug("connection accepted");
+    start();
+  }
+
+  release();
+}
+
+#endif // PIPY_USE_IO_URING
+
 auto InboundTCP::get_socket() -> Socket* {
   if (!m_socket) {
     m_socket = Socket::make(SocketTCP::socket().native_handle());
@@ -71,6 +71,7 @@ public:
   bool is_receiving() const { return m_receiving_state == RECEIVING; }
 
   virtual auto get_socket() -> Socket* = 0;
+  virtual auto get_tcp_socket() -> SocketTCP* { return nullptr; }
   virtual auto get_buffered() const -> size_t = 0;
   virtual auto get_traffic_in() ->size_t = 0;
   virtual auto get_traffic_out() ->size_t = 0;
@@ -139,6 +140,9 @@ class InboundTCP :
 {
 public:
   void accept(asio::ip::tcp::acceptor &acceptor);
+#ifdef PIPY_USE_IO_URING
+  void accept(const asio::ip::tcp &protocol, int fd);
+#endif
   void cancel() { m_canceled = true; }
 
 private:
@@ -150,6 +154,7 @@ private:
   bool m_canceled = false;
 
   virtual auto get_socket() -> Socket* override;
+  virtual auto get_tcp_socket() -> SocketTCP* override { return this; }
   virtual auto get_buffered() const -> size_t override { return SocketTCP::buffered(); }
   virtual auto get_traffic_in() -> size_t override;
   virtual auto get_traffic_out() -> size_t override;
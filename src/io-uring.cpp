@@ -0,0 +1,397 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef PIPY_USE_IO_URING
+
+#include "io-uring.hpp"
+#include "log.hpp"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+namespace pipy {
+
+static const unsigned SQ_ENTRIES = 256;
+static const unsigned CQ_ENTRIES = 4096;
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+  return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+//
+// IOUring::Request
+//
+
+IOUring::Request::~Request() {
+  if (m_deferred != NONE) m_ring->m_deferred.remove(this);
+}
+
+//
+// IOUring
+//
+
+bool IOUring::s_enabled = false;
+thread_local std::unique_ptr<IOUring> IOUring::s_current;
+thread_local bool IOUring::s_current_failed = false;
+
+auto IOUring::current() -> IOUring* {
+  if (!s_enabled) return nullptr;
+  if (auto *ring = s_current.get()) return ring;
+  if (s_current_failed) return nullptr;
+  std::unique_ptr<IOUring> ring(new IOUring);
+  if (!ring->init()) {
+    s_current_failed = true;
+    Log::error("[io_uring] Cannot set up ring: %s, falling back to the default reactor", strerror(errno));
+    return nullptr;
+  }
+  s_current = std::move(ring);
+  return s_current.get();
+}
+
+auto IOUring::error_code(int result) -> std::error_code {
+  if (result >= 0) return std::error_code();
+  return std::error_code(-result, asio::error::get_system_category());
+}
+
+IOUring::IOUring()
+  : m_event(Net::context())
+{
+}
+
+IOUring::~IOUring() {
+  std::error_code ec;
+  m_event.close(ec);
+  if (m_sqes) munmap(m_sqes, m_sqes_size);
+  if (m_cq_ring && m_cq_ring != m_sq_ring) munmap(m_cq_ring, m_cq_ring_size);
+  if (m_sq_ring) munmap(m_sq_ring, m_sq_ring_size);
+  if (m_fd >= 0) close(m_fd);
+}
+
+bool IOUring::init() {
+  struct io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = CQ_ENTRIES;
+
+  m_fd = io_uring_setup(SQ_ENTRIES, &params);
+  if (m_fd < 0) return false;
+
+  if (!(params.features & IORING_FEAT_NODROP) || !(params.features & IORING_FEAT_SUBMIT_STABLE)) {
+    errno = ENOTSUP;
+    return false;
+  }
+
+  m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  m_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP);
+  if (single_mmap) {
+    m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+  }
+
+  auto sq = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) return false;
+  m_sq_ring = sq;
+
+  if (single_mmap) {
+    m_cq_ring = sq;
+  } else {
+    auto cq = mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) return false;
+    m_cq_ring = cq;
+  }
+
+  auto sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) return false;
+  m_sqes = (struct io_uring_sqe *)sqes;
+
+  auto sq_ptr = (char *)m_sq_ring;
+  auto cq_ptr = (char *)m_cq_ring;
+  m_sq_entries = params.sq_entries;
+  m_sq_mask = *(unsigned *)(sq_ptr + params.sq_off.ring_mask);
+  m_sq_head_ptr = (unsigned *)(sq_ptr + params.sq_off.head);
+  m_sq_tail_ptr = (unsigned *)(sq_ptr + params.sq_off.tail);
+  m_sq_flags_ptr = (unsigned *)(sq_ptr + params.sq_off.flags);
+  m_sq_array = (unsigned *)(sq_ptr + params.sq_off.array);
+  m_sq_tail = m_sq_submitted = *m_sq_tail_ptr;
+  m_cq_mask = *(unsigned *)(cq_ptr + params.cq_off.ring_mask);
+  m_cq_head_ptr = (unsigned *)(cq_ptr + params.cq_off.head);
+  m_cq_tail_ptr = (unsigned *)(cq_ptr + params.cq_off.tail);
+  m_cqes = (struct io_uring_cqe *)(cq_ptr + params.cq_off.cqes);
+
+  for (unsigned i = 0; i < m_sq_entries; i++) m_sq_array[i] = i;
+
+  m_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_event_fd < 0) return false;
+  m_event.assign(m_event_fd);
+  if (io_uring_register(m_fd, IORING_REGISTER_EVENTFD, &m_event_fd, 1) < 0) return false;
+
+  wait();
+  return true;
+}
+
+void IOUring::recv(int fd, void *buf, size_t len, Request *req) {
+  req->m_opcode = IORING_OP_RECV;
+  req->m_fd = fd;
+  req->m_addr = buf;
+  req->m_len = len;
+  req->m_flags = 0;
+  submit(req);
+}
+
+void IOUring::send(int fd, struct msghdr *msg, Request *req) {
+  req->m_opcode = IORING_OP_SENDMSG;
+  req->m_fd = fd;
+  req->m_addr = msg;
+  req->m_len = 1;
+  req->m_flags = MSG_NOSIGNAL;
+  submit(req);
+}
+
+void IOUring::accept(int fd, Request *req) {
+  req->m_opcode = IORING_OP_ACCEPT;
+  req->m_fd = fd;
+  req->m_addr = nullptr;
+  req->m_len = 0;
+  req->m_flags = SOCK_CLOEXEC;
+  submit(req);
+}
+
+//
+// Requests that find the submission queue full are kept in order on the
+// deferred list, and go to the ring on the next flush. A request that is
+// canceled before leaving the list completes with -ECANCELED from there.
+//
+
+void IOUring::cancel(Request *req) {
+  if (!req->m_pending || req->m_canceled) return;
+  req->m_canceled = true;
+  if (req->m_deferred != Request::NONE) {
+    schedule_flush();
+    return;
+  }
+  auto *e = m_deferred.empty() ? sqe() : nullptr;
+  if (!e) return defer(req, Request::CANCEL);
+  prepare_cancel(e, req);
+}
+
+auto IOUring::sqe() -> struct io_uring_sqe* {
+  if (auto *e = next_sqe()) return e;
+  flush();
+  return next_sqe();
+}
+
+auto IOUring::next_sqe() -> struct io_uring_sqe* {
+  auto head = __atomic_load_n(m_sq_head_ptr, __ATOMIC_ACQUIRE);
+  if (m_sq_tail - head >= m_sq_entries) return nullptr;
+
+  auto *e = &m_sqes[m_sq_tail & m_sq_mask];
+  std::memset(e, 0, sizeof(*e));
+  m_sq_tail++;
+
+  schedule_flush();
+  return e;
+}
+
+void IOUring::submit(Request *req) {
+  req->m_pending = true;
+  req->m_ring = this;
+
+  auto *e = m_deferred.empty() ? sqe() : nullptr;
+  if (!e) return defer(req, Request::SUBMIT);
+  prepare(e, req);
+}
+
+void IOUring::defer(Request *req, Request::Deferred op) {
+  req->m_deferred = op;
+  m_deferred.push(req);
+  schedule_flush();
+}
+
+void IOUring::prepare(struct io_uring_sqe *e, Request *req) {
+  e->opcode = req->m_opcode;
+  e->fd = req->m_fd;
+  e->addr = (uint64_t)req->m_addr;
+  e->len = req->m_len;
+  e->user_data = (uint64_t)req;
+
+  if (req->m_opcode == IORING_OP_ACCEPT) {
+    e->accept_flags = req->m_flags;
+#ifdef IORING_ACCEPT_MULTISHOT
+    e->ioprio = IORING_ACCEPT_MULTISHOT;
+#endif
+  } else {
+    e->msg_flags = req->m_flags;
+  }
+}
+
+void IOUring::poll(Request *req) {
+  auto *e = m_deferred.empty() ? sqe() : nullptr;
+  if (!e) return defer(req, Request::POLL);
+  prepare_poll(e, req);
+}
+
+void IOUring::prepare_poll(struct io_uring_sqe *e, Request *req) {
+  e->opcode = IORING_OP_POLL_ADD;
+  e->fd = req->m_fd;
+  e->poll32_events = (req->m_opcode == IORING_OP_RECV ? POLLIN : POLLOUT);
+  e->user_data = (uint64_t)req;
+
+  req->m_polling = true;
+}
+
+void IOUring::prepare_cancel(struct io_uring_sqe *e, Request *req) {
+  e->opcode = IORING_OP_ASYNC_CANCEL;
+  e->fd = -1;
+  e->addr = (uint64_t)req;
+  e->user_data = 0;
+}
+
+void IOUring::schedule_flush() {
+  if (!m_flushing) {
+    m_flushing = true;
+    asio::post(m_event.get_executor(), FlushHandler(this));
+  }
+}
+
+void IOUring::flush() {
+  m_flushing = false;
+  __atomic_store_n(m_sq_tail_ptr, m_sq_tail, __ATOMIC_RELEASE);
+  auto n = m_sq_tail - m_sq_submitted;
+  unsigned flags = 0;
+  if (__atomic_load_n(m_sq_flags_ptr, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW) {
+    flags |= IORING_ENTER_GETEVENTS;
+  }
+  if (n > 0 || flags) {
+    auto ret = io_uring_enter(m_fd, n, 0, flags);
+    if (ret >= 0) {
+      m_sq_submitted += ret;
+    } else if (errno != EAGAIN && errno != EBUSY && errno != EINTR) {
+      Log::error("[io_uring] Cannot submit to ring: %s", strerror(errno));
+    }
+    if (m_sq_submitted != m_sq_tail) schedule_flush();
+  }
+  drain();
+}
+
+void IOUring::drain() {
+  while (auto *req = m_deferred.head()) {
+    auto op = req->m_deferred;
+    if (op != Request::CANCEL && req->m_canceled) {
+      m_deferred.remove(req);
+      req->m_deferred = Request::NONE;
+      complete(req, -ECANCELED, 0);
+      continue;
+    }
+    auto *e = next_sqe();
+    if (!e) {
+      schedule_flush();
+      break;
+    }
+    m_deferred.remove(req);
+    req->m_deferred = Request::NONE;
+    switch (op) {
+      case Request::SUBMIT: prepare(e, req); break;
+      case Request::POLL: prepare_poll(e, req); break;
+      case Request::CANCEL: prepare_cancel(e, req); break;
+      default: break;
+    }
+  }
+}
+
+void IOUring::wait() {
+  m_event.async_wait(
+    asio::posix::stream_descriptor::wait_read,
+    EventHandler(this)
+  );
+}
+
+void IOUring::reap() {
+  auto head = *m_cq_head_ptr;
+  for (;;) {
+    auto tail = __atomic_load_n(m_cq_tail_ptr, __ATOMIC_ACQUIRE);
+    if (head == tail) break;
+    const auto &cqe = m_cqes[head & m_cq_mask];
+    auto *req = (Request *)cqe.user_data;
+    auto res = cqe.res;
+    auto flags = cqe.flags;
+    __atomic_store_n(m_cq_head_ptr, ++head, __ATOMIC_RELEASE);
+    if (req) complete(req, res, flags);
+  }
+}
+
+void IOUring::complete(Request *req, int res, unsigned flags) {
+  if (req->m_polling) {
+    req->m_polling = false;
+    if (res >= 0) {
+      if (!req->m_canceled) {
+        submit(req);
+        return;
+      }
+      res = -ECANCELED;
+    }
+  } else if (res == -EAGAIN && !req->m_canceled && req->m_opcode != IORING_OP_ACCEPT) {
+    poll(req);
+    return;
+  }
+
+  bool more = (flags & IORING_CQE_F_MORE);
+  if (!more) {
+    req->m_pending = false;
+    req->m_canceled = false;
+  }
+
+  req->on_complete(res, more);
+}
+
+void IOUring::on_event(const std::error_code &ec) {
+  if (ec) return;
+  uint64_t n;
+  while (::read(m_event_fd, &n, sizeof(n)) > 0) {}
+  reap();
+  if (__atomic_load_n(m_sq_flags_ptr, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW) {
+    flush();
+    reap();
+  }
+  wait();
+}
+
+} // namespace pipy
+
+#endif // PIPY_USE_IO_URING
@@ -0,0 +1,163 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef IO_URING_HPP
+#define IO_URING_HPP
+
+#ifdef PIPY_USE_IO_URING
+
+#include "net.hpp"
+#include "list.hpp"
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <memory>
+
+namespace pipy {
+
+//
+// IOUring
+//
+
+class IOUring {
+public:
+
+  //
+  // IOUring::Request
+  //
+
+  class Request : public List<Request>::Item {
+  public:
+    ~Request();
+
+    bool pending() const { return m_pending; }
+
+  protected:
+    virtual void on_complete(int result, bool more) = 0;
+
+  private:
+    enum Deferred {
+      NONE,
+      SUBMIT,
+      POLL,
+      CANCEL,
+    };
+
+    IOUring* m_ring = nullptr;
+    Deferred m_deferred = NONE;
+    int m_opcode = 0;
+    int m_fd = -1;
+    void* m_addr = nullptr;
+    size_t m_len = 0;
+    int m_flags = 0;
+    bool m_pending = false;
+    bool m_polling = false;
+    bool m_canceled = false;
+
+    friend class IOUring;
+  };
+
+  static void enable(bool b) { s_enabled = b; }
+  static bool enabled() { return s_enabled; }
+  static auto current() -> IOUring*;
+  static auto error_code(int result) -> std::error_code;
+
+  ~IOUring();
+
+  void recv(int fd, void *buf, size_t len, Request *req);
+  void send(int fd, struct msghdr *msg, Request *req);
+  void accept(int fd, Request *req);
+  void cancel(Request *req);
+
+private:
+  IOUring();
+
+  bool init();
+
+  int m_fd = -1;
+  int m_event_fd = -1;
+  unsigned m_sq_entries = 0;
+  unsigned m_sq_mask = 0;
+  unsigned m_sq_tail = 0;
+  unsigned m_sq_submitted = 0;
+  unsigned* m_sq_head_ptr = nullptr;
+  unsigned* m_sq_tail_ptr = nullptr;
+  unsigned* m_sq_flags_ptr = nullptr;
+  unsigned* m_sq_array = nullptr;
+  unsigned m_cq_mask = 0;
+  unsigned* m_cq_head_ptr = nullptr;
+  unsigned* m_cq_tail_ptr = nullptr;
+  struct io_uring_cqe* m_cqes = nullptr;
+  struct io_uring_sqe* m_sqes = nullptr;
+  void* m_sq_ring = nullptr;
+  void* m_cq_ring = nullptr;
+  size_t m_sq_ring_size = 0;
+  size_t m_cq_ring_size = 0;
+  size_t m_sqes_size = 0;
+  asio::posix::stream_descriptor m_event;
+  List<Request> m_deferred;
+  bool m_flushing = false;
+
+  auto sqe() -> struct io_uring_sqe*;
+  auto next_sqe() -> struct io_uring_sqe*;
+  void submit(Request *req);
+  void poll(Request *req);
+  void defer(Request *req, Request::Deferred op);
+  void prepare(struct io_uring_sqe *e, Request *req);
+  void prepare_poll(struct io_uring_sqe *e, Request *req);
+  void prepare_cancel(struct io_uring_sqe *e, Request *req);
+  void schedule_flush();
+  void flush();
+  void drain();
+  void wait();
+  void reap();
+  void complete(Request *req, int res, unsigned flags);
+
+  struct EventHandler : public SelfHandler<IOUring> {
+    using SelfHandler::SelfHandler;
+    EventHandler(const EventHandler &r) : SelfHandler(r) {}
+    void operator()(const std::error_code &ec) { self->on_event(ec); }
+  };
+
+  struct FlushHandler : public SelfHandler<IOUring> {
+    using SelfHandler::SelfHandler;
+    FlushHandler(const FlushHandler &r) : SelfHandler(r) {}
+    void operator()() { self->flush(); }
+  };
+
+  void on_event(const std::error_code &ec);
+
+  static bool s_enabled;
+  thread_local static std::unique_ptr<IOUring> s_current;
+  thread_local static bool s_current_failed;
+};
+
+} // namespace pipy
+
+#endif // PIPY_USE_IO_URING
+
+#endif // IO_URING_HPP
@@ -127,6 +127,9 @@ Listener::Options::Options(pjs::Object *options) {
   Value(options, "noDelay")
     .get(no_delay)
     .check_nullable();
+  Value(options, "batchSize")
+    .get(batch_size)
+    .check_nullable();
   Value(options, "transparent")
     .get(transparent)
     .check_nullable();
@@ -454,6 +457,9 @@ auto Listener::find(Port::Protocol protocol, const std::string &ip, int port) ->
 Listener::AcceptorTCP::AcceptorTCP(Listener *listener)
   : m_listener(listener)
   , m_acceptor(Net::context())
+#ifdef PIPY_USE_IO_URING
+  , m_accept_request(this)
+#endif
 {
 }
 
@@ -469,15 +475,28 @@ void Listener::AcceptorTCP::start(const asio::ip::tcp::endpoint &endpoint) {
 
   m_acceptor.bind(endpoint);
   m_acceptor.listen(asio::socket_base::max_connections);
+
+#ifdef PIPY_USE_IO_URING
+  m_protocol = endpoint.protocol();
+#endif
 }
 
 void Listener::AcceptorTCP::accept() {
+#ifdef PIPY_USE_IO_URING
+  if (accept_uring()) return;
+#endif
   auto inbound = InboundTCP::make(m_listener, m_listener->m_options);
   inbound->accept(m_acceptor);
   m_accepting = inbound;
 }
 
 void Listener::AcceptorTCP::cancel() {
+#ifdef PIPY_USE_IO_URING
+  m_multishot_accepting = false;
+  if (auto *ring = IOUring::current()) {
+    ring->cancel(&m_accept_request);
+  }
+#endif
   m_acceptor.cancel();
   if (m_accepting) {
     m_accepting->cancel();
@@ -486,6 +505,13 @@ void Listener::AcceptorTCP::cancel() {
 }
 
 void Listener::AcceptorTCP::stop() {
+#ifdef PIPY_USE_IO_URING
+  m_stopped = true;
+  m_multishot_accepting = false;
+  if (auto *ring = IOUring::current()) {
+    ring->cancel(&m_accept_request);
+  }
+#endif
   m_acceptor.close();
   if (m_accepting) {
     m_accepting->dangle();
@@ -493,6 +519,45 @@ void Listener::AcceptorTCP::stop() {
   }
 }
 
+#ifdef PIPY_USE_IO_URING
+
+bool Listener::AcceptorTCP::accept_uring() {
+  if (!m_multishot) return false;
+  auto *ring = IOUring::current();
+  if (!ring) return false;
+  m_multishot_accepting = true;
+  if (!m_accept_request.pending()) {
+    ring->accept(m_acceptor.native_handle(), &m_accept_request);
+    retain();
+  }
+  return true;
+}
+
+void Listener::AcceptorTCP::on_accept(int result, bool more) {
+  if (result >= 0) {
+    if (m_stopped) {
+      ::close(result);
+    } else {
+      auto inbound = InboundTCP::make(m_listener, m_listener->m_options);
+      inbound->accept(m_protocol, result);
+    }
+  } else if (result == -EINVAL) {
+    m_multishot = false;
+  } else if (result != -ECANCELED) {
+    auto ec = IOUring::error_code(result);
+    Log::error("[listener] Error accepting connection: %s", ec.message().c_str());
+  }
+
+  if (!more) {
+    if (!m_stopped && m_multishot_accepting) {
+      accept();
+    }
+    release();
+  }
+}
+
+#endif // PIPY_USE_IO_URING
+
 //
 // Listener::AcceptorUDP
 //
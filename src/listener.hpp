@@ -187,6 +187,23 @@ private:
     Listener* m_listener;
     asio::ip::tcp::acceptor m_acceptor;
     pjs::Ref<InboundTCP> m_accepting;
+
+#ifdef PIPY_USE_IO_URING
+    struct AcceptRequest : public IOUring::Request {
+      AcceptorTCP* self;
+      AcceptRequest(AcceptorTCP *a) : self(a) {}
+      virtual void on_complete(int result, bool more) override { self->on_accept(result, more); }
+    };
+
+    AcceptRequest m_accept_request;
+    asio::ip::tcp m_protocol = asio::ip::tcp::v4();
+    bool m_multishot = true;
+    bool m_multishot_accepting = false;
+    bool m_stopped = false;
+
+    bool accept_uring();
+    void on_accept(int result, bool more);
+#endif // PIPY_USE_IO_URING
   };
 
   //
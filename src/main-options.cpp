@@ -82,6 +82,9 @@ void MainOptions::show_help() {
   std::cout << "  --instance-uuid=<uuid>               Specify a UUID for this worker process" << std::endl;
   std::cout << "  --instance-name=<name>               Specify a name for this worker process" << std::endl;
   std::cout << "  --reuse-port                         Enable kernel load balancing for all listening ports" << std::endl;
+#ifdef PIPY_USE_IO_URING
+  std::cout << "  --io-uring                           Use io_uring for TCP socket I/O and accepting connections" << std::endl;
+#endif
   std::cout << "  --admin-port=<[[ip]:]port>           Enable administration service on the specified port" << std::endl;
   std::cout << "  --admin-port-off                     Do not start administration service at startup" << std::endl;
   std::cout << "  --admin-gui=<dirname>                Specify the location of administration GUI front-end files" << std::endl;
@@ -265,6 +268,10 @@ void MainOptions::parse(const std::list<std::string> &args) {
         instance_name = v;
       } else if (k == "--reuse-port") {
         reuse_port = true;
+#ifdef PIPY_USE_IO_URING
+      } else if (k == "--io-uring") {
+        io_uring = true;
+#endif
       } else if (k == "--admin-port-off") {
         admin_port_off = true;
       } else if (k == "--admin-port") {
@@ -387,6 +394,7 @@ auto MainOptions::to_string() -> std::string {
   if (!instance_uuid.empty()) list.push_back("--instance-uuid" + instance_uuid);
   if (!instance_name.empty()) list.push_back("--instance-name" + instance_name);
   if (reuse_port) list.push_back("--reuse-port");
+  if (io_uring) list.push_back("--io-uring");
   if (admin_port_off) list.push_back("--admin-port-off");
   if (!admin_port.empty()) list.push_back("--admin-port=" + admin_port);
   if (!admin_gui.empty()) list.push_back("--admin-gui=" + admin_gui);
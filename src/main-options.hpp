@@ -58,6 +58,7 @@ public:
   bool        trace_objects = false;
   bool        force_start = false;
   bool        reuse_port = false;
+  bool        io_uring = false;
   int         threads = 1;
   std::string log_file;
   Log::Level  log_level = Log::INFO;
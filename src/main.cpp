@@ -36,6 +36,7 @@
 #include "fs.hpp"
 #include "filters/tls.hpp"
 #include "input.hpp"
+#include "io-uring.hpp"
 #include "listener.hpp"
 #include "main-options.hpp"
 #include "net.hpp"
@@ -430,6 +431,9 @@ int pipy_main(int argc, char *argv[]) {
     Log::init();
     logging::Logger::set_history_size(opts.log_history_limit);
     Listener::set_reuse_port(opts.reuse_port);
+#ifdef PIPY_USE_IO_URING
+    IOUring::enable(opts.io_uring);
+#endif
     pjs::Class::set_tracing(opts.trace_objects);
     pjs::Math::init();
     crypto::Crypto::init(opts.openssl_engine);
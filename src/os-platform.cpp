@@ -441,6 +441,8 @@ auto get_last_error() -> std::string {
 
 void init()
 {
+  // Writes to closed sockets and pipes are reported as EPIPE
+  signal(SIGPIPE, SIG_IGN);
 }
 
 void cleanup()
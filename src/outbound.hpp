@@ -110,6 +110,7 @@ public:
   virtual void close() = 0;
 
   virtual auto wrap_socket() -> Socket* = 0;
+  virtual auto get_tcp_socket() -> SocketTCP* { return nullptr; }
   virtual auto get_buffered() const -> size_t = 0;
   virtual auto get_traffic_in() ->size_t = 0;
   virtual auto get_traffic_out() ->size_t = 0;
@@ -197,6 +198,7 @@ private:
   void connect_error(StreamEnd::Error err);
 
   virtual auto wrap_socket() -> Socket* override;
+  virtual auto get_tcp_socket() -> SocketTCP* override { return this; }
   virtual auto get_buffered() const -> size_t override { return SocketTCP::buffered(); }
   virtual auto get_traffic_in() ->size_t override;
   virtual auto get_traffic_out() ->size_t override;
@@ -76,6 +76,8 @@ auto PipelineLoadBalancer::allocate(const std::string &module, const std::string
 PipelineLoadBalancer::AsyncWrapper::AsyncWrapper(Net *net, PipelineLayout *layout, EventTarget::Input *output)
   : m_input_net(net)
   , m_output_net(&Net::current())
+  , m_input_channel(&Net::current(), net)
+  , m_output_channel(net, &Net::current())
   , m_pipeline_layout(layout)
   , m_output(output)
 {
@@ -84,18 +86,61 @@ PipelineLoadBalancer::AsyncWrapper::AsyncWrapper(Net *net, PipelineLayout *layou
 }
 
 void PipelineLoadBalancer::AsyncWrapper::input(Event *evt) {
-  retain();
-  m_input_net->io_context().post(InputHandler(this, SharedEvent::make(evt)));
+  write(&m_input_channel, evt);
 }
 
 void PipelineLoadBalancer::AsyncWrapper::close() {
   m_output = nullptr;
-  m_input_net->io_context().post(CloseHandler(this));
+  if (m_input_channel.backlog.empty()) {
+    m_input_net->io_context().post(CloseHandler(this));
+  } else {
+    m_closing = true;
+  }
 }
 
 void PipelineLoadBalancer::AsyncWrapper::on_event(Event *evt) {
-  retain();
-  m_output_net->io_context().post(OutputHandler(this, SharedEvent::make(evt)));
+  write(&m_output_channel, evt);
+}
+
+void PipelineLoadBalancer::AsyncWrapper::write(Channel *ch, Event *evt) {
+  if (ch->backlog.empty() && ch->queue.enqueue(evt)) {
+    schedule(ch);
+  } else {
+    ch->backlog.emplace_back(evt);
+    if (ch->backlog.size() >= MAX_BACKLOG) ch->congestion.begin();
+    ch->congested.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    pump(ch);
+  }
+}
+
+void PipelineLoadBalancer::AsyncWrapper::pump(Channel *ch) {
+  auto &backlog = ch->backlog;
+  while (!backlog.empty() && ch->queue.enqueue(backlog.front())) {
+    backlog.pop_front();
+  }
+  schedule(ch);
+}
+
+void PipelineLoadBalancer::AsyncWrapper::schedule(Channel *ch) {
+  if (!ch->scheduled.exchange(true)) {
+    retain();
+    ch->target->io_context().post(DrainHandler(this, ch));
+  }
+}
+
+void PipelineLoadBalancer::AsyncWrapper::deliver(Channel *ch, Event *evt) {
+  if (ch == &m_input_channel) {
+    if (m_pipeline) {
+      m_pipeline->input()->input(evt);
+      return;
+    }
+  } else if (m_output) {
+    m_output->input(evt);
+    return;
+  }
+  evt->retain();
+  evt->release();
 }
 
 void PipelineLoadBalancer::AsyncWrapper::on_open() {
@@ -113,27 +158,40 @@ void PipelineLoadBalancer::AsyncWrapper::on_close() {
   release();
 }
 
-void PipelineLoadBalancer::AsyncWrapper::on_input(SharedEvent *se) {
-  if (auto evt = se->to_event()) {
-    if (m_pipeline) {
+void PipelineLoadBalancer::AsyncWrapper::on_drain(Channel *ch) {
+  Event *events[BATCH_SIZE];
+  for (;;) {
+    while (auto n = ch->queue.dequeue(events, BATCH_SIZE)) {
       InputContext ic;
-      m_pipeline->input()->input(evt);
-    } else {
-      evt->retain();
-      evt->release();
+      for (size_t i = 0; i < n; i++) {
+        deliver(ch, events[i]);
+      }
+    }
+    ch->scheduled.store(false);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ch->congested.exchange(false)) {
+      retain();
+      ch->source->io_context().post(RetryHandler(this, ch));
     }
+    if (ch->queue.empty() || ch->scheduled.exchange(true)) break;
   }
   release();
 }
 
-void PipelineLoadBalancer::AsyncWrapper::on_output(SharedEvent *se) {
-  if (auto evt = se->to_event()) {
-    if (m_output) {
-      InputContext ic;
-      m_output->input(evt);
-    } else {
-      evt->retain();
-      evt->release();
+void PipelineLoadBalancer::AsyncWrapper::on_retry(Channel *ch) {
+  if (!ch->backlog.empty()) {
+    ch->congested.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    pump(ch);
+  }
+  if (ch->backlog.size() < MAX_BACKLOG / 2) {
+    ch->congestion.end();
+  }
+  if (ch->backlog.empty()) {
+    ch->congested.store(false);
+    if (ch == &m_input_channel && m_closing) {
+      m_closing = false;
+      m_input_net->io_context().post(CloseHandler(this));
     }
   }
   release();
@@ -27,9 +27,13 @@
 #define PIPELINE_LB_HPP
 
 #include "event.hpp"
+#include "event-queue.hpp"
+#include "input.hpp"
 #include "net.hpp"
 #include "pipeline.hpp"
 
+#include <atomic>
+#include <deque>
 #include <mutex>
 #include <map>
 
@@ -60,6 +64,26 @@ public:
   private:
     AsyncWrapper(Net *net, PipelineLayout *layout, EventTarget::Input *output);
 
+    enum {
+      BATCH_SIZE = 64,
+      MAX_BACKLOG = 256,
+    };
+
+    //
+    // AsyncWrapper::Channel
+    //
+
+    struct Channel {
+      Net* source;
+      Net* target;
+      EventRing queue;
+      std::deque<pjs::Ref<Event>> backlog;
+      InputSource::Congestion congestion;
+      std::atomic<bool> scheduled;
+      std::atomic<bool> congested;
+      Channel(Net *s, Net *t) : source(s), target(t), scheduled(false), congested(false) {}
+    };
+
     struct OpenHandler : SelfHandlerMT<AsyncWrapper> {
       using SelfHandlerMT::SelfHandlerMT;
       OpenHandler(const OpenHandler &r) : SelfHandlerMT(r) {}
@@ -72,34 +96,38 @@ public:
       void operator()() { self->on_close(); }
     };
 
-    struct InputHandler : SelfDataHandlerMT<AsyncWrapper, SharedEvent> {
+    struct DrainHandler : SelfDataHandlerMT<AsyncWrapper, Channel> {
       using SelfDataHandlerMT::SelfDataHandlerMT;
-      InputHandler(AsyncWrapper *s, SharedEvent *d) : SelfDataHandlerMT(s, d) { d->retain(); }
-      InputHandler(const InputHandler &r) : SelfDataHandlerMT(r) { r.data->retain(); }
-      ~InputHandler() { data->release(); }
-      void operator()() { self->on_input(data); }
+      DrainHandler(const DrainHandler &r) : SelfDataHandlerMT(r) {}
+      void operator()() { self->on_drain(data); }
     };
 
-    struct OutputHandler : SelfDataHandlerMT<AsyncWrapper, SharedEvent> {
+    struct RetryHandler : SelfDataHandlerMT<AsyncWrapper, Channel> {
       using SelfDataHandlerMT::SelfDataHandlerMT;
-      OutputHandler(AsyncWrapper *s, SharedEvent *d) : SelfDataHandlerMT(s, d) { d->retain(); }
-      OutputHandler(const OutputHandler &r) : SelfDataHandlerMT(r) { r.data->retain(); }
-      ~OutputHandler() { data->release(); }
-      void operator()() { self->on_output(data); }
+      RetryHandler(const RetryHandler &r) : SelfDataHandlerMT(r) {}
+      void operator()() { self->on_retry(data); }
     };
 
     virtual void on_event(Event *evt) override;
 
+    void write(Channel *ch, Event *evt);
+    void pump(Channel *ch);
+    void schedule(Channel *ch);
+    void deliver(Channel *ch, Event *evt);
+
     void on_open();
     void on_close();
-    void on_input(SharedEvent *se);
-    void on_output(SharedEvent *se);
+    void on_drain(Channel *ch);
+    void on_retry(Channel *ch);
 
     Net* m_input_net;
     Net* m_output_net;
+    Channel m_input_channel;
+    Channel m_output_channel;
     pjs::Ref<PipelineLayout> m_pipeline_layout;
     pjs::Ref<Pipeline> m_pipeline;
     pjs::Ref<EventTarget::Input> m_output;
+    bool m_closing = false;
 
     friend class pjs::RefCount<AsyncWrapper>;
     friend class PipelineLoadBalancer;
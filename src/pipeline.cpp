@@ -314,6 +314,7 @@ void Pipeline::reset() {
   }
   m_context = nullptr;
   m_started = false;
+  m_spliceable = false;
   m_pending_events.clear();
   if (m_starting_promise_callback) {
     m_starting_promise_callback->close();
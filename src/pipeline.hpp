@@ -188,6 +188,8 @@ public:
   void chain(Input *input) { EventProxy::chain(input); }
   void chain(PipelineLayout::Chain *chain, const pjs::Value &args = pjs::Value::undefined) { m_chain = chain; m_chain_args = args; }
   auto chain_args() const -> const pjs::Value& { return m_chain_args; }
+  bool spliceable() const { return m_spliceable; }
+  void spliceable(bool b) { m_spliceable = b; }
   void start(const pjs::Value &args);
   auto start(int argc = 0, pjs::Value *argv = nullptr) -> Pipeline*;
   void on_end(ResultCallback *cb) { m_result_cb = cb; }
@@ -210,6 +212,7 @@ private:
   EventBuffer m_pending_events;
   ResultCallback* m_result_cb = nullptr;
   bool m_started = false;
+  bool m_spliceable = false;
 
   void wait(pjs::Promise *promise);
   void resolve(const pjs::Value &value);
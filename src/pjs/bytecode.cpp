@@ -0,0 +1,270 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "bytecode.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+
+#include <iostream>
+#include <new>
+
+namespace pjs {
+
+//
+// Bytecode::Compiler
+//
+
+auto Bytecode::Compiler::alloc() -> int {
+  auto i = m_top++;
+  if (m_top > m_max) m_max = m_top;
+  return i;
+}
+
+auto Bytecode::Compiler::constant(const Value &v) -> int {
+  for (size_t i = 0; i < m_constants.size(); i++) {
+    if (Value::is_identical(m_constants[i], v)) return ~int(i);
+  }
+  m_constants.push_back(v);
+  return ~int(m_constants.size() - 1);
+}
+
+auto Bytecode::Compiler::expr(Expr *x) -> int {
+  m_exprs.push_back(x);
+  return m_exprs.size() - 1;
+}
+
+auto Bytecode::Compiler::stmt(Stmt *s) -> int {
+  m_stmts.push_back(s);
+  return m_stmts.size() - 1;
+}
+
+auto Bytecode::Compiler::emit(OpCode op, int a, int b, int c, int d) -> int {
+  m_code.push_back({ op, a, b, c, d });
+  return m_code.size() - 1;
+}
+
+//
+// Registers
+//
+
+class Registers {
+public:
+  Registers(int n) : m_size(n) {
+    for (int i = 0; i < n; i++) new (values() + i) Value();
+  }
+
+  ~Registers() {
+    for (int i = 0; i < m_size; i++) values()[i].~Value();
+  }
+
+  Value& operator[](int i) { return values()[i]; }
+
+private:
+  int m_size;
+  alignas(Value) char m_storage[sizeof(Value) * Bytecode::MAX_REGISTERS];
+
+  auto values() -> Value* { return reinterpret_cast<Value*>(m_storage); }
+};
+
+//
+// Bytecode
+//
+
+bool Bytecode::s_enabled = true;
+
+auto Bytecode::compile(Expr *expr) -> Bytecode* {
+  return compile(
+    [=](Compiler &c) {
+      auto r = expr->operand(c);
+      c.emit(OpCode::RET, r);
+    }
+  );
+}
+
+auto Bytecode::compile(Stmt *stmt) -> Bytecode* {
+  return compile(
+    [=](Compiler &c) {
+      stmt->compile(c);
+      c.emit(OpCode::RET, c.constant(Value::undefined));
+    }
+  );
+}
+
+auto Bytecode::compile(const std::function<void(Compiler&)> &emit) -> Bytecode* {
+  for (int pass = 0; pass < 2; pass++) {
+    Compiler c;
+    c.m_direct_locals = (pass == 0);
+    emit(c);
+    if (c.m_max > MAX_REGISTERS) return nullptr;
+    bool has_eval = false, has_code = false;
+    for (const auto &i : c.m_code) {
+      switch (i.op) {
+        case OpCode::EVAL:
+        case OpCode::EXEC: has_eval = true; break;
+        case OpCode::RET: break;
+        default: has_code = true; break;
+      }
+    }
+    if (has_eval && !has_code) return nullptr;
+    if (has_eval && c.m_direct_locals) continue;
+    return new Bytecode(c);
+  }
+  return nullptr;
+}
+
+Bytecode::Bytecode(Compiler &c)
+  : m_code(std::move(c.m_code))
+  , m_constants(std::move(c.m_constants))
+  , m_exprs(std::move(c.m_exprs))
+  , m_stmts(std::move(c.m_stmts))
+  , m_register_count(c.m_max)
+{
+}
+
+bool Bytecode::run(Context &ctx, Value &result) {
+  Registers R(m_register_count);
+  auto K = m_constants.data();
+  auto L = ctx.scope()->values();
+  auto code = m_code.data();
+  auto *i = code;
+
+  #define V(x) ((x) < 0 ? K[~(x)] : (x) < MAX_REGISTERS ? R[x] : L[(x) - MAX_REGISTERS])
+
+#if defined(__GNUC__)
+
+  static const void* labels[] = {
+    &&op_EVAL, &&op_EXEC, &&op_CONST, &&op_LOCAL, &&op_PROP, &&op_OPT_PROP,
+    &&op_NEG, &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV, &&op_REM, &&op_NOT,
+    &&op_EQL, &&op_NEQ, &&op_SAME, &&op_DIFF, &&op_GT, &&op_GE, &&op_LT, &&op_LE,
+    &&op_JMP, &&op_JMPF, &&op_JMPT, &&op_JMPNN, &&op_RET,
+  };
+
+  #define OP(name) op_##name:
+  #define NEXT() goto *labels[(int)(++i)->op]
+  #define DISPATCH() goto *labels[(int)i->op];
+
+#else
+
+  #define OP(name) case OpCode::name:
+  #define NEXT() i++; continue
+  #define DISPATCH() for (;;) switch (i->op)
+
+#endif
+
+  DISPATCH() {
+    OP(EVAL) {
+      if (!m_exprs[i->b]->eval(ctx, R[i->a])) return false;
+      NEXT();
+    }
+    OP(EXEC) {
+      Stmt::Result res;
+      m_stmts[i->b]->execute(ctx, res);
+      if (!ctx.ok()) return false;
+      if (!res.is_done()) {
+        result = res.is_return() ? res.value : Value::undefined;
+        return true;
+      }
+      NEXT();
+    }
+    OP(CONST) {
+      R[i->a] = K[~i->b];
+      NEXT();
+    }
+    OP(LOCAL) {
+      auto *scope = ctx.scope();
+      for (int n = 0; n < i->c; n++) scope = scope->parent();
+      R[i->a] = scope->value(i->b);
+      NEXT();
+    }
+    OP(PROP) {
+      auto x = static_cast<expr::Property*>(m_exprs[i->d]);
+      if (!x->get(ctx, V(i->b), V(i->c), R[i->a])) return false;
+      NEXT();
+    }
+    OP(OPT_PROP) {
+      auto x = static_cast<expr::OptionalProperty*>(m_exprs[i->d]);
+      if (!x->get(ctx, V(i->b), V(i->c), R[i->a])) return false;
+      NEXT();
+    }
+    OP(NEG) { expr::Negation::operate(V(i->b), R[i->a]); NEXT(); }
+    OP(ADD) { expr::Addition::operate(V(i->b), V(i->c), R[i->a]); NEXT(); }
+    OP(SUB) { expr::Subtraction::operate(V(i->b), V(i->c), R[i->a]); NEXT(); }
+    OP(MUL) { expr::Multiplication::operate(V(i->b), V(i->c), R[i->a]); NEXT(); }
+    OP(DIV) { expr::Division::operate(V(i->b), V(i->c), R[i->a]); NEXT(); }
+    OP(REM) { expr::Remainder::operate(V(i->b), V(i->c), R[i->a]); NEXT(); }
+    OP(NOT) { expr::LogicalNot::operate(V(i->b), R[i->a]); NEXT(); }
+    OP(EQL) { expr::Equality::operate(V(i->b), V(i->c), R[i->a]); NEXT(); }
+    OP(NEQ) { expr::Inequality::operate(V(i->b), V(i->c), R[i->a]); NEXT(); }
+    OP(SAME) { expr::Identity::operate(V(i->b), V(i->c), R[i->a]); NEXT(); }
+    OP(DIFF) { expr::Nonidentity::operate(V(i->b), V(i->c), R[i->a]); NEXT(); }
+    OP(GT) { expr::GreaterThan::operate(V(i->b), V(i->c), R[i->a]); NEXT(); }
+    OP(GE) { expr::GreaterThanOrEqual::operate(V(i->b), V(i->c), R[i->a]); NEXT(); }
+    OP(LT) { expr::LessThan::operate(V(i->b), V(i->c), R[i->a]); NEXT(); }
+    OP(LE) { expr::LessThanOrEqual::operate(V(i->b), V(i->c), R[i->a]); NEXT(); }
+    OP(JMP) {
+      i = code + i->b - 1;
+      NEXT();
+    }
+    OP(JMPF) {
+      if (!R[i->a].to_boolean()) i = code + i->b - 1;
+      NEXT();
+    }
+    OP(JMPT) {
+      if (R[i->a].to_boolean()) i = code + i->b - 1;
+      NEXT();
+    }
+    OP(JMPNN) {
+      if (!R[i->a].is_nullish()) i = code + i->b - 1;
+      NEXT();
+    }
+    OP(RET) {
+      result = V(i->a);
+      return true;
+    }
+  }
+
+  #undef V
+  #undef OP
+  #undef NEXT
+  #undef DISPATCH
+
+  return false;
+}
+
+void Bytecode::dump(std::ostream &out) {
+  static const char *names[] = {
+    "EVAL", "EXEC", "CONST", "LOCAL", "PROP", "OPT_PROP",
+    "NEG", "ADD", "SUB", "MUL", "DIV", "REM", "NOT",
+    "EQL", "NEQ", "SAME", "DIFF", "GT", "GE", "LT", "LE",
+    "JMP", "JMPF", "JMPT", "JMPNN", "RET",
+  };
+  for (size_t n = 0; n < m_code.size(); n++) {
+    const auto &i = m_code[n];
+    out << n << '\t' << names[(int)i.op] << '\t';
+    out << i.a << ' ' << i.b << ' ' << i.c << ' ' << i.d << std::endl;
+  }
+}
+
+} // namespace pjs
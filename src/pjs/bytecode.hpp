@@ -0,0 +1,134 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PJS_BYTECODE_HPP
+#define PJS_BYTECODE_HPP
+
+#include "types.hpp"
+
+#include <functional>
+#include <vector>
+
+namespace pjs {
+
+class Expr;
+class Stmt;
+
+//
+// Bytecode
+//
+
+class Bytecode {
+public:
+  enum class OpCode : uint8_t {
+    EVAL,
+    EXEC,
+    CONST,
+    LOCAL,
+    PROP,
+    OPT_PROP,
+    NEG,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    REM,
+    NOT,
+    EQL,
+    NEQ,
+    SAME,
+    DIFF,
+    GT,
+    GE,
+    LT,
+    LE,
+    JMP,
+    JMPF,
+    JMPT,
+    JMPNN,
+    RET,
+  };
+
+  static const int MAX_REGISTERS = 16;
+
+  struct Instruction {
+    OpCode op;
+    int a, b, c, d;
+  };
+
+  //
+  // Bytecode::Compiler
+  //
+
+  class Compiler {
+  public:
+    auto alloc() -> int;
+    void free(int n = 1) { m_top -= n; }
+    void release(int operand) { if (0 <= operand && operand < MAX_REGISTERS) free(); }
+    auto constant(const Value &v) -> int;
+    auto local(int i) -> int { return m_direct_locals ? MAX_REGISTERS + i : -1; }
+    auto expr(Expr *x) -> int;
+    auto stmt(Stmt *s) -> int;
+    auto emit(OpCode op, int a = 0, int b = 0, int c = 0, int d = 0) -> int;
+    auto label() const -> int { return m_code.size(); }
+    void patch(int i, int target) { m_code[i].b = target; }
+
+  private:
+    std::vector<Instruction> m_code;
+    std::vector<Value> m_constants;
+    std::vector<Expr*> m_exprs;
+    std::vector<Stmt*> m_stmts;
+    int m_top = 0;
+    int m_max = 0;
+    bool m_direct_locals = false;
+
+    friend class Bytecode;
+  };
+
+  static void enable(bool b) { s_enabled = b; }
+  static bool enabled() { return s_enabled; }
+  static auto compile(Expr *expr) -> Bytecode*;
+  static auto compile(Stmt *stmt) -> Bytecode*;
+
+  bool run(Context &ctx, Value &result);
+  void dump(std::ostream &out);
+
+private:
+  Bytecode(Compiler &c);
+
+  std::vector<Instruction> m_code;
+  std::vector<Value> m_constants;
+  std::vector<Expr*> m_exprs;
+  std::vector<Stmt*> m_stmts;
+  int m_register_count;
+
+  static bool s_enabled;
+
+  static auto compile(const std::function<void(Compiler&)> &emit) -> Bytecode*;
+};
+
+} // namespace pjs
+
+#endif // PJS_BYTECODE_HPP
@@ -178,6 +178,14 @@ bool Undefined::eval(Context &ctx, Value &result) {
   return true;
 }
 
+void Undefined::compile(Bytecode::Compiler &c, int r) {
+  c.emit(Bytecode::OpCode::CONST, r, c.constant(Value::undefined));
+}
+
+auto Undefined::operand(Bytecode::Compiler &c) -> int {
+  return c.constant(Value::undefined);
+}
+
 auto Undefined::reduce(Reducer &r) -> Reducer::Value* {
   return r.undefined();
 }
@@ -195,6 +203,14 @@ bool Null::eval(Context &ctx, Value &result) {
   return true;
 }
 
+void Null::compile(Bytecode::Compiler &c, int r) {
+  c.emit(Bytecode::OpCode::CONST, r, c.constant(Value::null));
+}
+
+auto Null::operand(Bytecode::Compiler &c) -> int {
+  return c.constant(Value::null);
+}
+
 auto Null::reduce(Reducer &r) -> Reducer::Value* {
   return r.null();
 }
@@ -212,6 +228,14 @@ bool BooleanLiteral::eval(Context &ctx, Value &result) {
   return true;
 }
 
+void BooleanLiteral::compile(Bytecode::Compiler &c, int r) {
+  c.emit(Bytecode::OpCode::CONST, r, c.constant(m_b));
+}
+
+auto BooleanLiteral::operand(Bytecode::Compiler &c) -> int {
+  return c.constant(m_b);
+}
+
 auto BooleanLiteral::reduce(Reducer &r) -> Reducer::Value* {
   return r.boolean(m_b);
 }
@@ -229,6 +253,14 @@ bool NumberLiteral::eval(Context &ctx, Value &result) {
   return true;
 }
 
+void NumberLiteral::compile(Bytecode::Compiler &c, int r) {
+  c.emit(Bytecode::OpCode::CONST, r, c.constant(m_n));
+}
+
+auto NumberLiteral::operand(Bytecode::Compiler &c) -> int {
+  return c.constant(m_n);
+}
+
 auto NumberLiteral::reduce(Reducer &r) -> Reducer::Value* {
   return r.number(m_n);
 }
@@ -246,6 +278,14 @@ bool StringLiteral::eval(Context &ctx, Value &result) {
   return true;
 }
 
+void StringLiteral::compile(Bytecode::Compiler &c, int r) {
+  c.emit(Bytecode::OpCode::CONST, r, c.constant(m_s.get()));
+}
+
+auto StringLiteral::operand(Bytecode::Compiler &c) -> int {
+  return c.constant(m_s.get());
+}
+
 auto StringLiteral::reduce(Reducer &r) -> Reducer::Value* {
   return r.string(m_s->str());
 }
@@ -558,6 +598,12 @@ void FunctionLiteral::resolve(Module *module, Context &ctx, int l, LegacyImports
     name, [this](Context &ctx, Object*, Value &result) {
       auto scope = m_scope.instantiate(ctx);
       if (!scope) return;
+      if (m_bytecode && Bytecode::enabled()) {
+        auto ok = m_bytecode->run(ctx, result);
+        scope->clear();
+        if (!ok && ctx.ok()) ctx.error("bytecode execution failed");
+        return;
+      }
       Stmt::Result res;
       m_output->execute(ctx, res);
       if (ctx.ok()) {
@@ -574,6 +620,14 @@ void FunctionLiteral::resolve(Module *module, Context &ctx, int l, LegacyImports
   Context fctx(ctx, 0, nullptr, pjs::Scope::make(ctx.instance(), ctx.scope(), m_scope.size(), m_scope.variables()));
   for (auto &i : m_inputs) i->resolve(module, fctx, l, imports);
   m_output->resolve(module, fctx, l, imports);
+
+  if (auto ret = dynamic_cast<stmt::Return*>(m_output.get())) {
+    if (auto value = ret->value()) {
+      m_bytecode.reset(Bytecode::compile(value));
+    }
+  } else {
+    m_bytecode.reset(Bytecode::compile(m_output.get()));
+  }
 }
 
 auto FunctionLiteral::reduce(Reducer &r) -> Reducer::Value* {
@@ -715,6 +769,18 @@ bool LocalVariable::eval(Context &ctx, Value &result) {
   return true;
 }
 
+void LocalVariable::compile(Bytecode::Compiler &c, int r) {
+  c.emit(Bytecode::OpCode::LOCAL, r, m_i, m_level);
+}
+
+auto LocalVariable::operand(Bytecode::Compiler &c) -> int {
+  if (m_level == 0) {
+    auto i = c.local(m_i);
+    if (i >= 0) return i;
+  }
+  return Expr::operand(c);
+}
+
 bool LocalVariable::assign(Context &ctx, Value &value) {
   auto *scope = ctx.scope();
   for (int i = 0; i < m_level; i++) scope = scope->parent();
@@ -784,6 +850,22 @@ bool Identifier::eval(Context &ctx, Value &result) {
   return m_resolved->eval(ctx, result);
 }
 
+void Identifier::compile(Bytecode::Compiler &c, int r) {
+  if (m_resolved) {
+    m_resolved->compile(c, r);
+  } else {
+    Expr::compile(c, r);
+  }
+}
+
+auto Identifier::operand(Bytecode::Compiler &c) -> int {
+  if (m_resolved) {
+    return m_resolved->operand(c);
+  } else {
+    return Expr::operand(c);
+  }
+}
+
 bool Identifier::assign(Context &ctx, Value &value) {
   if (!m_resolved) resolve(ctx);
   if (!m_resolved) return error(ctx, "unresolved identifier");
@@ -878,6 +960,18 @@ bool Property::eval(Context &ctx, Value &result) {
   Value obj, key;
   if (!m_obj->eval(ctx, obj)) return false;
   if (!m_key->eval(ctx, key)) return false;
+  return get(ctx, obj, key, result);
+}
+
+void Property::compile(Bytecode::Compiler &c, int r) {
+  auto o = m_obj->operand(c);
+  auto k = m_key->operand(c);
+  c.emit(Bytecode::OpCode::PROP, r, o, k, c.expr(this));
+  c.release(k);
+  c.release(o);
+}
+
+bool Property::get(Context &ctx, const Value &obj, const Value &key, Value &result) {
   if (obj.is_undefined()) return error(ctx, "cannot read property of undefined");
   if (obj.is_null()) return error(ctx, "cannot read property of null");
   auto o = obj.to_object();
@@ -973,6 +1067,18 @@ bool OptionalProperty::eval(Context &ctx, Value &result) {
   Value obj, key;
   if (!m_obj->eval(ctx, obj)) return false;
   if (!m_key->eval(ctx, key)) return false;
+  return get(ctx, obj, key, result);
+}
+
+void OptionalProperty::compile(Bytecode::Compiler &c, int r) {
+  auto o = m_obj->operand(c);
+  auto k = m_key->operand(c);
+  c.emit(Bytecode::OpCode::OPT_PROP, r, o, k, c.expr(this));
+  c.release(k);
+  c.release(o);
+}
+
+bool OptionalProperty::get(Context &ctx, const Value &obj, const Value &key, Value &result) {
   if (obj.is_undefined() || obj.is_null()) {
     result = Value::undefined;
     return true;
@@ -1177,12 +1283,22 @@ void Plus::dump(std::ostream &out, const std::string &indent) {
 bool Negation::eval(Context &ctx, Value &result) {
   Value x;
   if (!m_x->eval(ctx, x)) return false;
+  operate(x, result);
+  return true;
+}
+
+void Negation::operate(const Value &x, Value &result) {
   if (x.is<Int>()) {
     result.set(x.as<Int>()->neg());
-    return true;
+    return;
   }
   result.set(-x.to_number());
-  return true;
+}
+
+void Negation::compile(Bytecode::Compiler &c, int r) {
+  auto x = m_x->operand(c);
+  c.emit(Bytecode::OpCode::NEG, r, x);
+  c.release(x);
 }
 
 bool Negation::declare(Module *module, Scope &scope, Error &error) {
@@ -1206,13 +1322,18 @@ bool Addition::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void Addition::operate(const Value &a, const Value &b, Value &result) {
   if (a.is_string() || b.is_string()) {
     auto sa = a.to_string();
     auto sb = b.to_string();
     result.set(sa->str() + sb->str());
     sa->release();
     sb->release();
-    return true;
+    return;
   }
   if (a.is<Int>() || b.is<Int>()) {
     auto ia = a.to_int();
@@ -1220,12 +1341,19 @@ bool Addition::eval(Context &ctx, Value &result) {
     result.set(ia->add(ib));
     ia->release();
     ib->release();
-    return true;
+    return;
   }
   auto na = a.to_number();
   auto nb = b.to_number();
   result.set(na + nb);
-  return true;
+}
+
+void Addition::compile(Bytecode::Compiler &c, int r) {
+  auto a = m_a->operand(c);
+  auto b = m_b->operand(c);
+  c.emit(Bytecode::OpCode::ADD, r, a, b);
+  c.release(b);
+  c.release(a);
 }
 
 bool Addition::declare(Module *module, Scope &scope, Error &error) {
@@ -1253,18 +1381,30 @@ bool Subtraction::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void Subtraction::operate(const Value &a, const Value &b, Value &result) {
   if (a.is<Int>() || b.is<Int>()) {
     auto ia = a.to_int();
     auto ib = b.to_int();
     result.set(ia->sub(ib));
     ia->release();
     ib->release();
-    return true;
+    return;
   }
   auto na = a.to_number();
   auto nb = b.to_number();
   result.set(na - nb);
-  return true;
+}
+
+void Subtraction::compile(Bytecode::Compiler &c, int r) {
+  auto a = m_a->operand(c);
+  auto b = m_b->operand(c);
+  c.emit(Bytecode::OpCode::SUB, r, a, b);
+  c.release(b);
+  c.release(a);
 }
 
 bool Subtraction::declare(Module *module, Scope &scope, Error &error) {
@@ -1292,18 +1432,30 @@ bool Multiplication::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void Multiplication::operate(const Value &a, const Value &b, Value &result) {
   if (a.is<Int>() || b.is<Int>()) {
     auto ia = a.to_int();
     auto ib = b.to_int();
     result.set(ia->mul(ib));
     ia->release();
     ib->release();
-    return true;
+    return;
   }
   auto na = a.to_number();
   auto nb = b.to_number();
   result.set(na * nb);
-  return true;
+}
+
+void Multiplication::compile(Bytecode::Compiler &c, int r) {
+  auto a = m_a->operand(c);
+  auto b = m_b->operand(c);
+  c.emit(Bytecode::OpCode::MUL, r, a, b);
+  c.release(b);
+  c.release(a);
 }
 
 bool Multiplication::declare(Module *module, Scope &scope, Error &error) {
@@ -1331,18 +1483,30 @@ bool Division::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void Division::operate(const Value &a, const Value &b, Value &result) {
   if (a.is<Int>() || b.is<Int>()) {
     auto ia = a.to_int();
     auto ib = b.to_int();
     result.set(ia->div(ib));
     ia->release();
     ib->release();
-    return true;
+    return;
   }
   auto na = a.to_number();
   auto nb = b.to_number();
   result.set(na / nb);
-  return true;
+}
+
+void Division::compile(Bytecode::Compiler &c, int r) {
+  auto a = m_a->operand(c);
+  auto b = m_b->operand(c);
+  c.emit(Bytecode::OpCode::DIV, r, a, b);
+  c.release(b);
+  c.release(a);
 }
 
 bool Division::declare(Module *module, Scope &scope, Error &error) {
@@ -1370,18 +1534,30 @@ bool Remainder::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void Remainder::operate(const Value &a, const Value &b, Value &result) {
   if (a.is<Int>() || b.is<Int>()) {
     auto ia = a.to_int();
     auto ib = b.to_int();
     result.set(ia->mod(ib));
     ia->release();
     ib->release();
-    return true;
+    return;
   }
   auto na = a.to_number();
   auto nb = b.to_number();
   result.set(std::fmod(na, nb));
-  return true;
+}
+
+void Remainder::compile(Bytecode::Compiler &c, int r) {
+  auto a = m_a->operand(c);
+  auto b = m_b->operand(c);
+  c.emit(Bytecode::OpCode::REM, r, a, b);
+  c.release(b);
+  c.release(a);
 }
 
 bool Remainder::declare(Module *module, Scope &scope, Error &error) {
@@ -1689,10 +1865,20 @@ void BitwiseXor::dump(std::ostream &out, const std::string &indent) {
 bool LogicalNot::eval(Context &ctx, Value &result) {
   Value x;
   if (!m_x->eval(ctx, x)) return false;
-  result.set(!x.to_boolean());
+  operate(x, result);
   return true;
 }
 
+void LogicalNot::operate(const Value &x, Value &result) {
+  result.set(!x.to_boolean());
+}
+
+void LogicalNot::compile(Bytecode::Compiler &c, int r) {
+  auto x = m_x->operand(c);
+  c.emit(Bytecode::OpCode::NOT, r, x);
+  c.release(x);
+}
+
 bool LogicalNot::declare(Module *module, Scope &scope, Error &error) {
   return m_x->declare(module, scope, error);
 }
@@ -1717,6 +1903,13 @@ bool LogicalAnd::eval(Context &ctx, Value &result) {
   return true;
 }
 
+void LogicalAnd::compile(Bytecode::Compiler &c, int r) {
+  m_a->compile(c, r);
+  auto j = c.emit(Bytecode::OpCode::JMPF, r);
+  m_b->compile(c, r);
+  c.patch(j, c.label());
+}
+
 bool LogicalAnd::declare(Module *module, Scope &scope, Error &error) {
   if (!m_a->declare(module, scope, error)) return false;
   if (!m_b->declare(module, scope, error)) return false;
@@ -1745,6 +1938,13 @@ bool LogicalOr::eval(Context &ctx, Value &result) {
   return true;
 }
 
+void LogicalOr::compile(Bytecode::Compiler &c, int r) {
+  m_a->compile(c, r);
+  auto j = c.emit(Bytecode::OpCode::JMPT, r);
+  m_b->compile(c, r);
+  c.patch(j, c.label());
+}
+
 bool LogicalOr::declare(Module *module, Scope &scope, Error &error) {
   if (!m_a->declare(module, scope, error)) return false;
   if (!m_b->declare(module, scope, error)) return false;
@@ -1773,6 +1973,13 @@ bool NullishCoalescing::eval(Context &ctx, Value &result) {
   return true;
 }
 
+void NullishCoalescing::compile(Bytecode::Compiler &c, int r) {
+  m_a->compile(c, r);
+  auto j = c.emit(Bytecode::OpCode::JMPNN, r);
+  m_b->compile(c, r);
+  c.patch(j, c.label());
+}
+
 bool NullishCoalescing::declare(Module *module, Scope &scope, Error &error) {
   if (!m_a->declare(module, scope, error)) return false;
   if (!m_b->declare(module, scope, error)) return false;
@@ -1798,16 +2005,28 @@ bool Equality::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void Equality::operate(const Value &a, const Value &b, Value &result) {
   if (a.is<Int>() || b.is<Int>()) {
     auto ia = a.to_int();
     auto ib = b.to_int();
     result.set(ia->eql(ib));
     ia->release();
     ib->release();
-    return true;
+    return;
   }
   result.set(Value::is_equal(a, b));
-  return true;
+}
+
+void Equality::compile(Bytecode::Compiler &c, int r) {
+  auto a = m_a->operand(c);
+  auto b = m_b->operand(c);
+  c.emit(Bytecode::OpCode::EQL, r, a, b);
+  c.release(b);
+  c.release(a);
 }
 
 bool Equality::declare(Module *module, Scope &scope, Error &error) {
@@ -1835,16 +2054,28 @@ bool Inequality::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void Inequality::operate(const Value &a, const Value &b, Value &result) {
   if (a.is<Int>() || b.is<Int>()) {
     auto ia = a.to_int();
     auto ib = b.to_int();
     result.set(!ia->eql(ib));
     ia->release();
     ib->release();
-    return true;
+    return;
   }
   result.set(!Value::is_equal(a, b));
-  return true;
+}
+
+void Inequality::compile(Bytecode::Compiler &c, int r) {
+  auto a = m_a->operand(c);
+  auto b = m_b->operand(c);
+  c.emit(Bytecode::OpCode::NEQ, r, a, b);
+  c.release(b);
+  c.release(a);
 }
 
 bool Inequality::declare(Module *module, Scope &scope, Error &error) {
@@ -1872,10 +2103,22 @@ bool Identity::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
-  result.set(Value::is_identical(a, b));
+  operate(a, b, result);
   return true;
 }
 
+void Identity::operate(const Value &a, const Value &b, Value &result) {
+  result.set(Value::is_identical(a, b));
+}
+
+void Identity::compile(Bytecode::Compiler &c, int r) {
+  auto a = m_a->operand(c);
+  auto b = m_b->operand(c);
+  c.emit(Bytecode::OpCode::SAME, r, a, b);
+  c.release(b);
+  c.release(a);
+}
+
 bool Identity::declare(Module *module, Scope &scope, Error &error) {
   if (!m_a->declare(module, scope, error)) return false;
   if (!m_b->declare(module, scope, error)) return false;
@@ -1901,10 +2144,22 @@ bool Nonidentity::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
-  result.set(!Value::is_identical(a, b));
+  operate(a, b, result);
   return true;
 }
 
+void Nonidentity::operate(const Value &a, const Value &b, Value &result) {
+  result.set(!Value::is_identical(a, b));
+}
+
+void Nonidentity::compile(Bytecode::Compiler &c, int r) {
+  auto a = m_a->operand(c);
+  auto b = m_b->operand(c);
+  c.emit(Bytecode::OpCode::DIFF, r, a, b);
+  c.release(b);
+  c.release(a);
+}
+
 bool Nonidentity::declare(Module *module, Scope &scope, Error &error) {
   if (!m_a->declare(module, scope, error)) return false;
   if (!m_b->declare(module, scope, error)) return false;
@@ -1930,6 +2185,11 @@ bool GreaterThan::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void GreaterThan::operate(const Value &a, const Value &b, Value &result) {
   if (a.is_undefined() || b.is_undefined()) {
     result.set(false);
   } else if (a.is_string() && b.is_string()) {
@@ -1945,7 +2205,14 @@ bool GreaterThan::eval(Context &ctx, Value &result) {
     auto nb = b.to_number();
     result.set(na > nb);
   }
-  return true;
+}
+
+void GreaterThan::compile(Bytecode::Compiler &c, int r) {
+  auto a = m_a->operand(c);
+  auto b = m_b->operand(c);
+  c.emit(Bytecode::OpCode::GT, r, a, b);
+  c.release(b);
+  c.release(a);
 }
 
 bool GreaterThan::declare(Module *module, Scope &scope, Error &error) {
@@ -1973,6 +2240,11 @@ bool GreaterThanOrEqual::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void GreaterThanOrEqual::operate(const Value &a, const Value &b, Value &result) {
   if (a.is_undefined() || b.is_undefined()) {
     result.set(false);
   } else if (a.is_string() && b.is_string()) {
@@ -1988,7 +2260,14 @@ bool GreaterThanOrEqual::eval(Context &ctx, Value &result) {
     auto nb = b.to_number();
     result.set(na >= nb);
   }
-  return true;
+}
+
+void GreaterThanOrEqual::compile(Bytecode::Compiler &c, int r) {
+  auto a = m_a->operand(c);
+  auto b = m_b->operand(c);
+  c.emit(Bytecode::OpCode::GE, r, a, b);
+  c.release(b);
+  c.release(a);
 }
 
 bool GreaterThanOrEqual::declare(Module *module, Scope &scope, Error &error) {
@@ -2016,6 +2295,11 @@ bool LessThan::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void LessThan::operate(const Value &a, const Value &b, Value &result) {
   if (a.is_undefined() || b.is_undefined()) {
     result.set(false);
   } else if (a.is_string() && b.is_string()) {
@@ -2031,7 +2315,14 @@ bool LessThan::eval(Context &ctx, Value &result) {
     auto nb = b.to_number();
     result.set(na < nb);
   }
-  return true;
+}
+
+void LessThan::compile(Bytecode::Compiler &c, int r) {
+  auto a = m_a->operand(c);
+  auto b = m_b->operand(c);
+  c.emit(Bytecode::OpCode::LT, r, a, b);
+  c.release(b);
+  c.release(a);
 }
 
 bool LessThan::declare(Module *module, Scope &scope, Error &error) {
@@ -2059,6 +2350,11 @@ bool LessThanOrEqual::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void LessThanOrEqual::operate(const Value &a, const Value &b, Value &result) {
   if (a.is_undefined() || b.is_undefined()) {
     result.set(false);
   } else if (a.is_string() && b.is_string()) {
@@ -2074,7 +2370,14 @@ bool LessThanOrEqual::eval(Context &ctx, Value &result) {
     auto nb = b.to_number();
     result.set(na <= nb);
   }
-  return true;
+}
+
+void LessThanOrEqual::compile(Bytecode::Compiler &c, int r) {
+  auto a = m_a->operand(c);
+  auto b = m_b->operand(c);
+  c.emit(Bytecode::OpCode::LE, r, a, b);
+  c.release(b);
+  c.release(a);
 }
 
 bool LessThanOrEqual::declare(Module *module, Scope &scope, Error &error) {
@@ -2929,6 +3232,18 @@ bool Conditional::eval(Context &ctx, Value &result) {
   }
 }
 
+void Conditional::compile(Bytecode::Compiler &c, int r) {
+  auto cond = c.alloc();
+  m_a->compile(c, cond);
+  auto j1 = c.emit(Bytecode::OpCode::JMPF, cond);
+  c.free();
+  m_b->compile(c, r);
+  auto j2 = c.emit(Bytecode::OpCode::JMP);
+  c.patch(j1, c.label());
+  m_c->compile(c, r);
+  c.patch(j2, c.label());
+}
+
 bool Conditional::declare(Module *module, Scope &scope, Error &error) {
   if (!m_a->declare(module, scope, error)) return false;
   if (!m_b->declare(module, scope, error)) return false;
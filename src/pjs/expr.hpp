@@ -29,6 +29,7 @@
 #include "types.hpp"
 #include "tree.hpp"
 #include "builtin.hpp"
+#include "bytecode.hpp"
 
 #include <cmath>
 #include <string>
@@ -159,6 +160,8 @@ public:
   virtual void unpack(std::vector<Ref<Str>> &vars) const {}
   virtual bool unpack(Context &ctx, Value &arg, int &var) { return true; }
   virtual bool eval(Context &ctx, Value &result) = 0;
+  virtual void compile(Bytecode::Compiler &c, int r) { c.emit(Bytecode::OpCode::EVAL, r, c.expr(this)); }
+  virtual auto operand(Bytecode::Compiler &c) -> int { auto r = c.alloc(); compile(c, r); return r; }
   virtual bool assign(Context &ctx, Value &value) { return error(ctx, "cannot assign to a right-value"); }
   virtual bool clear(Context &ctx, Value &result) { return error(ctx, "cannot delete a value"); }
   virtual auto reduce(Reducer &r) -> Reducer::Value* { return r.undefined(); }
@@ -254,6 +257,8 @@ private:
 class Undefined : public Expr {
 public:
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+  virtual auto operand(Bytecode::Compiler &c) -> int override;
   virtual auto reduce(Reducer &r) -> Reducer::Value* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 };
@@ -265,6 +270,8 @@ public:
 class Null : public Expr {
 public:
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+  virtual auto operand(Bytecode::Compiler &c) -> int override;
   virtual auto reduce(Reducer &r) -> Reducer::Value* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 };
@@ -278,6 +285,8 @@ public:
   BooleanLiteral(bool b) : m_b(b) {}
 
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+  virtual auto operand(Bytecode::Compiler &c) -> int override;
   virtual auto reduce(Reducer &r) -> Reducer::Value* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
@@ -294,6 +303,8 @@ public:
   NumberLiteral(double n) : m_n(n) {}
 
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+  virtual auto operand(Bytecode::Compiler &c) -> int override;
   virtual auto reduce(Reducer &r) -> Reducer::Value* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
@@ -312,6 +323,8 @@ public:
   auto s() const -> Str* { return m_s; }
 
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+  virtual auto operand(Bytecode::Compiler &c) -> int override;
   virtual auto reduce(Reducer &r) -> Reducer::Value* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
@@ -406,6 +419,7 @@ public:
 private:
   std::vector<std::unique_ptr<Expr>> m_inputs;
   std::unique_ptr<Stmt> m_output;
+  std::unique_ptr<Bytecode> m_bytecode;
   Scope m_scope;
   Ref<Method> m_method;
 };
@@ -498,6 +512,8 @@ public:
 
   virtual bool is_left_value() const override;
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+  virtual auto operand(Bytecode::Compiler &c) -> int override;
   virtual bool assign(Context &ctx, Value &value) override;
   virtual bool clear(Context &ctx, Value &result) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -542,6 +558,8 @@ public:
   virtual void unpack(std::vector<Ref<Str>> &vars) const override;
   virtual bool unpack(Context &ctx, Value &arg, int &var) override;
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+  virtual auto operand(Bytecode::Compiler &c) -> int override;
   virtual bool assign(Context &ctx, Value &value) override;
   virtual bool clear(Context &ctx, Value &result) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
@@ -571,8 +589,11 @@ class Property : public Expr {
 public:
   Property(Expr *obj, Expr *key) : m_obj(obj), m_key(key) {}
 
+  bool get(Context &ctx, const Value &obj, const Value &key, Value &result);
+
   virtual bool is_left_value() const override;
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool assign(Context &ctx, Value &value) override;
   virtual bool clear(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
@@ -594,7 +615,10 @@ class OptionalProperty : public Expr {
 public:
   OptionalProperty(Expr *obj, Expr *key) : m_obj(obj), m_key(key) {}
 
+  bool get(Context &ctx, const Value &obj, const Value &key, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -687,7 +711,10 @@ class Negation : public Expr {
 public:
   Negation(Expr *x) : m_x(x) {}
 
+  static void operate(const Value &x, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -704,7 +731,10 @@ class Addition : public Expr {
 public:
   Addition(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
+  static void operate(const Value &a, const Value &b, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -722,7 +752,10 @@ class Subtraction : public Expr {
 public:
   Subtraction(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
+  static void operate(const Value &a, const Value &b, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -740,7 +773,10 @@ class Multiplication : public Expr {
 public:
   Multiplication(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
+  static void operate(const Value &a, const Value &b, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -758,7 +794,10 @@ class Division : public Expr {
 public:
   Division(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
+  static void operate(const Value &a, const Value &b, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -776,7 +815,10 @@ class Remainder : public Expr {
 public:
   Remainder(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
+  static void operate(const Value &a, const Value &b, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -937,7 +979,10 @@ class LogicalNot : public Expr {
 public:
   LogicalNot(Expr *x) : m_x(x) {}
 
+  static void operate(const Value &x, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -955,6 +1000,7 @@ public:
   LogicalAnd(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -973,6 +1019,7 @@ public:
   LogicalOr(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -991,6 +1038,7 @@ public:
   NullishCoalescing(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -1008,7 +1056,10 @@ class Equality : public Expr {
 public:
   Equality(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
+  static void operate(const Value &a, const Value &b, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -1026,7 +1077,10 @@ class Inequality : public Expr {
 public:
   Inequality(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
+  static void operate(const Value &a, const Value &b, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -1044,7 +1098,10 @@ class Identity : public Expr {
 public:
   Identity(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
+  static void operate(const Value &a, const Value &b, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -1062,7 +1119,10 @@ class Nonidentity : public Expr {
 public:
   Nonidentity(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
+  static void operate(const Value &a, const Value &b, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -1080,7 +1140,10 @@ class GreaterThan : public Expr {
 public:
   GreaterThan(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
+  static void operate(const Value &a, const Value &b, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -1098,7 +1161,10 @@ class GreaterThanOrEqual : public Expr {
 public:
   GreaterThanOrEqual(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
+  static void operate(const Value &a, const Value &b, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -1116,7 +1182,10 @@ class LessThan : public Expr {
 public:
   LessThan(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
+  static void operate(const Value &a, const Value &b, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -1134,7 +1203,10 @@ class LessThanOrEqual : public Expr {
 public:
   LessThanOrEqual(Expr *a, Expr *b) : m_a(a), m_b(b) {}
 
+  static void operate(const Value &a, const Value &b, Value &result);
+
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -1596,6 +1668,7 @@ public:
   Conditional(Expr *a, Expr *b, Expr *c) : m_a(a), m_b(b), m_c(c) {}
 
   virtual bool eval(Context &ctx, Value &result) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
   virtual bool declare(Module *module, Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
@@ -48,6 +48,10 @@ void Stmt::execute(Context &ctx, Value &result) {
   result = res.value;
 }
 
+void Stmt::compile(Bytecode::Compiler &c) {
+  c.emit(Bytecode::OpCode::EXEC, 0, c.stmt(this));
+}
+
 namespace stmt {
 
 thread_local static ConstStr s_default("default");
@@ -89,6 +93,12 @@ void Block::execute(Context &ctx, Result &result) {
   result.set_done();
 }
 
+void Block::compile(Bytecode::Compiler &c) {
+  for (const auto &p : m_stmts) {
+    p->compile(c);
+  }
+}
+
 void Block::dump(std::ostream &out, const std::string &indent) {
   out << indent << "block" << std::endl;
   auto indent_str = indent + "  ";
@@ -144,6 +154,14 @@ void Evaluate::execute(Context &ctx, Result &result) {
   }
 }
 
+void Evaluate::compile(Bytecode::Compiler &c) {
+  if (m_export) {
+    Stmt::compile(c);
+  } else {
+    c.release(m_expr->operand(c));
+  }
+}
+
 void Evaluate::dump(std::ostream &out, const std::string &indent) {
   out << indent << "eval" << std::endl;
   m_expr->dump(out, indent + "  ");
@@ -311,6 +329,22 @@ void If::execute(Context &ctx, Result &result) {
   }
 }
 
+void If::compile(Bytecode::Compiler &c) {
+  auto cond = c.alloc();
+  m_cond->compile(c, cond);
+  auto j1 = c.emit(Bytecode::OpCode::JMPF, cond);
+  c.free();
+  m_then->compile(c);
+  if (m_else) {
+    auto j2 = c.emit(Bytecode::OpCode::JMP);
+    c.patch(j1, c.label());
+    m_else->compile(c);
+    c.patch(j2, c.label());
+  } else {
+    c.patch(j1, c.label());
+  }
+}
+
 void If::dump(std::ostream &out, const std::string &indent) {
   out << indent << "if" << std::endl;
   auto indent_str = indent + "  ";
@@ -454,6 +488,16 @@ void Return::execute(Context &ctx, Result &result) {
   }
 }
 
+void Return::compile(Bytecode::Compiler &c) {
+  if (m_expr) {
+    auto r = m_expr->operand(c);
+    c.emit(Bytecode::OpCode::RET, r);
+    c.release(r);
+  } else {
+    c.emit(Bytecode::OpCode::RET, c.constant(Value::undefined));
+  }
+}
+
 void Return::dump(std::ostream &out, const std::string &indent) {
   out << indent << "return" << std::endl;
   if (m_expr) m_expr->dump(out, indent + "  ");
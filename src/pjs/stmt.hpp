@@ -69,6 +69,7 @@ public:
   virtual ~Stmt();
   virtual bool is_expression() const { return false; }
   virtual void execute(Context &ctx, Result &result) {};
+  virtual void compile(Bytecode::Compiler &c);
   virtual void dump(std::ostream &out, const std::string &indent = "") = 0;
 
   //
@@ -102,6 +103,7 @@ public:
   virtual bool declare(Module *module, Tree::Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) override;
   virtual void execute(Context &ctx, Result &result) override;
+  virtual void compile(Bytecode::Compiler &c) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -138,6 +140,7 @@ public:
   virtual bool declare(Module *module, Tree::Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) override;
   virtual void execute(Context &ctx, Result &result) override;
+  virtual void compile(Bytecode::Compiler &c) override;
   virtual bool declare_export(Module *module, bool is_default, Error &error) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
@@ -206,6 +209,7 @@ public:
   virtual bool declare(Module *module, Tree::Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) override;
   virtual void execute(Context &ctx, Result &result) override;
+  virtual void compile(Bytecode::Compiler &c) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -263,6 +267,7 @@ public:
   virtual bool declare(Module *module, Tree::Scope &scope, Error &error) override;
   virtual void resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) override;
   virtual void execute(Context &ctx, Result &result) override;
+  virtual void compile(Bytecode::Compiler &c) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -272,7 +272,7 @@ auto Str::substring(int start, int end) -> std::string {
 // Str::CharData
 //
 
-Str::CharData::CharData(std::string &&str) : m_str(std::move(str)) {
+Str::CharData::CharData(std::string &&str) : m_str(std::move(str)), m_hash(0) {
   int n = 0, p = 0, i = 0;
   Utf8Decoder decoder(
     [&](int cp) {
@@ -292,6 +292,16 @@ Str::CharData::CharData(std::string &&str) : m_str(std::move(str)) {
   m_length = n;
 }
 
+auto Str::CharData::hash() const -> size_t {
+  auto h = m_hash.load(std::memory_order_relaxed);
+  if (!h) {
+    std::hash<std::string> f;
+    h = f(m_str) | 1;
+    m_hash.store(h, std::memory_order_relaxed);
+  }
+  return h;
+}
+
 auto Str::CharData::pos_to_chr(int i) const -> int {
   int p = 0, n = 0;
   if (i >= size()) return m_length;
@@ -744,10 +754,77 @@ void Class::assign(Object *obj, Object *src) {
   }
 }
 
+//
+// Shape
+//
+
+thread_local Ref<Shape> Shape::s_root;
+
+auto Shape::root() -> Shape* {
+  if (!s_root) s_root = new Shape();
+  return s_root;
+}
+
+Shape::Shape(Shape *parent, Str *key)
+  : m_parent(parent)
+  , m_key(key)
+  , m_keys(parent->m_keys)
+{
+  auto i = m_keys.size();
+  m_keys.push_back(key);
+  if (parent->m_index) {
+    m_index.reset(new std::unordered_map<Str*, int>(*parent->m_index));
+    (*m_index)[key] = i;
+  } else if (m_keys.size() > INDEX_THRESHOLD) {
+    m_index.reset(new std::unordered_map<Str*, int>);
+    for (size_t i = 0; i < m_keys.size(); i++) (*m_index)[m_keys[i]] = i;
+  }
+}
+
+Shape::~Shape() {
+  if (m_parent) m_parent->m_transitions.erase(m_key);
+}
+
+auto Shape::add(Str *key) -> Shape* {
+  auto i = m_transitions.find(key);
+  if (i != m_transitions.end()) return i->second;
+  auto s = new Shape(this, key);
+  m_transitions[key] = s;
+  return s;
+}
+
 //
 // Object
 //
 
+void Object::ht_grow(size_t size) {
+  size_t capacity = 4;
+  while (capacity < size) capacity <<= 1;
+  auto slots = Data::make(capacity);
+  if (auto old = m_slots) {
+    for (int i = 0, n = m_shape->size(); i < n; i++) {
+      slots->at(i) = old->at(i);
+    }
+    old->free();
+  }
+  m_slots = slots;
+}
+
+void Object::ht_to_dictionary() {
+  auto hash = OrderedHash<Ref<Str>, Value>::make();
+  if (auto shape = m_shape.get()) {
+    for (int i = 0, n = shape->size(); i < n; i++) {
+      hash->set(shape->key(i), m_slots->at(i));
+    }
+  }
+  if (m_slots) {
+    m_slots->free();
+    m_slots = nullptr;
+  }
+  m_shape = nullptr;
+  m_hash = hash;
+}
+
 template<> void ClassDef<Object>::init() {
   method("toString", [](Context &ctx, Object *obj, Value &ret) { ret.set(obj->to_string()); });
   method("valueOf", [](Context &ctx, Object *obj, Value &ret) { obj->value_of(ret); });
@@ -512,14 +512,12 @@ public:
     Pool(size_t alloc_size)
       : m_alloc_size(alloc_size) {}
 
-    auto alloc() -> PooledArrayBase* {
+    auto alloc() -> void* {
       if (auto p = m_free) {
         m_free = p->m_next;
         return p;
       } else {
-        p = (PooledArrayBase*)std::malloc(m_alloc_size);
-        p->m_pool = this;
-        return p;
+        return std::malloc(m_alloc_size);
       }
     }
 
@@ -537,6 +535,9 @@ public:
     m_pool->free(this);
   }
 
+protected:
+  PooledArrayBase(Pool *pool) : m_pool(pool) {}
+
 private:
   Pool* m_pool;
   PooledArrayBase* m_next;
@@ -550,15 +551,13 @@ template<class T>
 class PooledArray : public PooledArrayBase {
 public:
   static auto make(size_t size) -> PooledArray* {
-    auto p = alloc(size);
-    new (p) PooledArray(size);
-    return p;
+    auto pool = pool_of(size);
+    return new (pool->alloc()) PooledArray(pool, size);
   }
 
   static auto make(size_t size, const T &initial) -> PooledArray* {
-    auto p = alloc(size);
-    new (p) PooledArray(size, initial);
-    return p;
+    auto pool = pool_of(size);
+    return new (pool->alloc()) PooledArray(pool, size, initial);
   }
 
   void free() {
@@ -586,13 +585,13 @@ private:
   size_t m_size;
   T m_elements[0];
 
-  PooledArray(size_t size) : m_size(size) {
+  PooledArray(Pool *pool, size_t size) : PooledArrayBase(pool), m_size(size) {
     for (size_t i = 0; i < size; i++) {
       new (m_elements + i) T();
     }
   }
 
-  PooledArray(size_t size, const T &initial) : m_size(size) {
+  PooledArray(Pool *pool, size_t size, const T &initial) : PooledArrayBase(pool), m_size(size) {
     for (size_t i = 0; i < size; i++) {
       new (m_elements + i) T(initial);
     }
@@ -604,13 +603,13 @@ private:
     }
   }
 
-  static auto alloc(size_t size) -> PooledArray* {
+  static auto pool_of(size_t size) -> Pool* {
     auto &pools = m_pools;
     auto slot = slot_of_size(size);
     for (auto i = pools.size(); i <= slot; i++) {
       pools.emplace_back(new Pool(sizeof(PooledArray) + sizeof(T) * size_of_slot(i)));
     }
-    return static_cast<PooledArray*>(pools[slot]->alloc());
+    return pools[slot].get();
   }
 
   static auto slot_of_size(size_t size) -> size_t {
@@ -803,6 +802,7 @@ public:
     auto c_str() const -> const char * { return m_str.c_str(); }
     auto size() const -> size_t { return m_str.length(); }
     auto length() const -> int { return m_length; }
+    auto hash() const -> size_t;
 
     auto pos_to_chr(int i) const -> int;
     auto chr_to_pos(int i) const -> int;
@@ -817,6 +817,7 @@ public:
     const std::string m_str;
     int m_length;
     std::vector<uint32_t> m_chunks;
+    mutable std::atomic<size_t> m_hash;
 
     friend class RefCountMT<CharData>;
     friend class Str;
@@ -1737,6 +1738,49 @@ namespace pjs {
 
 typedef PooledArray<Value> Data;
 
+//
+// Shape
+//
+
+class Shape : public Pooled<Shape>, public RefCount<Shape> {
+public:
+  static const int MAX_SIZE = 32;
+
+  static auto root() -> Shape*;
+
+  auto size() const -> int { return m_keys.size(); }
+  auto key(int i) const -> Str* { return m_keys[i]; }
+  auto add(Str *key) -> Shape*;
+
+  auto find(Str *key) const -> int {
+    if (m_index) {
+      auto i = m_index->find(key);
+      return i == m_index->end() ? -1 : i->second;
+    }
+    for (int i = 0, n = m_keys.size(); i < n; i++) {
+      if (m_keys[i] == key) return i;
+    }
+    return -1;
+  }
+
+private:
+  enum { INDEX_THRESHOLD = 8 };
+
+  Shape() {}
+  Shape(Shape *parent, Str *key);
+  ~Shape();
+
+  Ref<Shape> m_parent;
+  Ref<Str> m_key;
+  std::vector<Str*> m_keys;
+  std::unique_ptr<std::unordered_map<Str*, int>> m_index;
+  std::unordered_map<Str*, Shape*> m_transitions;
+
+  thread_local static Ref<Shape> s_root;
+
+  friend class RefCount<Shape>;
+};
+
 //
 // Object
 //
@@ -1758,6 +1802,7 @@ public:
   auto type() const -> Class* { return m_class; }
   auto data() const -> Data* { return m_data; }
   auto location() const -> const Location& { return m_location; }
+  bool is_lazy() const { return m_lazy; }
 
   template<class T> auto as() -> T* { return static_cast<T*>(this); }
   template<class T> auto as() const -> const T* { return static_cast<const T*>(this); }
@@ -1771,8 +1816,10 @@ public:
   bool has(Str *key);
   bool get(Str *key, Value &val);
   void set(Str *key, const Value &val);
-  auto ht_size() const -> size_t { return m_hash ? m_hash->size() : 0; }
-  bool ht_has(Str *key) { return m_hash ? m_hash->has(key) : false; }
+  auto shape() const -> Shape* { return m_shape; }
+  auto slots() const -> Data* { return m_slots; }
+  auto ht_size() -> size_t { if (m_lazy) ht_materialize(); return m_shape ? m_shape->size() : m_hash ? m_hash->size() : 0; }
+  bool ht_has(Str *key);
   bool ht_get(Str *key, Value &val);
   void ht_set(Str *key, const Value &val);
   bool ht_delete(Str *key);
@@ -1836,19 +1883,34 @@ protected:
 
   ~Object() {
     assert_same_thread(*this);
+    if (m_slots) m_slots->free();
     if (m_class) m_class->free(this);
   }
 
   virtual void finalize() { delete this; }
 
+  // Lookups on a lazy object go to lazy_get() until the first
+  // write or enumeration, which calls lazy_materialize() once
+
+  void set_lazy() { m_lazy = true; }
+  virtual bool lazy_get(Str *key, Value &val) { return false; }
+  virtual void lazy_materialize() {}
+  void ht_materialize() { m_lazy = false; lazy_materialize(); }
+
 private:
+  void ht_grow(size_t size);
+  void ht_to_dictionary();
+
   Class* m_class = nullptr;
   Data* m_data = nullptr;
+  Ref<Shape> m_shape;
+  Data* m_slots = nullptr;
   Ref<OrderedHash<Ref<Str>, Value>> m_hash;
   Location m_location;
   Object* m_class_prev = nullptr;
   Object* m_class_next = nullptr;
   bool m_traced = false;
+  bool m_lazy = false;
 
 #ifdef PIPY_ASSERT_SAME_THREAD
   std::thread::id m_thread_id;
@@ -2019,6 +2081,14 @@ inline auto Class::init(Object *obj, Object *prototype) -> Object* {
       data->at(i) = prototype->data()->at(i);
     }
     obj->m_hash = prototype->m_hash;
+    if (auto shape = prototype->m_shape.get()) {
+      auto slots = Data::make(prototype->m_slots->size());
+      for (int i = 0, n = shape->size(); i < n; i++) {
+        slots->at(i) = prototype->m_slots->at(i);
+      }
+      obj->m_shape = shape;
+      obj->m_slots = slots;
+    }
   } else {
     for (size_t i = 0; i < size; i++) {
       auto v = m_variables[i];
@@ -2053,23 +2123,63 @@ inline bool Object::has(Str *key) {
   else return ht_has(key);
 }
 
+inline bool Object::ht_has(Str *key) {
+  if (m_lazy) {
+    Value val;
+    return lazy_get(key, val);
+  }
+  return m_shape ? m_shape->find(key) >= 0 : m_hash ? m_hash->has(key) : false;
+}
+
 inline bool Object::ht_get(Str *key, Value &val) {
   assert_same_thread(*this);
-  if (!m_hash || !m_hash->get(key, val)) {
+  if (m_lazy) {
+    if (lazy_get(key, val)) return true;
     val = Value::undefined;
     return false;
   }
-  return true;
+  if (auto shape = m_shape.get()) {
+    auto i = shape->find(key);
+    if (i >= 0) {
+      val = m_slots->at(i);
+      return true;
+    }
+  } else if (m_hash && m_hash->get(key, val)) {
+    return true;
+  }
+  val = Value::undefined;
+  return false;
 }
 
 inline void Object::ht_set(Str *key, const Value &val) {
   assert_same_thread(*this);
-  if (!m_hash) m_hash = OrderedHash<Ref<Str>, Value>::make();
+  if (m_lazy) ht_materialize();
+  if (!m_hash) {
+    auto shape = m_shape ? m_shape.get() : Shape::root();
+    auto i = shape->find(key);
+    if (i >= 0) {
+      m_slots->at(i) = val;
+      return;
+    }
+    i = shape->size();
+    if (i < Shape::MAX_SIZE) {
+      if (!m_slots || size_t(i) >= m_slots->size()) ht_grow(i + 1);
+      m_slots->at(i) = val;
+      m_shape = shape->add(key);
+      return;
+    }
+    ht_to_dictionary();
+  }
   m_hash->set(key, val);
 }
 
 inline bool Object::ht_delete(Str *key) {
   assert_same_thread(*this);
+  if (m_lazy) ht_materialize();
+  if (m_shape) {
+    if (m_shape->find(key) < 0) return false;
+    ht_to_dictionary();
+  }
   if (!m_hash) return false;
   return m_hash->erase(key);
 }
@@ -2087,12 +2197,10 @@ inline void Object::iterate_all(const std::function<void(Str*, Value&)> &callbac
       callback(f->name(), m_data->at(static_cast<Variable*>(f)->index()));
     }
   }
-  if (m_hash) {
-    OrderedHash<Ref<Str>, Value>::Iterator iterator(m_hash);
-    while (auto *ent = iterator.next()) {
-      callback(ent->k, ent->v);
-    }
-  }
+  iterate_hash([&](Str *key, Value &val) {
+    callback(key, val);
+    return true;
+  });
 }
 
 inline bool Object::iterate_while(const std::function<bool(Str*, Value&)> &callback) {
@@ -2113,7 +2221,24 @@ inline bool Object::iterate_while(const std::function<bool(Str*, Value&)> &callb
 
 inline bool Object::iterate_hash(const std::function<bool(Str*, Value&)> &callback) {
   assert_same_thread(*this);
-  if (m_hash) {
+  if (m_lazy) ht_materialize();
+  if (m_shape) {
+    Ref<Shape> shape;
+    int i = 0;
+    while (m_shape && i < m_shape->size()) {
+      shape = m_shape;
+      if (!callback(shape->key(i), m_slots->at(i))) return false;
+      i++;
+    }
+    if (m_hash) {
+      OrderedHash<Ref<Str>, Value>::Iterator iterator(m_hash);
+      while (auto *ent = iterator.next()) {
+        auto j = shape->find(ent->k);
+        if (0 <= j && j < i) continue;
+        if (!callback(ent->k, ent->v)) return false;
+      }
+    }
+  } else if (m_hash) {
     OrderedHash<Ref<Str>, Value>::Iterator iterator(m_hash);
     while (auto *ent = iterator.next()) {
       if (!callback(ent->k, ent->v)) {
@@ -3277,7 +3402,8 @@ public:
   bool has(Object *obj, Str *key) {
     auto i = find(obj->type(), key);
     if (i >= 0) return true;
-    else return obj->ht_has(key);
+    if (auto shape = obj->shape()) return find_slot(shape, key) >= 0;
+    return obj->ht_has(key);
   }
 
   bool del(Object *obj, Str *key) {
@@ -3304,6 +3430,11 @@ public:
       val = obj->data()->at(static_cast<Variable*>(f)->index());
       return;
     }
+    if (auto shape = obj->shape()) {
+      auto j = find_slot(shape, key);
+      if (j >= 0) val = obj->slots()->at(j); else val = Value::undefined;
+      return;
+    }
     obj->ht_get(key, val);
   }
 
@@ -3321,14 +3452,49 @@ public:
         return;
       }
     }
+    if (auto shape = obj->shape()) {
+      auto j = find_slot(shape, key);
+      if (j >= 0) {
+        obj->slots()->at(j) = val;
+        return;
+      }
+    }
     obj->ht_set(key, val);
   }
 
 private:
+  enum { MAX_SHAPES = 4 };
+
+  struct ShapeSlot {
+    Ref<Shape> shape;
+    int index;
+  };
+
   Ref<Str> m_const_key;
   Ref<Str> m_key;
   Ref<Class> m_class;
   int m_index = -1;
+  Ref<Str> m_slot_key;
+  ShapeSlot m_slots[MAX_SHAPES];
+  int m_slot_count = 0;
+
+  int find_slot(Shape *shape, Str *key) {
+    if (key != m_slot_key) {
+      m_slot_key = key;
+      m_slot_count = 0;
+    }
+    for (int i = 0; i < m_slot_count; i++) {
+      const auto &s = m_slots[i];
+      if (s.shape == shape) return s.index;
+    }
+    auto i = shape->find(key);
+    if (m_slot_count < MAX_SHAPES) {
+      auto &s = m_slots[m_slot_count++];
+      s.shape = shape;
+      s.index = i;
+    }
+    return i;
+  }
 
   int find(Class *type, Str *key) {
     auto i = m_index;
@@ -0,0 +1,262 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "simd.hpp"
+
+#include <cctype>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIPY_SIMD_X86
+#include <immintrin.h>
+#if defined(__GNUC__)
+#define PIPY_SIMD_AVX2
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define PIPY_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+namespace pipy {
+namespace simd {
+
+//
+// Scalar
+//
+
+static auto find_scalar(const char *p, size_t n, char c) -> size_t {
+  auto q = (const char *)std::memchr(p, c, n);
+  return q ? q - p : n;
+}
+
+static auto find2_scalar(const char *p, size_t n, char a, char b) -> size_t {
+  for (size_t i = 0; i < n; i++) {
+    auto c = p[i];
+    if (c == a || c == b) return i;
+  }
+  return n;
+}
+
+static void to_lower_scalar(const char *src, char *dst, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    auto c = src[i];
+    dst[i] = ('A' <= c && c <= 'Z') ? c + ('a' - 'A') : c;
+  }
+}
+
+#ifdef PIPY_SIMD_X86
+
+static inline auto ctz(unsigned int x) -> unsigned int {
+#ifdef _MSC_VER
+  unsigned long i;
+  _BitScanForward(&i, x);
+  return i;
+#else
+  return __builtin_ctz(x);
+#endif
+}
+
+//
+// SSE2
+//
+
+static auto find_sse2(const char *p, size_t n, char c) -> size_t {
+  auto v = _mm_set1_epi8(c);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto x = _mm_loadu_si128((const __m128i *)(p + i));
+    if (auto m = _mm_movemask_epi8(_mm_cmpeq_epi8(x, v))) return i + ctz(m);
+  }
+  return i + find_scalar(p + i, n - i, c);
+}
+
+static auto find2_sse2(const char *p, size_t n, char a, char b) -> size_t {
+  auto va = _mm_set1_epi8(a);
+  auto vb = _mm_set1_epi8(b);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto x = _mm_loadu_si128((const __m128i *)(p + i));
+    auto m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)));
+    if (m) return i + ctz(m);
+  }
+  return i + find2_scalar(p + i, n - i, a, b);
+}
+
+static void to_lower_sse2(const char *src, char *dst, size_t n) {
+  auto lo = _mm_set1_epi8('A' - 1);
+  auto hi = _mm_set1_epi8('Z' + 1);
+  auto d = _mm_set1_epi8('a' - 'A');
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto x = _mm_loadu_si128((const __m128i *)(src + i));
+    auto m = _mm_and_si128(_mm_cmpgt_epi8(x, lo), _mm_cmplt_epi8(x, hi));
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_add_epi8(x, _mm_and_si128(m, d)));
+  }
+  to_lower_scalar(src + i, dst + i, n - i);
+}
+
+#ifdef PIPY_SIMD_AVX2
+
+//
+// AVX2
+//
+
+__attribute__((target("avx2")))
+static auto find_avx2(const char *p, size_t n, char c) -> size_t {
+  auto v = _mm256_set1_epi8(c);
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    auto x = _mm256_loadu_si256((const __m256i *)(p + i));
+    if (auto m = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, v))) return i + ctz(m);
+  }
+  return i + find_sse2(p + i, n - i, c);
+}
+
+__attribute__((target("avx2")))
+static auto find2_avx2(const char *p, size_t n, char a, char b) -> size_t {
+  auto va = _mm256_set1_epi8(a);
+  auto vb = _mm256_set1_epi8(b);
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    auto x = _mm256_loadu_si256((const __m256i *)(p + i));
+    auto m = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, va), _mm256_cmpeq_epi8(x, vb)));
+    if (m) return i + ctz(m);
+  }
+  return i + find2_sse2(p + i, n - i, a, b);
+}
+
+__attribute__((target("avx2")))
+static void to_lower_avx2(const char *src, char *dst, size_t n) {
+  auto lo = _mm256_set1_epi8('A' - 1);
+  auto hi = _mm256_set1_epi8('Z' + 1);
+  auto d = _mm256_set1_epi8('a' - 'A');
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    auto x = _mm256_loadu_si256((const __m256i *)(src + i));
+    auto m = _mm256_and_si256(_mm256_cmpgt_epi8(x, lo), _mm256_cmpgt_epi8(hi, x));
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_add_epi8(x, _mm256_and_si256(m, d)));
+  }
+  to_lower_sse2(src + i, dst + i, n - i);
+}
+
+#endif // PIPY_SIMD_AVX2
+#endif // PIPY_SIMD_X86
+
+#ifdef PIPY_SIMD_NEON
+
+//
+// NEON
+//
+
+static inline auto first_set(uint8x16_t m) -> int {
+  auto bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+  return bits ? __builtin_ctzll(bits) >> 2 : -1;
+}
+
+static auto find_neon(const char *p, size_t n, char c) -> size_t {
+  auto v = vdupq_n_u8(c);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto x = vld1q_u8((const uint8_t *)(p + i));
+    auto k = first_set(vceqq_u8(x, v));
+    if (k >= 0) return i + k;
+  }
+  return i + find_scalar(p + i, n - i, c);
+}
+
+static auto find2_neon(const char *p, size_t n, char a, char b) -> size_t {
+  auto va = vdupq_n_u8(a);
+  auto vb = vdupq_n_u8(b);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto x = vld1q_u8((const uint8_t *)(p + i));
+    auto k = first_set(vorrq_u8(vceqq_u8(x, va), vceqq_u8(x, vb)));
+    if (k >= 0) return i + k;
+  }
+  return i + find2_scalar(p + i, n - i, a, b);
+}
+
+static void to_lower_neon(const char *src, char *dst, size_t n) {
+  auto a = vdupq_n_u8('A');
+  auto r = vdupq_n_u8('Z' - 'A');
+  auto d = vdupq_n_u8('a' - 'A');
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto x = vld1q_u8((const uint8_t *)(src + i));
+    auto m = vcleq_u8(vsubq_u8(x, a), r);
+    vst1q_u8((uint8_t *)(dst + i), vaddq_u8(x, vandq_u8(m, d)));
+  }
+  to_lower_scalar(src + i, dst + i, n - i);
+}
+
+#endif // PIPY_SIMD_NEON
+
+//
+// Dispatch
+//
+
+struct Functions {
+  const char *isa;
+  auto (*find)(const char *p, size_t n, char c) -> size_t;
+  auto (*find2)(const char *p, size_t n, char a, char b) -> size_t;
+  void (*to_lower)(const char *src, char *dst, size_t n);
+};
+
+static auto select() -> Functions {
+#if defined(PIPY_SIMD_AVX2)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return { "avx2", find_avx2, find2_avx2, to_lower_avx2 };
+  }
+#endif
+#if defined(PIPY_SIMD_X86)
+  return { "sse2", find_sse2, find2_sse2, to_lower_sse2 };
+#elif defined(PIPY_SIMD_NEON)
+  return { "neon", find_neon, find2_neon, to_lower_neon };
+#else
+  return { "scalar", find_scalar, find2_scalar, to_lower_scalar };
+#endif
+}
+
+static const Functions s_functions = select();
+
+auto find(const char *p, size_t n, char c) -> size_t {
+  return s_functions.find(p, n, c);
+}
+
+auto find(const char *p, size_t n, char a, char b) -> size_t {
+  return s_functions.find2(p, n, a, b);
+}
+
+void to_lower(const char *src, char *dst, size_t n) {
+  s_functions.to_lower(src, dst, n);
+}
+
+auto isa() -> const char* {
+  return s_functions.isa;
+}
+
+} // namespace simd
+} // namespace pipy
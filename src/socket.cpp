@@ -28,6 +28,13 @@
 
 #include <errno.h>
 
+#ifdef __linux__
+#include <fcntl.h>
+#include <netinet/udp.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif // __linux__
+
 namespace pipy {
 
 using tcp = asio::ip::tcp;
@@ -69,6 +76,15 @@ void SocketBase::log_error(const char *msg, const std::error_code &ec) {
   }
 }
 
+auto SocketBase::next_timeout(double tick_read, double tick_write) const -> double {
+  double t = 0;
+  auto earliest = [&](double d) { if (t == 0 || d < t) t = d; };
+  if (m_options.idle_timeout > 0) earliest(std::max(tick_read, tick_write) + m_options.idle_timeout);
+  if (m_options.read_timeout > 0) earliest(tick_read + m_options.read_timeout);
+  if (m_options.write_timeout > 0) earliest(tick_read + m_options.write_timeout);
+  return t;
+}
+
 void SocketBase::log_error(const char *msg) {
   if (Log::is_enabled(Log::ERROR)) {
     char desc[1000];
@@ -84,7 +100,26 @@ void SocketBase::log_error(const char *msg) {
 Data::Producer SocketTCP::s_dp("TCP Socket");
 
 SocketTCP::~SocketTCP() {
-  Ticker::get()->unwatch(this);
+#ifdef __linux__
+  splice_unlink();
+#endif
+}
+
+void SocketTCP::splice(SocketTCP *peer) {
+#ifdef __linux__
+  if (peer == this) return;
+  if (m_splice_peer || peer->m_splice_peer) return;
+  m_splice_peer = peer;
+  peer->m_splice_peer = this;
+  log_debug("spliced with peer");
+#endif // __linux__
+}
+
+void SocketTCP::schedule_timeout() {
+  auto t = next_timeout(m_tick_read, m_tick_write);
+  if (t > 0) {
+    TimerWheel::current()->schedule(this, t - Ticker::get()->tick());
+  }
 }
 
 void SocketTCP::open() {
@@ -107,7 +142,7 @@ void SocketTCP::open() {
   }
 
   receive();
-  Ticker::get()->watch(this);
+  schedule_timeout();
 }
 
 void SocketTCP::output(Event *evt) {
@@ -147,7 +182,34 @@ void SocketTCP::receive() {
   if (m_receiving) return;
   if (m_paused) return;
 
-  m_buffer_receive.push(Data(RECEIVE_BUFFER_SIZE, &s_dp));
+#ifdef __linux__
+  if (receive_splice()) {
+    m_receiving = true;
+    return;
+  }
+#endif
+
+  m_receive_requested = m_receive_size;
+
+#ifdef PIPY_USE_IO_URING
+  if (receive_uring()) {
+    m_receiving = true;
+    return;
+  }
+#endif
+
+#ifdef __linux__
+  if (!m_receive_more) {
+    m_socket.async_wait(
+      tcp::socket::wait_read,
+      ReceiveReadyHandler(this)
+    );
+    m_receiving = true;
+    return;
+  }
+#endif
+
+  m_buffer_receive.push(Data(m_receive_requested, &s_dp));
   m_socket.async_read_some(
     DataChunks(m_buffer_receive.chunks()),
     ReceiveHandler(this)
@@ -182,6 +244,20 @@ void SocketTCP::send() {
     std::cerr << m_buffer_send.size() << std::endl;
   }
 
+#ifdef __linux__
+  if (send_file()) {
+    m_sending = true;
+    return;
+  }
+#endif
+
+#ifdef PIPY_USE_IO_URING
+  if (send_uring()) {
+    m_sending = true;
+    return;
+  }
+#endif
+
   m_socket.async_write_some(
     DataChunks(m_buffer_send.chunks()),
     SendHandler(this)
@@ -190,6 +266,150 @@ void SocketTCP::send() {
   m_sending = true;
 }
 
+#ifdef PIPY_USE_IO_URING
+
+bool SocketTCP::receive_uring() {
+  auto *ring = IOUring::current();
+  if (!ring) return false;
+  m_buffer_receive.push(Data(m_receive_requested, &s_dp));
+  auto buf = *m_buffer_receive.chunks().begin();
+  m_receive_requested = std::get<1>(buf);
+  ring->recv(
+    m_socket.native_handle(),
+    std::get<0>(buf),
+    std::get<1>(buf),
+    &m_receive_request
+  );
+  return true;
+}
+
+bool SocketTCP::send_uring() {
+  auto *ring = IOUring::current();
+  if (!ring) return false;
+  int n = 0;
+  for (const auto &c : m_buffer_send.chunks()) {
+    auto &iov = m_send_iovecs[n++];
+    iov.iov_base = std::get<0>(c);
+    iov.iov_len = std::get<1>(c);
+    if (n == MAX_SEND_IOVECS) break;
+  }
+  std::memset(&m_send_msg, 0, sizeof(m_send_msg));
+  m_send_msg.msg_iov = m_send_iovecs;
+  m_send_msg.msg_iovlen = n;
+  ring->send(m_socket.native_handle(), &m_send_msg, &m_send_request);
+  return true;
+}
+
+#endif // PIPY_USE_IO_URING
+
+#ifdef __linux__
+
+bool SocketTCP::is_splice_writable() const {
+  if (m_state != OPEN && m_state != HALF_CLOSED_REMOTE) return false;
+  return !m_eos;
+}
+
+bool SocketTCP::receive_splice() {
+  if (!m_splice_peer) return false;
+  if (!m_splice_peer->is_splice_writable()) return false;
+  if (!m_splicer) m_splicer.reset(new Splicer(this));
+  return m_splicer->start();
+}
+
+void SocketTCP::splice_unlink() {
+  if (auto *peer = m_splice_peer) {
+    m_splice_peer = nullptr;
+    peer->m_splice_peer = nullptr;
+    if (auto *s = peer->m_splicer.get()) s->unlink();
+  }
+}
+
+//
+// File-backed data at the head of the send buffer goes out with sendfile().
+// Buffered bytes in front of it, such as a message head, are written on
+// their own first so that the file data never gets copied through writev.
+//
+
+bool SocketTCP::send_file() {
+  int fd;
+  size_t offset;
+  if (m_buffer_send.file_head(fd, offset)) {
+    m_socket.async_wait(tcp::socket::wait_write, SendFileHandler(this));
+    return true;
+  }
+
+  if (m_buffer_send.file_ahead(MAX_SEND_VIEWS) <= 0) return false;
+
+  auto chunk = *m_buffer_send.chunks().begin();
+  m_socket.async_write_some(
+    asio::buffer(std::get<0>(chunk), std::get<1>(chunk)),
+    SendHandler(this)
+  );
+  return true;
+}
+
+void SocketTCP::on_send_file(const std::error_code &ec) {
+  int fd;
+  size_t offset;
+  size_t size = 0;
+  if (!ec && m_state != CLOSED) size = m_buffer_send.file_head(fd, offset);
+  if (!size) {
+    on_send(ec, 0);
+    return;
+  }
+
+  std::error_code err;
+  if (!m_socket.native_non_blocking()) {
+    m_socket.native_non_blocking(true, err);
+  }
+
+  off_t off = offset;
+  auto n = ::sendfile(m_socket.native_handle(), fd, &off, size);
+  if (n < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      err = std::error_code(errno, std::system_category());
+    }
+    n = 0;
+  } else if (n == 0) {
+    err = std::make_error_code(std::errc::io_error); // file truncated
+  }
+
+  on_send(err, n);
+}
+
+void SocketTCP::on_receive_ready(const std::error_code &ec) {
+  thread_local static char s_buffer[MAX_RECEIVE_SIZE];
+
+  if (ec) {
+    on_receive(ec, 0);
+    return;
+  }
+
+  if (m_state == CLOSED) {
+    on_receive(asio::error::operation_aborted, 0);
+    return;
+  }
+
+  ssize_t n;
+  do {
+    n = ::recv(m_socket.native_handle(), s_buffer, m_receive_requested, MSG_DONTWAIT);
+  } while (n < 0 && errno == EINTR);
+
+  if (n > 0) {
+    m_buffer_receive.push(s_buffer, n, &s_dp);
+    on_receive(std::error_code(), n);
+  } else if (n == 0) {
+    on_receive(asio::error::eof, 0);
+  } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+    m_receiving = false;
+    receive();
+  } else {
+    on_receive(std::error_code(errno, std::system_category()), 0);
+  }
+}
+
+#endif // __linux__
+
 void SocketTCP::shutdown_socket() {
   if (m_socket.is_open()) {
     std::error_code ec;
@@ -203,6 +423,16 @@ void SocketTCP::shutdown_socket() {
 }
 
 void SocketTCP::close_socket() {
+#ifdef __linux__
+  if (m_splicer) m_splicer->cancel();
+  splice_unlink();
+#endif
+#ifdef PIPY_USE_IO_URING
+  if (auto *ring = IOUring::current()) {
+    ring->cancel(&m_receive_request);
+    ring->cancel(&m_send_request);
+  }
+#endif
   if (m_socket.is_open()) {
     std::error_code ec;
     m_socket.close(ec);
@@ -236,7 +466,10 @@ void SocketTCP::on_flush() {
   send();
 }
 
-void SocketTCP::on_tick(double tick) {
+void SocketTCP::on_expire() {
+  if (m_state == CLOSED) return;
+
+  auto tick = Ticker::get()->tick();
   auto r = tick - m_tick_read;
   auto w = tick - m_tick_write;
 
@@ -264,6 +497,8 @@ void SocketTCP::on_tick(double tick) {
       return;
     }
   }
+
+  schedule_timeout();
 }
 
 void SocketTCP::on_receive(const std::error_code &ec, std::size_t n) {
@@ -273,6 +508,9 @@ void SocketTCP::on_receive(const std::error_code &ec, std::size_t n) {
   m_tick_read = Ticker::get()->tick();
 
   if (ec != asio::error::operation_aborted && m_state != CLOSED) {
+    m_receive_more = (n >= m_receive_requested);
+    adapt_receive_size(n);
+
     if (n > 0) {
       m_buffer_receive.pop(m_buffer_receive.size() - n);
       auto size = m_buffer_receive.size();
@@ -317,6 +555,22 @@ void SocketTCP::on_receive(const std::error_code &ec, std::size_t n) {
   close_async();
 }
 
+void SocketTCP::adapt_receive_size(int n) {
+  if (n >= m_receive_size) {
+    m_receive_size = std::min(m_receive_size * 4, int(MAX_RECEIVE_SIZE));
+    m_receive_shrinking = false;
+  } else if (n <= m_receive_size / 2) {
+    if (m_receive_shrinking) {
+      m_receive_size = std::max(m_receive_size / 2, int(MIN_RECEIVE_SIZE));
+      m_receive_shrinking = false;
+    } else {
+      m_receive_shrinking = true;
+    }
+  } else {
+    m_receive_shrinking = false;
+  }
+}
+
 void SocketTCP::on_send(const std::error_code &ec, std::size_t n) {
   m_sending = false;
   m_tick_write = Ticker::get()->tick();
@@ -349,6 +603,10 @@ void SocketTCP::on_send(const std::error_code &ec, std::size_t n) {
             close_socket();
           }
         }
+#ifdef __linux__
+      } else if (auto *peer = m_splice_peer) {
+        if (peer->m_splicer) peer->m_splicer->drain();
+#endif
       }
 
     } else {
@@ -359,20 +617,250 @@ void SocketTCP::on_send(const std::error_code &ec, std::size_t n) {
   close_async();
 }
 
+#ifdef __linux__
+
 //
-// SocketUDP
+// SocketTCP::Splicer
 //
 
-Data::Producer SocketUDP::s_dp("UDP Socket");
+SocketTCP::Splicer::~Splicer() {
+  close_output();
+  close_pipe();
+}
+
+bool SocketTCP::Splicer::start() {
+  if (m_pipe[0] < 0) {
+    if (pipe2(m_pipe, O_NONBLOCK | O_CLOEXEC)) {
+      m_pipe[0] = m_pipe[1] = -1;
+      m_socket->log_warn("cannot create pipe for splicing", std::error_code(errno, std::system_category()));
+      return false;
+    }
+  }
+  m_active = true;
+  wait_input();
+  return true;
+}
 
-SocketUDP::~SocketUDP() {
-  Ticker::get()->unwatch(this);
+void SocketTCP::Splicer::cancel() {
+  if (!m_active) return;
+  close_output();
+  if (m_draining) {
+    m_draining = false;
+    m_active = false;
+    m_socket->m_receiving = false;
+  }
+}
+
+void SocketTCP::Splicer::unlink() {
+  if (!m_active) return;
+  close_output();
+  if (m_draining) {
+    m_draining = false;
+    fall_back();
+  }
+}
+
+void SocketTCP::Splicer::drain() {
+  if (m_draining) {
+    m_draining = false;
+    pump();
+  }
+}
+
+void SocketTCP::Splicer::pump() {
+  auto *socket = m_socket;
+  for (int i = 0; i < MAX_TRANSFERS_PER_WAIT; i++) {
+    auto *peer = socket->m_splice_peer;
+    if (!peer || !peer->is_splice_writable()) {
+      fall_back();
+      return;
+    }
+
+    if (m_pipe_size > 0) {
+      if (peer->m_sending || !peer->m_buffer_send.empty()) {
+        m_draining = true;
+        return;
+      }
+      auto n = ::splice(
+        m_pipe[0], nullptr,
+        peer->m_socket.native_handle(), nullptr,
+        m_pipe_size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK
+      );
+      if (n > 0) {
+        m_pipe_size -= n;
+        peer->m_traffic_write += n;
+        peer->m_tick_write = Ticker::get()->tick();
+        continue;
+      }
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0 && errno == EAGAIN) {
+        wait_output();
+        return;
+      }
+      std::error_code ec(n < 0 ? errno : EPIPE, std::system_category());
+      peer->log_warn("error writing to peer", ec);
+      peer->m_state = CLOSED;
+      peer->close_socket();
+      peer->close_async();
+      fall_back();
+      return;
+    }
+
+    if (socket->m_paused) {
+      m_active = false;
+      socket->m_receiving = false;
+      socket->close_async();
+      return;
+    }
+
+    auto n = ::splice(
+      socket->m_socket.native_handle(), nullptr,
+      m_pipe[1], nullptr,
+      PIPE_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK
+    );
+    if (n > 0) {
+      m_pipe_size += n;
+      socket->m_traffic_read += n;
+      socket->m_tick_read = Ticker::get()->tick();
+      if (Log::is_enabled(Log::TCP)) {
+        std::cerr << Log::format_elapsed_time();
+        std::cerr << (socket->m_is_inbound ? " tcp >>>> splice " : " tcp splice <<<< ");
+        std::cerr << n << std::endl;
+      }
+      continue;
+    }
+    if (n == 0) {
+      end(asio::error::eof);
+      return;
+    }
+    if (errno == EINTR) continue;
+    if (errno == EAGAIN) {
+      wait_input();
+      return;
+    }
+    end(std::error_code(errno, std::system_category()));
+    return;
+  }
+
+  if (m_pipe_size > 0) {
+    wait_output();
+  } else {
+    wait_input();
+  }
+}
+
+void SocketTCP::Splicer::wait_input() {
+  m_socket->m_socket.async_wait(
+    tcp::socket::wait_read,
+    InputHandler(this)
+  );
+}
+
+void SocketTCP::Splicer::wait_output() {
+  if (!m_output.is_open()) {
+    std::error_code ec;
+    auto fd = ::dup(m_socket->m_splice_peer->m_socket.native_handle());
+    if (fd >= 0) {
+      m_output.assign(fd, ec);
+      if (ec) ::close(fd);
+    }
+    if (fd < 0 || ec) {
+      fall_back();
+      return;
+    }
+  }
+  m_output.async_wait(
+    asio::posix::stream_descriptor::wait_write,
+    OutputHandler(this)
+  );
+}
+
+void SocketTCP::Splicer::end(const std::error_code &ec) {
+  m_active = false;
+  m_draining = false;
+  close_output();
+  m_socket->on_receive(ec, 0);
+}
+
+void SocketTCP::Splicer::fall_back() {
+  auto *socket = m_socket;
+  m_active = false;
+  m_draining = false;
+  close_output();
+  if (m_pipe_size > 0) {
+    Data buf;
+    read_pipe(buf);
+    close_pipe();
+    if (auto *peer = socket->m_splice_peer) {
+      peer->output(Data::make(std::move(buf)));
+    }
+  }
+  socket->m_receiving = false;
+  socket->receive();
+  socket->close_async();
+}
+
+void SocketTCP::Splicer::close_output() {
+  if (m_output.is_open()) {
+    std::error_code ec;
+    m_output.close(ec);
+  }
+}
+
+void SocketTCP::Splicer::read_pipe(Data &buf) {
+  thread_local static char s_buffer[PIPE_SIZE];
+  while (m_pipe_size > 0) {
+    auto n = ::read(m_pipe[0], s_buffer, std::min(m_pipe_size, sizeof(s_buffer)));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    buf.push(s_buffer, n, &s_dp);
+    m_pipe_size -= n;
+  }
+}
+
+void SocketTCP::Splicer::close_pipe() {
+  if (m_pipe[0] >= 0) ::close(m_pipe[0]);
+  if (m_pipe[1] >= 0) ::close(m_pipe[1]);
+  m_pipe[0] = m_pipe[1] = -1;
+  m_pipe_size = 0;
+}
+
+void SocketTCP::Splicer::on_input_ready(const std::error_code &ec) {
+  InputContext ic(m_socket);
+  if (ec) {
+    end(ec);
+  } else if (m_socket->m_state == CLOSED) {
+    end(asio::error::operation_aborted);
+  } else {
+    pump();
+  }
+}
+
+void SocketTCP::Splicer::on_output_ready(const std::error_code &ec) {
+  InputContext ic(m_socket);
+  if (m_socket->m_state == CLOSED) {
+    end(asio::error::operation_aborted);
+  } else {
+    pump();
+  }
 }
 
+#endif // __linux__
+
+//
+// SocketUDP
+//
+
+Data::Producer SocketUDP::s_dp("UDP Socket");
+
 void SocketUDP::open() {
   m_endpoint = m_socket.local_endpoint();
   m_opened = true;
 
+#ifdef __linux__
+  if (batching()) open_batch();
+#endif
+
   if (!m_buffer.empty()) {
     m_buffer.flush(
       [this](Event *evt) {
@@ -384,7 +872,6 @@ void SocketUDP::open() {
   }
 
   receive();
-  Ticker::get()->watch(this);
 }
 
 void SocketUDP::close() {
@@ -424,6 +911,14 @@ void SocketUDP::receive() {
   if (m_receiving) return;
   if (m_paused) return;
 
+#ifdef __linux__
+  if (batching()) {
+    m_socket.async_wait(udp::socket::wait_read, InputHandler(this));
+    m_receiving = true;
+    return;
+  }
+#endif
+
   auto *buf = Data::make(RECEIVE_BUFFER_SIZE, &s_dp);
   buf->retain();
 
@@ -439,6 +934,13 @@ void SocketUDP::receive() {
 void SocketUDP::send(Data *data) {
   if (m_closing) return;
 
+#ifdef __linux__
+  if (batching()) {
+    enqueue(data, nullptr);
+    return;
+  }
+#endif
+
   data->retain();
   m_sending_size += data->size();
   m_sending_count++;
@@ -458,6 +960,13 @@ void SocketUDP::send(Data *data) {
 void SocketUDP::send(Data *data, const asio::ip::udp::endpoint &endpoint) {
   if (m_closed) return;
 
+#ifdef __linux__
+  if (batching()) {
+    enqueue(data, &endpoint);
+    return;
+  }
+#endif
+
   data->retain();
   m_sending_size += data->size();
   m_sending_count++;
@@ -475,6 +984,46 @@ void SocketUDP::send(Data *data, const asio::ip::udp::endpoint &endpoint) {
   );
 }
 
+void SocketUDP::receive_datagram(Data *data, const asio::ip::udp::endpoint &from) {
+  auto size = data->size();
+  m_traffic_read += size;
+
+  if (Log::is_enabled(Log::UDP)) {
+    std::cerr << Log::format_elapsed_time();
+    std::cerr << (m_is_inbound ? " udp >>>> recv " : " udp recv <<<< ");
+    std::cerr << size << std::endl;
+  }
+
+  Peer *peer = nullptr;
+  auto i = m_peers.find(from);
+  if (i == m_peers.end()) {
+    peer = on_socket_new_peer();
+    if (peer) {
+      peer->m_socket = this;
+      peer->m_endpoint = from;
+      peer->m_tick_read = peer->m_tick_write = Ticker::get()->tick();
+      m_peers[from] = peer;
+      peer->schedule_timeout();
+      peer->on_peer_open();
+      if (peer->m_closed) {
+        peer->on_peer_close();
+        peer = nullptr;
+      } else {
+        peer->m_opened = true;
+      }
+    }
+  } else {
+    peer = i->second;
+  }
+
+  if (peer) {
+    peer->m_tick_read = Ticker::get()->tick();
+    peer->on_peer_input(data);
+  } else {
+    on_socket_input(data);
+  }
+}
+
 void SocketUDP::close_peers(StreamEnd::Error err) {
   InputContext ic;
   std::map<asio::ip::udp::endpoint, Peer*> peers(std::move(m_peers));
@@ -487,6 +1036,13 @@ void SocketUDP::close_peers(StreamEnd::Error err) {
 }
 
 void SocketUDP::close_socket() {
+#ifdef __linux__
+  if (!m_send_queue.empty()) {
+    if (m_socket.is_open() && !m_waiting_output) send_batch();
+    clear_send_queue();
+  }
+#endif
+
   if (m_socket.is_open()) {
     std::error_code ec;
     m_socket.close(ec);
@@ -517,12 +1073,13 @@ void SocketUDP::on_tap_close() {
   m_paused = true;
 }
 
-void SocketUDP::on_tick(double tick) {
-  auto i = m_peers.begin();
-  while (i != m_peers.end()) {
-    auto p = i->second; i++;
-    p->tick(tick);
+void SocketUDP::on_flush() {
+#ifdef __linux__
+  if (!m_waiting_output && !m_send_queue.empty()) {
+    send_batch();
+    close_async();
   }
+#endif
 }
 
 void SocketUDP::on_receive(Data *data, const std::error_code &ec, std::size_t n) {
@@ -533,42 +1090,7 @@ void SocketUDP::on_receive(Data *data, const std::error_code &ec, std::size_t n)
   if (ec != asio::error::operation_aborted && !m_closing) {
     if (n > 0) {
       data->pop(data->size() - n);
-      auto size = data->size();
-      m_traffic_read += size;
-
-      if (Log::is_enabled(Log::UDP)) {
-        std::cerr << Log::format_elapsed_time();
-        std::cerr << (m_is_inbound ? " udp >>>> recv " : " udp recv <<<< ");
-        std::cerr << size << std::endl;
-      }
-
-      Peer *peer = nullptr;
-      auto i = m_peers.find(m_from);
-      if (i == m_peers.end()) {
-        peer = on_socket_new_peer();
-        if (peer) {
-          peer->m_socket = this;
-          peer->m_endpoint = m_from;
-          peer->m_tick_write = Ticker::get()->tick();
-          m_peers[m_from] = peer;
-          peer->on_peer_open();
-          if (peer->m_closed) {
-            peer->on_peer_close();
-            peer = nullptr;
-          } else {
-            peer->m_opened = true;
-          }
-        }
-      } else {
-        peer = i->second;
-      }
-
-      if (peer) {
-        peer->m_tick_read = Ticker::get()->tick();
-        peer->on_peer_input(data);
-      } else {
-        on_socket_input(data);
-      }
+      receive_datagram(data, m_from);
     }
 
     if (ec) {
@@ -610,12 +1132,309 @@ void SocketUDP::on_send(Data *data, const std::error_code &ec, std::size_t n) {
   close_async();
 }
 
+#ifdef __linux__
+
+void SocketUDP::open_batch() {
+  auto fd = m_socket.native_handle();
+  int n = batch_size();
+
+#ifdef UDP_GRO
+  int on = 1;
+  m_gro = (setsockopt(fd, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0);
+#endif
+
+#ifdef UDP_SEGMENT
+  int gso = 0;
+  socklen_t len = sizeof(gso);
+  m_gso = (getsockopt(fd, SOL_UDP, UDP_SEGMENT, &gso, &len) == 0);
+#endif
+
+  m_receive_buffers.resize(n);
+  m_receive_msgs.resize(n);
+  m_receive_addrs.resize(n);
+  m_receive_controls.resize(n * CONTROL_BUFFER_SIZE);
+  m_send_msgs.resize(n);
+  m_send_controls.resize(n * CONTROL_BUFFER_SIZE);
+
+  std::error_code ec;
+  m_socket.native_non_blocking(true, ec);
+  if (ec) log_warn("unable to set non-blocking for batching", ec);
+}
+
+void SocketUDP::enqueue(Data *data, const asio::ip::udp::endpoint *endpoint) {
+  data->retain();
+  m_sending_size += data->size();
+  m_sending_count++;
+
+  if (Log::is_enabled(Log::UDP)) {
+    std::cerr << Log::format_elapsed_time();
+    std::cerr << (m_is_inbound ? " udp <<<< send " : " udp send >>>> ");
+    std::cerr << data->size() << std::endl;
+  }
+
+  m_send_queue.emplace_back();
+  auto &dgram = m_send_queue.back();
+  dgram.data = data;
+  dgram.has_endpoint = (endpoint != nullptr);
+  if (endpoint) dgram.endpoint = *endpoint;
+
+  FlushTarget::need_flush();
+}
+
+void SocketUDP::receive_batch() {
+  auto fd = m_socket.native_handle();
+  int n = batch_size();
+  int slot_size = m_gro ? GRO_BUFFER_SIZE : RECEIVE_BUFFER_SIZE;
+
+  m_receive_iovecs.clear();
+  for (int i = 0; i < n; i++) {
+    auto &buf = m_receive_buffers[i];
+    auto &msg = m_receive_msgs[i].msg_hdr;
+    if (buf.size() < slot_size) buf.push(Data(slot_size - buf.size(), &s_dp));
+    int size = 0, count = 0;
+    for (const auto c : buf.chunks()) {
+      if (size >= slot_size) break;
+      auto len = std::min(std::get<1>(c), slot_size - size);
+      m_receive_iovecs.push_back({ std::get<0>(c), size_t(len) });
+      size += len;
+      count++;
+    }
+    msg.msg_name = &m_receive_addrs[i];
+    msg.msg_namelen = sizeof(m_receive_addrs[i]);
+    msg.msg_iovlen = count;
+    msg.msg_control = &m_receive_controls[i * CONTROL_BUFFER_SIZE];
+    msg.msg_controllen = CONTROL_BUFFER_SIZE;
+    msg.msg_flags = 0;
+  }
+
+  auto *iov = m_receive_iovecs.data();
+  for (int i = 0; i < n; i++) {
+    auto &msg = m_receive_msgs[i].msg_hdr;
+    msg.msg_iov = iov;
+    iov += msg.msg_iovlen;
+  }
+
+  auto received = recvmmsg(fd, m_receive_msgs.data(), n, MSG_DONTWAIT, nullptr);
+  if (received < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      receive();
+    } else {
+      log_warn("error reading from peers", std::error_code(errno, std::system_category()));
+      m_closing = true;
+      close_peers(StreamEnd::READ_ERROR);
+      close_socket();
+    }
+    return;
+  }
+
+  for (int i = 0; i < received && !m_closing; i++) {
+    auto &msg = m_receive_msgs[i].msg_hdr;
+    int len = m_receive_msgs[i].msg_len;
+    int segment_size = 0;
+
+#ifdef UDP_GRO
+    for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+        std::memcpy(&segment_size, CMSG_DATA(cmsg), sizeof(segment_size));
+      }
+    }
+#endif
+
+    asio::ip::udp::endpoint from;
+    if (msg.msg_namelen > 0 && msg.msg_namelen <= from.capacity()) {
+      std::memcpy(from.data(), msg.msg_name, msg.msg_namelen);
+      from.resize(msg.msg_namelen);
+    }
+
+    Data datagram;
+    m_receive_buffers[i].shift(len, datagram);
+    if (segment_size <= 0) segment_size = len;
+    while (!datagram.empty() && !m_closing) {
+      pjs::Ref<Data> segment(Data::make());
+      datagram.shift(std::min(segment_size, datagram.size()), *segment);
+      receive_datagram(segment, from);
+    }
+  }
+
+  if (!m_closing) receive();
+}
+
+void SocketUDP::send_batch() {
+  auto fd = m_socket.native_handle();
+  int n = batch_size();
+  bool gso = m_gso;
+
+  while (!m_send_queue.empty()) {
+    m_send_iovecs.clear();
+    m_send_counts.clear();
+
+    auto q = m_send_queue.begin();
+    while (q != m_send_queue.end() && int(m_send_counts.size()) < n) {
+      auto &msg = m_send_msgs[m_send_counts.size()].msg_hdr;
+      auto &head = *q;
+      int segment_size = head.data->size();
+      int count = 1, total = segment_size;
+
+      if (gso && segment_size > 0 && segment_size <= MAX_GSO_SEGMENT_SIZE) {
+        for (auto p = q + 1; p != m_send_queue.end() && count < MAX_GSO_SEGMENTS; ++p) {
+          int size = p->data->size();
+          if (size == 0 || size > segment_size || total + size > MAX_GSO_PAYLOAD) break;
+          if (p->has_endpoint != head.has_endpoint) break;
+          if (p->has_endpoint && p->endpoint != head.endpoint) break;
+          total += size;
+          count++;
+          if (size < segment_size) break;
+        }
+      }
+
+      std::memset(&msg, 0, sizeof(msg));
+      if (head.has_endpoint) {
+        msg.msg_name = head.endpoint.data();
+        msg.msg_namelen = head.endpoint.size();
+      }
+
+      for (int i = 0; i < count; i++, ++q) {
+        for (const auto c : q->data->chunks()) {
+          m_send_iovecs.push_back({ std::get<0>(c), size_t(std::get<1>(c)) });
+          msg.msg_iovlen++;
+        }
+      }
+
+#ifdef UDP_SEGMENT
+      if (count > 1) {
+        auto *control = &m_send_controls[m_send_counts.size() * CONTROL_BUFFER_SIZE];
+        std::memset(control, 0, CMSG_SPACE(sizeof(uint16_t)));
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+        auto *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t size = segment_size;
+        std::memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+      }
+#endif
+
+      m_send_counts.push_back(count);
+    }
+
+    auto *iov = m_send_iovecs.data();
+    for (size_t i = 0; i < m_send_counts.size(); i++) {
+      auto &msg = m_send_msgs[i].msg_hdr;
+      msg.msg_iov = iov;
+      iov += msg.msg_iovlen;
+    }
+
+    auto sent = sendmmsg(fd, m_send_msgs.data(), m_send_counts.size(), MSG_DONTWAIT);
+    if (sent < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        m_waiting_output = true;
+        m_socket.async_wait(udp::socket::wait_write, OutputHandler(this));
+        return;
+      }
+      if (gso && m_send_counts[0] > 1) {
+        if (errno == EIO) {
+          log_debug("UDP segmentation offload unavailable");
+          m_gso = gso = false;
+          continue;
+        }
+        if (errno == EINVAL) {
+          gso = false;
+          continue;
+        }
+      }
+      log_warn("error writing to peers", std::error_code(errno, std::system_category()));
+      m_closing = true;
+      clear_send_queue();
+      close_peers(StreamEnd::WRITE_ERROR);
+      close_socket();
+      return;
+    }
+
+    for (int i = 0; i < sent; i++) {
+      for (int j = 0; j < m_send_counts[i]; j++) {
+        auto *data = m_send_queue.front().data;
+        m_send_queue.pop_front();
+        m_sending_size -= data->size();
+        m_sending_count--;
+        m_traffic_write += data->size();
+        data->release();
+      }
+    }
+  }
+
+  auto limit = m_options.congestion_limit;
+  if (limit > 0 && m_sending_size < limit) {
+    m_congestion.end();
+  }
+}
+
+void SocketUDP::clear_send_queue() {
+  for (const auto &dgram : m_send_queue) {
+    m_sending_size -= dgram.data->size();
+    m_sending_count--;
+    dgram.data->release();
+  }
+  m_send_queue.clear();
+}
+
+void SocketUDP::on_input_ready(const std::error_code &ec) {
+  InputContext ic(this);
+
+  m_receiving = false;
+
+  if (ec != asio::error::operation_aborted && !m_closing) {
+    if (ec) {
+      log_warn("error reading from peers", ec);
+      m_closing = true;
+      close_peers(StreamEnd::READ_ERROR);
+      close_socket();
+    } else {
+      receive_batch();
+    }
+  }
+
+  close_async();
+}
+
+void SocketUDP::on_output_ready(const std::error_code &ec) {
+  m_waiting_output = false;
+
+  if (ec != asio::error::operation_aborted && !m_closing) {
+    if (ec) {
+      log_warn("error writing to peers", ec);
+      m_closing = true;
+      clear_send_queue();
+      close_peers(StreamEnd::WRITE_ERROR);
+      close_socket();
+    } else {
+      send_batch();
+    }
+  } else {
+    clear_send_queue();
+  }
+
+  close_async();
+}
+
+#endif // __linux__
+
 //
 // SocketUDP::Peer
 //
 
-void SocketUDP::Peer::tick(double t) {
+void SocketUDP::Peer::schedule_timeout() {
+  auto t = m_socket->next_timeout(m_tick_read, m_tick_write);
+  if (t > 0) {
+    TimerWheel::current()->schedule(this, t - Ticker::get()->tick());
+  }
+}
+
+void SocketUDP::Peer::on_expire() {
+  if (!m_socket) return;
+
   const auto &options = m_socket->m_options;
+  auto t = Ticker::get()->tick();
 
   auto r = t - m_tick_read;
   auto w = t - m_tick_write;
@@ -650,6 +1469,8 @@ void SocketUDP::Peer::tick(double t) {
       return;
     }
   }
+
+  schedule_timeout();
 }
 
 void SocketUDP::Peer::close() {
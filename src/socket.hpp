@@ -32,6 +32,15 @@
 #include "data.hpp"
 #include "buffer.hpp"
 #include "timer.hpp"
+#include "io-uring.hpp"
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
 
 namespace pipy {
 
@@ -49,6 +58,7 @@ public:
     double idle_timeout = 60;
     bool keep_alive = true;
     bool no_delay = true;
+    int batch_size = 1;
   };
 
 protected:
@@ -61,6 +71,8 @@ protected:
   void log_error(const char *msg, const std::error_code &ec);
   void log_error(const char *msg);
 
+  auto next_timeout(double tick_read, double tick_write) const -> double;
+
   bool m_is_inbound;
   const Options& m_options;
   size_t m_traffic_read = 0;
@@ -79,13 +91,21 @@ class SocketTCP :
   public SocketBase,
   public InputSource,
   public FlushTarget,
-  public Ticker::Watcher
+  public TimerWheel::Entry
 {
+public:
+  void splice(SocketTCP *peer);
+
 protected:
   SocketTCP(bool is_inbound, const Options &options)
     : SocketBase(is_inbound, options)
     , FlushTarget(true)
-    , m_socket(Net::context()) {}
+    , m_socket(Net::context())
+#ifdef PIPY_USE_IO_URING
+    , m_receive_request(this)
+    , m_send_request(this)
+#endif
+    {}
 
   ~SocketTCP();
 
@@ -113,26 +133,121 @@ private:
   double m_tick_read;
   double m_tick_write;
   State m_state = IDLE;
+  int m_receive_size = RECEIVE_BUFFER_SIZE;
+  int m_receive_requested = 0;
+  bool m_receive_shrinking = false;
+  bool m_receive_more = false;
   bool m_opened = false;
   bool m_receiving = false;
   bool m_sending = false;
   bool m_paused = false;
   bool m_closed = false;
 
+  enum {
+    MIN_RECEIVE_SIZE = 0x200,
+    MAX_RECEIVE_SIZE = 0x10000,
+  };
+
   void receive();
   void send();
   void shutdown_socket();
   void close_socket();
   void close_async();
+  void schedule_timeout();
+  void adapt_receive_size(int n);
 
   virtual void on_tap_open() override;
   virtual void on_tap_close() override;
   virtual void on_flush() override;
-  virtual void on_tick(double tick) override;
+  virtual void on_expire() override;
 
   void on_receive(const std::error_code &ec, std::size_t n);
   void on_send(const std::error_code &ec, std::size_t n);
 
+#ifdef __linux__
+
+  //
+  // SocketTCP::Splicer
+  //
+
+  class Splicer {
+  public:
+    Splicer(SocketTCP *socket)
+      : m_socket(socket)
+      , m_output(Net::context()) {}
+
+    ~Splicer();
+
+    bool start();
+    void cancel();
+    void unlink();
+    void drain();
+
+  private:
+    enum {
+      PIPE_SIZE = 64 * 1024,
+      MAX_TRANSFERS_PER_WAIT = 16,
+    };
+
+    SocketTCP* m_socket;
+    asio::posix::stream_descriptor m_output;
+    int m_pipe[2] = { -1, -1 };
+    size_t m_pipe_size = 0;
+    bool m_active = false;
+    bool m_waiting_output = false;
+    bool m_draining = false;
+
+    void pump();
+    void wait_input();
+    void wait_output();
+    void end(const std::error_code &ec);
+    void fall_back();
+    void close_output();
+    void read_pipe(Data &buf);
+    void close_pipe();
+
+    void on_input_ready(const std::error_code &ec);
+    void on_output_ready(const std::error_code &ec);
+
+    struct InputHandler : public SelfHandler<Splicer> {
+      using SelfHandler::SelfHandler;
+      InputHandler(const InputHandler &r) : SelfHandler(r) {}
+      void operator()(const std::error_code &ec) { self->on_input_ready(ec); }
+    };
+
+    struct OutputHandler : public SelfHandler<Splicer> {
+      using SelfHandler::SelfHandler;
+      OutputHandler(const OutputHandler &r) : SelfHandler(r) {}
+      void operator()(const std::error_code &ec) { self->on_output_ready(ec); }
+    };
+  };
+
+  SocketTCP* m_splice_peer = nullptr;
+  std::unique_ptr<Splicer> m_splicer;
+
+  bool is_splice_writable() const;
+  bool receive_splice();
+  void splice_unlink();
+  enum { MAX_SEND_VIEWS = 64 };
+
+  bool send_file();
+  void on_send_file(const std::error_code &ec);
+  void on_receive_ready(const std::error_code &ec);
+
+  struct ReceiveReadyHandler : public SelfHandler<SocketTCP> {
+    using SelfHandler::SelfHandler;
+    ReceiveReadyHandler(const ReceiveReadyHandler &r) : SelfHandler(r) {}
+    void operator()(const std::error_code &ec) { self->on_receive_ready(ec); }
+  };
+
+  struct SendFileHandler : public SelfHandler<SocketTCP> {
+    using SelfHandler::SelfHandler;
+    SendFileHandler(const SendFileHandler &r) : SelfHandler(r) {}
+    void operator()(const std::error_code &ec) { self->on_send_file(ec); }
+  };
+
+#endif // __linux__
+
   struct ReceiveHandler : public SelfHandler<SocketTCP> {
     using SelfHandler::SelfHandler;
     ReceiveHandler(const ReceiveHandler &r) : SelfHandler(r) {}
@@ -145,6 +260,38 @@ private:
     void operator()(const std::error_code &ec, std::size_t n) { self->on_send(ec, n); }
   };
 
+#ifdef PIPY_USE_IO_URING
+  enum { MAX_SEND_IOVECS = 8 };
+
+  struct ReceiveRequest : public IOUring::Request {
+    SocketTCP* self;
+    ReceiveRequest(SocketTCP *s) : self(s) {}
+    virtual void on_complete(int result, bool more) override {
+      if (result == 0) {
+        self->on_receive(asio::error::eof, 0);
+      } else {
+        self->on_receive(IOUring::error_code(result), result > 0 ? result : 0);
+      }
+    }
+  };
+
+  struct SendRequest : public IOUring::Request {
+    SocketTCP* self;
+    SendRequest(SocketTCP *s) : self(s) {}
+    virtual void on_complete(int result, bool more) override {
+      self->on_send(IOUring::error_code(result), result > 0 ? result : 0);
+    }
+  };
+
+  ReceiveRequest m_receive_request;
+  SendRequest m_send_request;
+  struct msghdr m_send_msg;
+  struct iovec m_send_iovecs[MAX_SEND_IOVECS];
+
+  bool receive_uring();
+  bool send_uring();
+#endif // PIPY_USE_IO_URING
+
   static Data::Producer s_dp;
 };
 
@@ -155,7 +302,7 @@ private:
 class SocketUDP :
   public SocketBase,
   public InputSource,
-  public Ticker::Watcher
+  public FlushTarget
 {
 public:
 
@@ -163,7 +310,7 @@ public:
   // SocketUDP::Peer
   //
 
-  class Peer {
+  class Peer : public TimerWheel::Entry {
   public:
     Peer() {}
     ~Peer() { if (auto s = m_socket) s->m_peers.erase(m_endpoint); }
@@ -174,7 +321,7 @@ public:
     auto peer() const -> const asio::ip::udp::endpoint& { return m_endpoint; }
 
   private:
-    void tick(double t);
+    void schedule_timeout();
     void close();
 
     SocketUDP* m_socket = nullptr;
@@ -187,6 +334,7 @@ public:
     virtual void on_peer_open() = 0;
     virtual void on_peer_input(Event *evt) = 0;
     virtual void on_peer_close() = 0;
+    virtual void on_expire() override;
 
     friend class SocketUDP;
   };
@@ -194,10 +342,9 @@ public:
 protected:
   SocketUDP(bool is_inbound, const Options &options)
     : SocketBase(is_inbound, options)
+    , FlushTarget(true)
     , m_socket(Net::context()) {}
 
-  ~SocketUDP();
-
   auto socket() -> asio::ip::udp::socket& { return m_socket; }
   auto buffered() const -> size_t { return m_sending_size; }
 
@@ -230,13 +377,69 @@ private:
   void close_socket();
   void close_async();
 
+  void receive_datagram(Data *data, const asio::ip::udp::endpoint &from);
+
   virtual void on_tap_open() override;
   virtual void on_tap_close() override;
-  virtual void on_tick(double tick) override;
+  virtual void on_flush() override;
 
   void on_receive(Data *data, const std::error_code &ec, std::size_t n);
   void on_send(Data *data, const std::error_code &ec, std::size_t n);
 
+#ifdef __linux__
+  enum {
+    MAX_BATCH_SIZE = 1024,
+    MAX_GSO_SEGMENTS = 64,
+    MAX_GSO_SEGMENT_SIZE = 1400,
+    MAX_GSO_PAYLOAD = 60000,
+    GRO_BUFFER_SIZE = 0x10000,
+    CONTROL_BUFFER_SIZE = 64,
+  };
+
+  struct Datagram {
+    Data* data;
+    asio::ip::udp::endpoint endpoint;
+    bool has_endpoint;
+  };
+
+  std::vector<Data> m_receive_buffers;
+  std::vector<struct mmsghdr> m_receive_msgs;
+  std::vector<struct iovec> m_receive_iovecs;
+  std::vector<struct sockaddr_storage> m_receive_addrs;
+  std::vector<char> m_receive_controls;
+  std::vector<struct mmsghdr> m_send_msgs;
+  std::vector<struct iovec> m_send_iovecs;
+  std::vector<char> m_send_controls;
+  std::vector<int> m_send_counts;
+  std::deque<Datagram> m_send_queue;
+  bool m_waiting_output = false;
+  bool m_gro = false;
+  bool m_gso = false;
+
+  bool batching() const { return m_options.batch_size > 1; }
+  auto batch_size() const -> int { return std::min(int(m_options.batch_size), int(MAX_BATCH_SIZE)); }
+  void open_batch();
+  void enqueue(Data *data, const asio::ip::udp::endpoint *endpoint);
+  void receive_batch();
+  void send_batch();
+  void clear_send_queue();
+
+  void on_input_ready(const std::error_code &ec);
+  void on_output_ready(const std::error_code &ec);
+
+  struct InputHandler : public SelfHandler<SocketUDP> {
+    using SelfHandler::SelfHandler;
+    InputHandler(const InputHandler &r) : SelfHandler(r) {}
+    void operator()(const std::error_code &ec) { self->on_input_ready(ec); }
+  };
+
+  struct OutputHandler : public SelfHandler<SocketUDP> {
+    using SelfHandler::SelfHandler;
+    OutputHandler(const OutputHandler &r) : SelfHandler(r) {}
+    void operator()(const std::error_code &ec) { self->on_output_ready(ec); }
+  };
+#endif // __linux__
+
   struct ReceiveHandler : public SelfDataHandler<SocketUDP, Data> {
     using SelfDataHandler::SelfDataHandler;
     ReceiveHandler(const ReceiveHandler &r) : SelfDataHandler(r) {}
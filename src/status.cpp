@@ -352,7 +352,7 @@ void Status::update_local() {
     Data::Producer::for_each([&](Data::Producer *producer) {
       chunks.insert({
         producer->name(),
-        producer->count(),
+        producer->size(),
       });
     });
   }
@@ -592,7 +592,7 @@ void Status::dump_chunks(Data::Builder &db) {
   for (const auto &i : chunks) {
     rows.push_back({
       i.name,
-      std::to_string(DATA_CHUNK_SIZE * i.count / 1024),
+      std::to_string(i.size / 1024),
     });
   }
   print_table(db, { "DATA", "SIZE(KB)" }, rows);
@@ -694,7 +694,7 @@ void Status::dump_json(Data::Builder &db) {
     db.push('"');
     db.push(i.name);
     db.push("\":");
-    db.push(std::to_string(DATA_CHUNK_SIZE * i.count / 1024));
+    db.push(std::to_string(i.size / 1024));
   }
   db.push("},\"buffers\":{");
   first = true;
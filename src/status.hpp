@@ -98,14 +98,14 @@ public:
 
   struct ChunkInfo {
     std::string name;
-    mutable size_t count;
+    mutable size_t size;
 
     bool operator<(const ChunkInfo &r) const {
       return name < r.name;
     }
 
     auto operator+=(const ChunkInfo &r) const -> const ChunkInfo& {
-      count += r.count;
+      size += r.size;
       return *this;
     }
   };
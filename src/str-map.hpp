@@ -88,6 +88,17 @@ public:
   StrMap(const std::list<std::string> &strings);
   ~StrMap();
 
+  auto find(const char *s, size_t n) const -> pjs::Str* {
+    if (!n) return nullptr;
+    auto node = m_root;
+    for (size_t i = 0; i < n; i++) {
+      auto c = uint8_t(s[i]);
+      if (c < node->start || c >= node->end) return nullptr;
+      if (!(node = node->children[c - node->start])) return nullptr;
+    }
+    return node->str;
+  }
+
 private:
   void insert_string(const std::string &str);
   auto create_node(pjs::Str *str, uint8_t start, uint8_t end) -> Node*;
@@ -34,7 +34,7 @@ SharedTableBase::SharedTableBase(size_t entry_size)
   , m_max_id(0)
   , m_free_id(0)
 {
-  std::memset(m_ranges, 0, sizeof(m_ranges));
+  for (auto &r : m_ranges) r.store(nullptr, std::memory_order_relaxed);
 }
 
 auto SharedTableBase::get_entry(int i) -> Entry* {
@@ -51,7 +51,7 @@ auto SharedTableBase::add_entry(int i) -> Entry* {
   auto r = m_ranges[x].load(std::memory_order_relaxed);
   if (!r) {
     auto *p = new Range;
-    std::memset(p, 0, sizeof(Range));
+    for (auto &c : p->chunks) c.store(nullptr, std::memory_order_relaxed);
     if (m_ranges[x].compare_exchange_weak(r, p, std::memory_order_relaxed)) {
       r = p;
     } else {
@@ -28,6 +28,153 @@
 
 namespace pipy {
 
+//
+// TimerWheel
+//
+
+auto TimerWheel::current() -> TimerWheel* {
+  thread_local static TimerWheel s_wheel;
+  return &s_wheel;
+}
+
+auto TimerWheel::now() -> uint64_t {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()
+  ).count();
+}
+
+TimerWheel::TimerWheel()
+  : m_timer(Net::context())
+  , m_current(now()) {}
+
+TimerWheel::~TimerWheel() {
+  for (int i = 0; i < LEVELS; i++) {
+    for (int j = 0; j < SLOTS; j++) {
+      auto &slot = m_slots[i][j];
+      while (auto e = slot.head()) {
+        slot.remove(e);
+        e->m_wheel = nullptr;
+        e->m_list = nullptr;
+      }
+    }
+  }
+}
+
+void TimerWheel::schedule(Entry *entry, double timeout) {
+  if (entry->m_wheel) cancel(entry);
+  if (!m_size) m_current = now();
+  auto ms = timeout > 0 ? uint64_t(timeout * 1000) : 0;
+  entry->m_wheel = this;
+  entry->m_expiry = now() + ms;
+  insert(entry);
+  m_size++;
+  if (!m_waiting || entry->m_expiry < m_wakeup) arm();
+}
+
+void TimerWheel::cancel(Entry *entry) {
+  if (entry->m_wheel != this) return;
+  auto list = entry->m_list;
+  auto slots = &m_slots[0][0];
+  list->remove(entry);
+  if (slots <= list && list < slots + LEVELS * SLOTS) {
+    m_level_sizes[(list - slots) / SLOTS]--;
+  }
+  entry->m_wheel = nullptr;
+  entry->m_list = nullptr;
+  m_size--;
+}
+
+void TimerWheel::insert(Entry *entry) {
+  auto expiry = entry->m_expiry;
+  if (expiry <= m_current) expiry = m_current + 1;
+  auto delta = expiry - m_current;
+  int level = 0;
+  while (level < LEVELS - 1 && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) level++;
+  if (level == LEVELS - 1) {
+    auto max = (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+    if (delta > max) expiry = m_current + max;
+  }
+  auto &slot = m_slots[level][(expiry >> (SLOT_BITS * level)) & (SLOTS - 1)];
+  slot.push(entry);
+  entry->m_list = &slot;
+  m_level_sizes[level]++;
+}
+
+void TimerWheel::cascade(int level) {
+  auto &slot = m_slots[level][(m_current >> (SLOT_BITS * level)) & (SLOTS - 1)];
+  auto list = std::move(slot);
+  m_level_sizes[level] -= list.size();
+  while (auto e = list.head()) {
+    list.remove(e);
+    insert(e);
+  }
+}
+
+void TimerWheel::advance(uint64_t now, List<Entry> &expired) {
+  while (m_current < now && m_size > expired.size()) {
+    m_current++;
+    for (int level = 1; level < LEVELS; level++) {
+      if (m_current & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) break;
+      cascade(level);
+    }
+    auto &slot = m_slots[0][m_current & (SLOTS - 1)];
+    m_level_sizes[0] -= slot.size();
+    while (auto e = slot.head()) {
+      slot.remove(e);
+      expired.push(e);
+      e->m_list = &expired;
+    }
+  }
+  m_current = now;
+}
+
+void TimerWheel::arm() {
+  if (!m_size) return;
+  auto next = (m_current | (SLOTS - 1)) + 1;
+  if (m_level_sizes[0] > 0) {
+    for (auto t = m_current + 1; t < next; t++) {
+      if (!m_slots[0][t & (SLOTS - 1)].empty()) {
+        next = t;
+        break;
+      }
+    }
+  }
+  if (m_waiting && next >= m_wakeup) return;
+  m_wakeup = next;
+  m_waiting = true;
+  m_timer.expires_at(
+    std::chrono::steady_clock::time_point(
+      std::chrono::milliseconds(next)
+    )
+  );
+  m_timer.async_wait(
+    [this](const std::error_code &ec) {
+      if (ec != asio::error::operation_aborted) {
+        m_waiting = false;
+        fire();
+      }
+    }
+  );
+}
+
+void TimerWheel::fire() {
+  InputContext ic;
+  List<Entry> expired;
+  advance(now(), expired);
+  while (auto e = expired.head()) {
+    expired.remove(e);
+    e->m_wheel = nullptr;
+    e->m_list = nullptr;
+    m_size--;
+    e->on_expire();
+  }
+  arm();
+}
+
+//
+// Timer
+//
+
 thread_local List<Timer> Timer::s_all_timers;
 
 void Timer::cancel_all() {
@@ -38,34 +185,26 @@ void Timer::cancel_all() {
 
 void Timer::schedule(double timeout, const std::function<void()> &handler) {
   cancel();
-  pjs::Ref<Handler> h = new Handler(handler);
-  m_handler = h;
-  m_timer.expires_after(std::chrono::milliseconds((long long)(timeout * 1000)));
-  m_timer.async_wait(
-    [=](const asio::error_code &ec) {
-      InputContext ic;
-      h->trigger(ec);
-    }
-  );
+  m_handler = new Handler(handler);
+  TimerWheel::current()->schedule(m_handler, timeout);
 }
 
 void Timer::cancel() {
   if (m_handler) {
-    asio::error_code ec;
-    m_timer.cancel(ec);
     m_handler->cancel();
     m_handler = nullptr;
   }
 }
 
-void Timer::Handler::trigger(const asio::error_code &ec) {
-  if (!m_canceled && ec != asio::error::operation_aborted) {
-    m_handler();
+void Timer::Handler::cancel() {
+  if (scheduled()) {
+    TimerWheel::current()->cancel(this);
   }
 }
 
-void Timer::Handler::cancel() {
-  m_canceled = true;
+void Timer::Handler::on_expire() {
+  pjs::Ref<Handler> ref(this);
+  m_handler();
 }
 
 //
@@ -77,32 +216,4 @@ auto Ticker::get() -> Ticker* {
   return &s_ticker;
 }
 
-void Ticker::start() {
-  if (!m_is_running) {
-    schedule();
-    m_is_running = true;
-  }
-}
-
-void Ticker::stop() {
-  if (m_is_running) {
-    m_timer.cancel();
-    m_is_running = false;
-  }
-}
-
-void Ticker::schedule() {
-  m_timer.schedule(
-    1, [this]() {
-      auto t = ++m_tick;
-      m_visiting = m_watchers.head();
-      while (auto w = m_visiting) {
-        m_visiting = m_visiting->next();
-        w->on_tick(t);
-      }
-      schedule();
-    }
-  );
-}
-
 } // namespace pipy
@@ -31,6 +31,67 @@
 
 namespace pipy {
 
+//
+// TimerWheel
+//
+
+class TimerWheel {
+public:
+
+  //
+  // TimerWheel::Entry
+  //
+
+  class Entry : public List<Entry>::Item {
+  public:
+    ~Entry() { if (auto w = m_wheel) w->cancel(this); }
+    bool scheduled() const { return m_wheel; }
+
+  private:
+    TimerWheel* m_wheel = nullptr;
+    List<Entry>* m_list = nullptr;
+    uint64_t m_expiry = 0;
+
+    virtual void on_expire() = 0;
+
+    friend class TimerWheel;
+  };
+
+  enum {
+    LEVELS = 4,
+    SLOT_BITS = 8,
+    SLOTS = 1 << SLOT_BITS,
+  };
+
+  static auto current() -> TimerWheel*;
+  static auto now() -> uint64_t;
+
+  ~TimerWheel();
+
+  auto size() const -> size_t { return m_size; }
+  auto size(int level) const -> size_t { return m_level_sizes[level]; }
+
+  void schedule(Entry *entry, double timeout);
+  void cancel(Entry *entry);
+
+private:
+  TimerWheel();
+
+  asio::steady_timer m_timer;
+  List<Entry> m_slots[LEVELS][SLOTS];
+  size_t m_level_sizes[LEVELS] = {};
+  size_t m_size = 0;
+  uint64_t m_current;
+  uint64_t m_wakeup = 0;
+  bool m_waiting = false;
+
+  void insert(Entry *entry);
+  void cascade(int level);
+  void advance(uint64_t now, List<Entry> &expired);
+  void arm();
+  void fire();
+};
+
 //
 // Timer
 //
@@ -39,7 +100,7 @@ class Timer : public List<Timer>::Item {
 public:
   static void cancel_all();
 
-  Timer() : m_timer(Net::context()) {
+  Timer() {
     s_all_timers.push(this);
   }
 
@@ -54,21 +115,21 @@ public:
 private:
   class Handler :
     public pjs::RefCount<Handler>,
-    public pjs::Pooled<Handler>
+    public pjs::Pooled<Handler>,
+    public TimerWheel::Entry
   {
   public:
     Handler(const std::function<void()> &handler)
       : m_handler(handler) {}
 
-    void trigger(const asio::error_code &ec);
     void cancel();
 
   private:
     std::function<void()> m_handler;
-    bool m_canceled = false;
+
+    virtual void on_expire() override;
   };
 
-  asio::steady_timer m_timer;
   pjs::Ref<Handler> m_handler;
 
   thread_local static List<Timer> s_all_timers;
@@ -80,53 +141,11 @@ private:
 
 class Ticker {
 public:
-
-  //
-  // Ticker::Watcher
-  //
-
-  class Watcher : public List<Watcher>::Item {
-    Ticker* m_ticker = nullptr;
-    virtual void on_tick(double tick) = 0;
-    friend class Ticker;
-  };
-
   static auto get() -> Ticker*;
 
   double tick() const {
-    return m_tick;
-  }
-
-  void watch(Watcher *w) {
-    if (!w->m_ticker) {
-      m_watchers.push(w);
-      w->m_ticker = this;
-      start();
-    }
-  }
-
-  void unwatch(Watcher *w) {
-    if (w->m_ticker == this) {
-      if (w == m_visiting) {
-        m_visiting = w->next();
-      }
-      m_watchers.remove(w);
-      if (m_watchers.empty()) {
-        stop();
-      }
-    }
+    return TimerWheel::now() / 1000.0;
   }
-
-private:
-  List<Watcher> m_watchers;
-  Timer m_timer;
-  Watcher* m_visiting = nullptr;
-  double m_tick = 0;
-  bool m_is_running = false;
-
-  void start();
-  void stop();
-  void schedule();
 };
 
 } // namespace pipy
@@ -28,6 +28,7 @@
 #include "codebase.hpp"
 #include "pipeline-lb.hpp"
 #include "timer.hpp"
+#include "api/algo.hpp"
 #include "api/configuration.hpp"
 #include "api/console.hpp"
 #include "api/pipy.hpp"
@@ -412,6 +413,61 @@ void WorkerThread::init_metrics() {
     }
   );
 
+  //
+  // Stats - size of chunks
+  //
+
+  label_names->length(2);
+  label_names->set(0, "type");
+  label_names->set(1, "class");
+
+  stats::Gauge::make(
+    pjs::Str::make("pipy_chunk_size"),
+    label_names,
+    [](stats::Gauge *gauge) {
+      if (WorkerThread::current()->index() > 0) return;
+      double total = 0;
+      Data::Producer::for_each([&](Data::Producer *producer) {
+        for (int i = 0; i < DATA_CHUNK_CLASSES; i++) {
+          if (auto n = producer->count(i)) {
+            auto size = n * DATA_CHUNK_CLASS_SIZES[i];
+            pjs::Ref<pjs::Str> name(pjs::Str::make(producer->name()));
+            pjs::Ref<pjs::Str> chunk_class(pjs::Str::make(std::to_string(DATA_CHUNK_CLASS_SIZES[i])));
+            pjs::Str *labels[2];
+            labels[0] = name;
+            labels[1] = chunk_class;
+            auto metric = gauge->with_labels(labels, 2);
+            metric->set(size);
+            total += size;
+          }
+        }
+      });
+      gauge->set(total);
+    }
+  );
+
+  //
+  // Stats - # of timers
+  //
+
+  label_names->length(1);
+  label_names->set(0, "level");
+
+  stats::Gauge::make(
+    pjs::Str::make("pipy_timer_count"),
+    label_names,
+    [](stats::Gauge *gauge) {
+      auto wheel = TimerWheel::current();
+      for (int i = 0; i < TimerWheel::LEVELS; i++) {
+        pjs::Ref<pjs::Str> str(pjs::Str::make(i));
+        pjs::Str *level = str.get();
+        auto metric = gauge->with_labels(&level, 1);
+        metric->set(wheel->size(i));
+      }
+      gauge->set(wheel->size());
+    }
+  );
+
   //
   // Stats - # of pipelines
   //
@@ -442,6 +498,36 @@ void WorkerThread::init_metrics() {
       gauge->set(total);
     }
   );
+
+  //
+  // Stats - lock contentions on shared maps
+  //
+
+  label_names->length(2);
+  label_names->set(0, "name");
+  label_names->set(1, "shard");
+
+  stats::Gauge::make(
+    pjs::Str::make("pipy_shared_map_contention_count"),
+    label_names,
+    [](stats::Gauge *gauge) {
+      if (WorkerThread::current()->index() > 0) return;
+      double total = 0;
+      algo::SharedMap::for_each_contention(
+        [&](const std::string &name, int shard, uint64_t count) {
+          pjs::Ref<pjs::Str> s1(pjs::Str::make(name));
+          pjs::Ref<pjs::Str> s2(pjs::Str::make(shard));
+          pjs::Str *labels[2];
+          labels[0] = s1;
+          labels[1] = s2;
+          auto metric = gauge->with_labels(labels, 2);
+          metric->set(count);
+          total += count;
+        }
+      );
+      gauge->set(total);
+    }
+  );
 }
 
 void WorkerThread::shutdown_all(bool force) {
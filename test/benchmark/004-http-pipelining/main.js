@@ -2,7 +2,7 @@ pipy()
 
 .listen(os.env.LISTEN || 8000)
 .demuxHTTP().to($=>$
-  .muxHTTP(() => 1).to($=>$
+  .muxHTTP(() => 1, { maxPipeline: os.env.MAX_PIPELINE | 0 }).to($=>$
     .connect('localhost:8080')
   )
 )
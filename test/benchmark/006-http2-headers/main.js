@@ -0,0 +1,49 @@
+var requestHeaders = {
+  'content-type': 'application/grpc',
+  'te': 'trailers',
+  'grpc-accept-encoding': 'identity,deflate,gzip',
+  'grpc-timeout': '30S',
+  'user-agent': 'grpc-go/1.56.0',
+  'x-b3-sampled': '1',
+  'x-envoy-attempt-count': '1',
+  'x-forwarded-proto': 'http',
+}
+
+var responseHeaders = {
+  'content-type': 'application/grpc',
+  'grpc-encoding': 'identity',
+  'grpc-accept-encoding': 'identity,deflate,gzip',
+  'server': 'pipy',
+  'x-envoy-upstream-service-time': '1',
+}
+
+var count = 0
+
+pipy()
+
+.listen(os.env.LISTEN || 8000)
+.demuxHTTP().to($=>$
+  .handleMessageStart(
+    msg => Object.assign(msg.head.headers, requestHeaders, {
+      'x-request-id': `${Date.now()}-${++count}`,
+      'x-b3-traceid': `${count.toString(16)}463ac35c9f6413ad48485a3953bb${count.toString(16)}`,
+      'x-b3-spanid': `a2fb4a1d${count.toString(16)}`,
+    })
+  )
+  .muxHTTP(() => 1, { version: 2 }).to($=>$
+    .connect('localhost:8280')
+  )
+)
+
+.listen(8280)
+.serveHTTP(
+  msg => new Message(
+    {
+      headers: Object.assign({}, responseHeaders, {
+        'x-request-id': msg.head.headers['x-request-id'],
+        'date': new Date().toUTCString(),
+      })
+    },
+    'hello'
+  )
+)
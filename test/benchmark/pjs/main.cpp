@@ -0,0 +1,77 @@
+#include "pjs.hpp"
+
+#include <chrono>
+#include <iostream>
+
+using namespace pjs;
+
+//
+// Benchmark
+//
+
+static const int ITERATIONS = 1000000;
+
+static void benchmark(Context &ctx, const char *name, const char *script) {
+  std::string error;
+  int error_line, error_column;
+  Module module(ctx.instance());
+  module.load(name, script);
+  if (!module.compile(error, error_line, error_column)) {
+    std::cerr << name << ": syntax error at line " << error_line << " column " << error_column << ": " << error << std::endl;
+    return;
+  }
+
+  Value f;
+  module.execute(ctx, -1, nullptr, f);
+  if (!ctx.ok() || !f.is_function()) {
+    std::cerr << name << ": script does not evaluate to a function" << std::endl;
+    ctx.reset();
+    return;
+  }
+
+  Value argv[2];
+  argv[0] = Object::make();
+  argv[0].o()->set("status", 200);
+  argv[0].o()->set("path", "/api/v1/users");
+  argv[0].o()->set("weight", 3);
+  argv[1].set(7);
+
+  auto measure = [&](bool bytecode, Value &result) {
+    Bytecode::enable(bytecode);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+      (*f.as<Function>())(ctx, 2, argv, result);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / (double)ITERATIONS;
+  };
+
+  Value r1, r2;
+  auto t_tree = measure(false, r1);
+  auto t_code = measure(true, r2);
+
+  std::cout << name << '\t';
+  std::cout << t_tree << " ns\t" << t_code << " ns\t";
+  std::cout << (t_tree / t_code) << "x\t";
+  std::cout << (Value::is_identical(r1, r2) ? "ok" : "MISMATCH") << std::endl;
+}
+
+//
+// main
+//
+
+int main() {
+  Instance instance(Global::make());
+  Context ctx(&instance);
+
+  std::cout << "name\ttree-walk\tbytecode\tspeedup\tresult" << std::endl;
+
+  benchmark(ctx, "call", "(req, n) => n");
+  benchmark(ctx, "arith", "(req, n) => (n * 3 + 1) % 5 - n / 2");
+  benchmark(ctx, "compare", "(req, n) => n > 5 && n <= 10 || n === 0");
+  benchmark(ctx, "property", "(req, n) => req.status === 200 ? req.weight * n : 0");
+  benchmark(ctx, "nullish", "(req, n) => (req.missing ?? req.weight) + (req?.status ?? 0)");
+  benchmark(ctx, "string", "(req, n) => req.path + '?n=' + n");
+
+  return 0;
+}
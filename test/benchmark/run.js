@@ -276,7 +276,8 @@ function startBaseline() {
 
 function startPipy(args, env) {
   return startProcess(
-    join(binPath, pipyExe), ['--log-level=debug:thread', ...args], env,
+    join(binPath, pipyExe), ['--log-level=debug:thread', ...args],
+    { MAX_PIPELINE: process.env.MAX_PIPELINE || '', ...env },
     'pipy', 'Thread 0 started',
   );
 }
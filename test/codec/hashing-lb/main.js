@@ -0,0 +1,34 @@
+((
+  targets = new Array(10).fill().map((_, i) => 't' + i),
+  keys = new Array(20000).fill().map((_, i) => 'key-' + i),
+  count = (list, f) => list.reduce((n, x, i) => f(x, i) ? n + 1 : n, 0),
+
+  check = (algorithm) => (
+    ((
+      lb = new algo.HashingLoadBalancer(targets, null, { algorithm }),
+      before = keys.map(k => lb.select(k)),
+      loads = targets.map(t => count(before, x => x === t)),
+      mean = keys.length / targets.length,
+      added = (lb.add('t10'), keys.map(k => lb.select(k))),
+      removed = (lb.set(targets.filter(t => t !== 't3').concat(['t10'])), keys.map(k => lb.select(k))),
+      movedOnAdd = count(added, (x, i) => x !== before[i]),
+    ) => [
+      algorithm,
+      '  balanced: ' + (loads.every(n => mean * 0.75 < n && n < mean * 1.25)),
+      '  add: keys only move to the new target: ' + (count(added, (x, i) => x !== before[i] && x !== 't10') === 0),
+      '  add: the new target gets its share: ' + (keys.length / 11 * 0.75 < movedOnAdd && movedOnAdd < keys.length / 11 * 1.25),
+      '  remove: keys only move off the removed target: ' + (count(removed, (x, i) => x !== added[i] && added[i] !== 't3') === 0),
+      '  remove: no key stays on the removed target: ' + (count(removed, x => x === 't3') === 0),
+    ].join('\n') + '\n'
+  )()
+),
+
+) => pipy.read('input', $=>$
+  .replaceStreamStart(evt => [new MessageStart, evt])
+  .replaceStreamEnd(evt => [new MessageEnd, evt])
+  .split('\n')
+  .replaceMessage(msg => new Data(check(msg.body.toString())))
+  .tee('-')
+)
+
+)()
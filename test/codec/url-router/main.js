@@ -0,0 +1,42 @@
+((
+  legacy = new algo.URLRouter({
+    '/*': 'root',
+    '/api/*': 'api',
+    '/api/users': 'users',
+    '/static/img:1.png': 'img-1',
+    '/a/:b': 'a-colon-b',
+    'example.com/*': 'example',
+    'example.com/login': 'example-login',
+    '*.example.com/*': 'example-sub',
+  }),
+
+  params = new algo.URLRouter({
+    '/*': 'root',
+    '/api/*': 'api',
+    '/api/users': 'users',
+    '/api/users/:id': 'user',
+    '/users/:id/posts/:post': 'post',
+    '/static/img:1.png': 'img-1',
+    'example.com/:page': 'example-page',
+  }, { params: true }),
+
+) => pipy.read('input', $=>$
+  .replaceStreamStart(evt => [new MessageStart, evt])
+  .replaceStreamEnd(evt => [new MessageEnd, evt])
+  .split('\n')
+  .replaceMessage(
+    msg => (
+      (url, m) => (
+        m = params.match(url),
+        new Data([
+          url,
+          legacy.find(url) || '-',
+          m ? m.value + ' ' + JSON.stringify(m.params) : '-',
+        ].join(' | ') + '\n')
+      )
+    )(msg.body.toString())
+  )
+  .tee('-')
+)
+
+)()
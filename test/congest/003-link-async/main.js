@@ -0,0 +1,72 @@
+((
+  data1MB = new Array(64).fill(new Data(new Array(16*1024).fill(0x78))).reduce((d, c) => (d.push(c), d), new Data),
+  slowDown = new Array(20000).fill(1),
+  received = 0,
+  returned = 0,
+  maxLag = 0,
+  rounds = 0,
+  watchdog = 0,
+
+) => pipy()
+
+.branch(
+  __thread.id === 0, ($=>$
+    .pipeline('sink')
+    .handleData(
+      () => slowDown.reduce((a, b) => a + Math.sqrt(a + b), 0)
+    )
+
+    .task('30s')
+    .onStart(
+      () => (
+        __thread.concurrency < 3 ? (
+          console.log('FAIL: run with --threads=3'),
+          pipy.exit(1)
+        ) : ++watchdog > 1 && (
+          console.log('FAIL: timed out'),
+          pipy.exit(1)
+        ),
+        new StreamEnd
+      )
+    )
+  ),
+
+  __thread.id === 2, ($=>$
+    .listen(8001)
+    .onStart(new Data)
+    .replay().to($=>$
+      .replaceStreamStart(
+        [data1MB, new StreamEnd('Replay')]
+      )
+    )
+  ),
+
+  __thread.id === 1, ($=>$
+    .task()
+    .onStart(new Data)
+    .connect('localhost:8001', { retryCount: -1, retryDelay: 0.1 })
+    .handleData(data => void (received += data.size))
+    .linkAsync(() => 'sink')
+    .handleData(data => void (returned += data.size))
+
+    .task('1s')
+    .onStart(
+      () => (
+        maxLag = Math.max(maxLag, received - returned),
+        console.log('received', received, 'returned', returned, 'lag', received - returned),
+        ++rounds === 10 && (
+          maxLag > 64*1024*1024 ? (
+            console.log('FAIL: backlog grew to', maxLag, 'bytes'),
+            pipy.exit(1)
+          ) : (
+            console.log('PASS: backlog stayed under', maxLag, 'bytes'),
+            pipy.exit(0)
+          )
+        ),
+        new StreamEnd
+      )
+    )
+  )
+)
+
+)()
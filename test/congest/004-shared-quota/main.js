@@ -0,0 +1,53 @@
+((
+  quota = new algo.Quota(0, { key: 'shared', lease: 10, per: '10s' }),
+  total = 20,
+  produced = 0,
+  received = 0,
+  ticks = 0,
+  rounds = 0,
+
+) => pipy()
+
+.branch(
+  __thread.id === 0, ($=>$
+    .task('0.05s')
+    .onStart(
+      () => (
+        __thread.concurrency < 2 ? (
+          console.log('FAIL: run with --threads=2'),
+          pipy.exit(1)
+        ) : ++ticks > 10 && produced < total && (
+          quota.produce(1),
+          produced++
+        ),
+        new StreamEnd
+      )
+    )
+  ),
+
+  __thread.id === 1, ($=>$
+    .task()
+    .onStart(() => new Array(total).fill(new Message('x')))
+    .throttleMessageRate(quota)
+    .handleMessage(() => void received++)
+
+    .task('0.5s')
+    .onStart(
+      () => (
+        console.log('received', received, 'of', total),
+        ++rounds === 6 && (
+          received < total ? (
+            console.log('FAIL: produced quota did not reach the waiting thread'),
+            pipy.exit(1)
+          ) : (
+            console.log('PASS: all produced quota reached the waiting thread'),
+            pipy.exit(0)
+          )
+        ),
+        new StreamEnd
+      )
+    )
+  )
+)
+
+)()
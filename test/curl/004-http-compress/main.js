@@ -1,4 +1,6 @@
-pipy()
+((
+  dictionary = pipy.load('index.html'),
+) => pipy()
 
 .listen(8080)
 .demuxHTTP().to($=>$
@@ -16,6 +18,22 @@ pipy()
   .compressHTTP('deflate')
 )
 
+.listen(8082)
+.demuxHTTP().to($=>$
+  .replaceMessage(
+    new Message(pipy.load('index.html'))
+  )
+  .compressHTTP('zstd')
+)
+
+.listen(8083)
+.demuxHTTP().to($=>$
+  .replaceMessage(
+    new Message(pipy.load('index.html'))
+  )
+  .compressHTTP('dcz', { dictionary })
+)
+
 .listen(8000)
 .demuxHTTP().to($=>$
   .muxHTTP().to($=>$
@@ -31,3 +49,21 @@ pipy()
   )
   .decompressHTTP()
 )
+
+.listen(8002)
+.demuxHTTP().to($=>$
+  .muxHTTP().to($=>$
+    .connect('localhost:8082')
+  )
+  .decompressHTTP()
+)
+
+.listen(8003)
+.demuxHTTP().to($=>$
+  .muxHTTP().to($=>$
+    .connect('localhost:8083')
+  )
+  .decompressHTTP({ dictionary })
+)
+
+)()
@@ -6,6 +6,14 @@ curl --compressed http://localhost:8080
 echo Response compressed with deflate
 curl --compressed http://localhost:8081
 
+echo Response compressed with zstd
+curl --compressed http://localhost:8082
+
+echo Response compressed with dcz
+curl -s -o NUL -D - http://localhost:8083 | findstr /i /b "content-encoding"
+
 echo Responses decompressed by proxy
 curl http://localhost:8000
 curl http://localhost:8001
+curl http://localhost:8002
+curl http://localhost:8003
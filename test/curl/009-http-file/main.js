@@ -0,0 +1,31 @@
+((
+  tmp = os.env.TMPDIR || os.env.TEMP || '/tmp',
+  chunk = new Data('0123456789abcdef'.repeat(1024)),
+  content = new Array(512).fill(chunk).reduce((d, c) => (d.push(c), d), new Data),
+  dir = (
+    os.writeFile(tmp + '/pipy-test-large.bin', content),
+    os.writeFile(tmp + '/pipy-test-small.txt', new Data('v1\n')),
+    os.writeFile(tmp + '/pipy-test-small.txt.gz', new Data('GZ\n')),
+    os.writeFile(tmp + '/pipy-test-small.txt.zst', new Data('ZST\n')),
+    new http.Directory(tmp, { fs: true })
+  ),
+) =>
+
+pipy()
+
+.listen(8080)
+.serveHTTP(req => dir.serve(req))
+
+.listen(8000)
+.demuxHTTP().to($=>$
+  .muxHTTP().to($=>$
+    .connect('localhost:8080')
+  )
+  .replaceMessage(
+    msg => new Message(
+      msg.body.size === content.size && msg.body.toString() === content.toString() ? 'OK\n' : 'MISMATCH\n'
+    )
+  )
+)
+
+)()
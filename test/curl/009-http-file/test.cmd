@@ -0,0 +1,26 @@
+@echo off
+
+echo Download a large file
+curl -s -o NUL -w "%%{http_code} %%{size_download}\n" http://localhost:8080/pipy-test-large.bin
+
+echo Verify content through proxy
+curl -s http://localhost:8000/pipy-test-large.bin
+
+echo Download a range
+curl -s -r 1000000-1000015 -w "\n" http://localhost:8080/pipy-test-large.bin
+curl -s -r 8388600- -w "\n" http://localhost:8080/pipy-test-large.bin
+
+echo Reject a range beyond any file size
+curl -s -r 99999999999999999999999- -o NUL -w "%%{http_code}\n" http://localhost:8080/pipy-test-large.bin
+curl -s -r 18446744073709551615-18446744073709551616 -o NUL -w "%%{http_code}\n" http://localhost:8080/pipy-test-large.bin
+
+echo Serve precompressed siblings
+curl -s -H "Accept-Encoding: zstd, gzip" http://localhost:8080/pipy-test-small.txt
+curl -s -H "Accept-Encoding: gzip" http://localhost:8080/pipy-test-small.txt
+curl -s http://localhost:8080/pipy-test-small.txt
+
+echo Revalidate cached files after the interval
+echo v2> "%TEMP%\pipy-test-small.txt"
+curl -s http://localhost:8080/pipy-test-small.txt
+timeout /t 2 /nobreak > NUL
+curl -s http://localhost:8080/pipy-test-small.txt
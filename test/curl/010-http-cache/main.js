@@ -0,0 +1,33 @@
+((
+  counts = {},
+) =>
+
+pipy()
+
+.listen(8080)
+.serveHTTP(
+  msg => (
+    counts[msg.head.path] = (counts[msg.head.path] || 0) + 1,
+    new Message(
+      {
+        headers: msg.head.path === '/nocache' ? (
+          { 'cache-control': 'no-store' }
+        ) : (
+          { 'cache-control': 'max-age=60', 'etag': '"v1"' }
+        )
+      },
+      `${msg.head.method} ${msg.head.path} ${counts[msg.head.path]}\n`
+    )
+  )
+)
+
+.listen(8000)
+.demuxHTTP().to(
+  $=>$.cacheHTTP().to(
+    $=>$.muxHTTP().to(
+      $=>$.connect('localhost:8080')
+    )
+  )
+)
+
+)()
@@ -0,0 +1,20 @@
+@echo off
+
+echo Fill the cache
+curl -s http://localhost:8000/foo
+
+echo Serve from the cache
+curl -s http://localhost:8000/foo
+curl -s http://localhost:8000/foo
+
+echo Match If-None-Match
+curl -s -o NUL -w "%%{http_code}\n" -H "If-None-Match: \"v1\"" http://localhost:8000/foo
+curl -s -o NUL -w "%%{http_code}\n" -H "If-None-Match: W/\"v0\", W/\"v1\"" http://localhost:8000/foo
+curl -s -w "%%{http_code}\n" -H "If-None-Match: \"v0\"" http://localhost:8000/foo
+
+echo Bypass the cache for POST
+curl -s -d x http://localhost:8000/foo
+
+echo Do not store no-store responses
+curl -s http://localhost:8000/nocache
+curl -s http://localhost:8000/nocache
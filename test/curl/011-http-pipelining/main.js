@@ -0,0 +1,44 @@
+((
+  inflight = {},
+  maxDepth = 0,
+) => pipy()
+
+.listen(8080)
+.demuxHTTP().to($=>$
+  .replaceMessage(
+    msg => msg.head.path === '/depth' ? (
+      (depth => (maxDepth = 0, new Message(depth + '\n')))(maxDepth)
+    ) : (
+      (port => (
+        inflight[port] = (inflight[port] || 0) + 1,
+        maxDepth = Math.max(maxDepth, inflight[port]),
+        new Timeout(0.2).wait().then(
+          () => (
+            inflight[port]--,
+            msg.head.path.startsWith('/break/') ? (
+              new Message({ headers: { 'connection': 'close' }}, 'ok\n')
+            ) : (
+              new Message('ok\n')
+            )
+          )
+        )
+      ))(__inbound.remotePort)
+    )
+  )
+)
+
+.listen(8000)
+.demuxHTTP().to($=>$
+  .muxHTTP(() => 'capped', { maxPipeline: 2 }).to($=>$
+    .connect('localhost:8080')
+  )
+)
+
+.listen(8001)
+.demuxHTTP().to($=>$
+  .muxHTTP(() => 'fallback', { maxPipeline: 4, pipelineFallback: 1, maxIdle: 0.5 }).to($=>$
+    .connect('localhost:8080')
+  )
+)
+
+)()
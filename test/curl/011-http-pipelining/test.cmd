@@ -0,0 +1,20 @@
+@echo off
+
+echo Cap the pipelining depth
+curl -s -Z -o NUL http://localhost:8000/[1-8]
+curl -s http://localhost:8080/depth
+
+echo Pipeline up to the cap
+curl -s -Z -o NUL http://localhost:8001/[1-8]
+curl -s http://localhost:8080/depth
+
+echo Fall back to one request per connection after a broken pipeline
+curl -s -Z -o NUL http://localhost:8001/break/[1-4]
+curl -s -o NUL http://localhost:8080/depth
+curl -s -Z -o NUL http://localhost:8001/[1-8]
+curl -s http://localhost:8080/depth
+
+echo Resume pipelining once the fallback expires
+timeout /t 2 /nobreak > NUL
+curl -s -Z -o NUL http://localhost:8001/[1-8]
+curl -s http://localhost:8080/depth
@@ -0,0 +1,20 @@
+#!/bin/bash
+
+echo 'Cap the pipelining depth'
+curl -s -Z -o /dev/null http://localhost:8000/[1-8]
+curl -s http://localhost:8080/depth
+
+echo 'Pipeline up to the cap'
+curl -s -Z -o /dev/null http://localhost:8001/[1-8]
+curl -s http://localhost:8080/depth
+
+echo 'Fall back to one request per connection after a broken pipeline'
+curl -s -Z -o /dev/null http://localhost:8001/break/[1-4]
+curl -s -o /dev/null http://localhost:8080/depth
+curl -s -Z -o /dev/null http://localhost:8001/[1-8]
+curl -s http://localhost:8080/depth
+
+echo 'Resume pipelining once the fallback expires'
+sleep 1.5
+curl -s -Z -o /dev/null http://localhost:8001/[1-8]
+curl -s http://localhost:8080/depth
@@ -0,0 +1,86 @@
+#include "pjs.hpp"
+
+#include <iostream>
+
+using namespace pjs;
+
+//
+// Test
+//
+
+static int s_failures = 0;
+
+static void test(Context &ctx, const char *name, const char *script, bool expect_error = false) {
+  std::string error;
+  int error_line, error_column;
+  Module module(ctx.instance());
+  module.load(name, script);
+  if (!module.compile(error, error_line, error_column)) {
+    std::cerr << name << ": syntax error at line " << error_line << " column " << error_column << ": " << error << std::endl;
+    s_failures++;
+    return;
+  }
+
+  Value f;
+  module.execute(ctx, -1, nullptr, f);
+  if (!ctx.ok() || !f.is_function()) {
+    std::cerr << name << ": script does not evaluate to a function" << std::endl;
+    ctx.reset();
+    s_failures++;
+    return;
+  }
+
+  auto run = [&](bool bytecode, Value &result) {
+    Value argv[2];
+    argv[0] = Object::make();
+    argv[0].o()->set("status", 200);
+    argv[0].o()->set("weight", 3);
+    argv[1].set(7);
+    Bytecode::enable(bytecode);
+    (*f.as<Function>())(ctx, 2, argv, result);
+    auto ok = ctx.ok();
+    ctx.reset();
+    return ok;
+  };
+
+  Value r1, r2;
+  auto ok1 = run(false, r1);
+  auto ok2 = run(true, r2);
+
+  bool passed = (
+    ok1 == ok2 && ok1 == !expect_error &&
+    (!ok1 || Value::is_identical(r1, r2))
+  );
+
+  std::cout << name << '\t' << (passed ? "ok" : "FAIL") << std::endl;
+  if (!passed) s_failures++;
+}
+
+//
+// main
+//
+
+int main() {
+  Instance instance(Global::make());
+  Context ctx(&instance);
+
+  // Expression bodies
+  test(ctx, "expr-arith", "(req, n) => (n * 3 + 1) % 5 - n / 2");
+  test(ctx, "expr-property", "(req, n) => req.status === 200 ? req.weight * n : 0");
+  test(ctx, "expr-nullish", "(req, n) => (req.missing ?? req.weight) + (req?.status ?? 0)");
+
+  // Statement bodies
+  test(ctx, "stmt-if", "(req, n) => { if (n > 5) { return n * 2 } else if (n < 0) return -n; return 0 }");
+  test(ctx, "stmt-no-return", "(req, n) => { if (req.status === 200) n = n + req.weight }");
+  test(ctx, "stmt-var", "(req, n) => { var x = n + 1; x = x * req.weight; return x }");
+  test(ctx, "stmt-switch", "(req, n) => { if (n > 0) switch (n) { case 7: return 'seven' } return 'other' }");
+  test(ctx, "stmt-break", "(req, n) => { if (n > 0) switch (n) { case 7: break } return n * 2 }");
+  test(ctx, "stmt-try", "(req, n) => { if (n > 0) try { throw n } catch (e) { return e + 1 } return 0 }");
+
+  // Errors
+  test(ctx, "error-expr", "(req, n) => req.missing.field", true);
+  test(ctx, "error-stmt", "(req, n) => { n = n + 1; return req.missing.field }", true);
+  test(ctx, "error-throw", "(req, n) => { if (n > 0) throw 'boom'; return n }", true);
+
+  return s_failures > 0 ? 1 : 0;
+}